@@ -49,8 +49,8 @@ http://www.pjrc.com/teensy/pinout.html
      3 ---- Analog Mux S1
      4 ---- Analog Mux S2
      5 ---- Analog Mux S3
-     6
-     7
+     6 ---- MPU9150 INT
+     7 ---- GPS PPS (optional)
      8
      9 ---- GPS Tx
     10 ---- GPS Rx
@@ -75,6 +75,48 @@ http://www.pjrc.com/teensy/pinout.html
 
 Communications protocol
 
+The radio carries either text messages or binary frames, selected by
+TELEMETRY_FORMAT. Binary is the default. A frame holds the values measured
+together under a single timestamp, so channels sent at different rates
+share the frame overhead whenever they fall due together. The layout,
+fixed-point scaling, COBS framing and CRC are described in TelemetryFrame.h.
+The text format is the one described below. Both use the same type codes.
+
+Each channel goes out at its own rate (see the task table below), attitude
+fastest and temperature slowest, so the link is spent on the values that
+change quickly:
+  AQW AQX AQY AQZ   50 Hz (10 Hz as text)
+  SPD ALT CLB       20 Hz
+  HDG               10 Hz
+  LAT LON            5 Hz, when the GPS has a new fix
+  VIN AIN            2 Hz
+  UTC DRF            1 Hz, once the clock is synchronized to GPS
+  TMP              0.5 Hz
+
+Timestamps are the aircraft's millis(). The UTC and DRF pair is the time
+sync record: UTC at the record's own timestamp and how fast millis() runs
+against UTC, from which the ground station puts every other timestamp in
+UTC. The clock is disciplined by the GPS timepulse on the PPS pin when it
+is wired, to well within a millisecond, and otherwise by when the
+receiver's solutions arrive, which puts UTC late by the receiver's output
+latency (see TimeSync.h).
+
+Every value is stamped with the time it was measured, not the time it was
+sent: attitude with the DMP interrupt that announced the packet,
+temperature with the middle of the BMP085 conversion, position with the
+epoch of the fix, and the analog channels and heading with the read.
+Altitude and climb rate come from a Kalman filter fed with every DMP
+packet and pressure conversion (see AltitudeFilter.h), and carry the time
+of the latest packet it has taken in.
+The tasks hand these on as sample records (see TelemetrySample.h), and a
+frame only holds values measured in the same millisecond.
+
+Nothing waits for the radio. Messages go into a transmit queue that the
+loop drains into the UART as it has room (see TelemetryQueue.h). When the
+link cannot keep up, the slow and less important channels are left out
+first (SHED_ORDER) and attitude is kept; the status report on the USB port
+counts what was shed or dropped.
+
 All data will be converted to engineering (SI) units and then prefixed with
 a dollar sign '$' and a three letter code specifiying the type of message. A
 data value will proceed the type information. A character 'T' will proceed
@@ -95,7 +137,9 @@ The type codes are as follows:
   LAT - GPS latitude (degrees)
   LON - GPS longitude (degrees)
   SPD - Airspeed (meters / second)
+  DRF - Clock drift (ppm, millis() against UTC)
   TMP - Temperature (degrees Celsius)
+  UTC - UTC time of day at the timestamp (seconds)
   VIN - Voltage in (volts)
   
 Examples
@@ -108,12 +152,21 @@ Examples
 
 ****************************************************************************/
 
-#include <Wire.h>
 #include <I2Cdev.h>
 #include <TinyGPS.h>
 #include <Adafruit_Sensor.h>
 #include <Adafruit_BMP085.h>
 #include <MPU6050_9Axis_MotionApps41.h>
+#include <TelemetryFrame.h>
+#include <TelemetryFormat.h>
+#include <TelemetryQueue.h>
+#include <TelemetrySample.h>
+#include <UbxGps.h>
+#include <GpsSetup.h>
+#include <TimeSync.h>
+#include <AltitudeFilter.h>
+#include <DebugLog.h>
+#include <EEPROM.h>
 
 // MCU pins
 const int ANALOG_MUX_SIG = A0;
@@ -121,6 +174,8 @@ const int ANALOG_MUX_S0 = 2;
 const int ANALOG_MUX_S1 = 3;
 const int ANALOG_MUX_S2 = 4;
 const int ANALOG_MUX_S3 = 5;
+const int MPU_INT = 6;
+const int GPS_PPS = 7;
 const int LED = 13;
 
 // Analog multiplexer pins
@@ -133,42 +188,252 @@ const int ADC_RESOLUTION = 12;
 const int ADC_MAX = (int)pow(2.0, (float)ADC_RESOLUTION) - 1.0;
 const float VREF = 3.284;
 
+// I2C. Once set up, a blocking bus access takes a few ms even queued
+// behind a FIFO read, so one waiting on a hung transfer gives up early.
+const unsigned int I2C_LOOP_TIMEOUT = 50;  // ms
+
+// EEPROM. The pressure at ground level is kept from power on, for a warm
+// restart in the air to measure altitude from
+const int EEPROM_GROUND_LEVEL = 0;  // Magic, then the pressure, 4 bytes each
+const unsigned long GROUND_LEVEL_MAGIC = 0x4C544701ul;
+
+// MPU
+const unsigned long MPU_STARTUP_TIME = 100ul;  // ms from power on, BMP085 needs less
+const int MPU_FIFO_SIZE = 1024;
+const int DMP_QUEUE_SIZE = 8;  // Power of two
+const unsigned long DMP_PERIOD = 20000ul;  // us, the 50 Hz FIFO rate of MotionApps41
+const unsigned long DMP_TRANSFER_TIMEOUT = 50000ul;  // us, a full batch takes 18 ms
+const byte DMP_IDLE = 0;      // FIFO read states
+const byte DMP_COUNTING = 1;
+const byte DMP_READING = 2;
+
+// GPS. The receiver starts out sending six kinds of NMEA sentence at 9600
+// baud, once a second. At startup it is found at whatever baud rate it is
+// at and moved to GPS_BAUD, measuring at the first of GPS_PERIODS (ms) it
+// accepts, and sending only the messages read here. With GPS_UBX those are
+// binary UBX messages, so position arrives as integers and the port
+// carries a fraction of the bytes; with GPS_NMEA, RMC and GGA for TinyGPS.
+const int GPS_NMEA = 0;
+const int GPS_UBX = 1;
+const int GPS_PROTOCOL = GPS_UBX;
+const unsigned long GPS_BAUD = 115200;
+const uint16_t GPS_PERIODS[] = { 100, 200 };  // The NEO-6M stops at 5 Hz
+const byte GPS_UBX_MESSAGES[] = {             // Class, id, every n solutions
+  UBX_NAV, UBX_NAV_POSLLH, 1,
+  UBX_NAV, UBX_NAV_VELNED, 1,
+  UBX_NAV, UBX_NAV_SOL, 1,
+  UBX_NAV, UBX_NAV_TIMEUTC, 5                 // Only relates GPS time to UTC
+};
+const byte GPS_NMEA_MESSAGES[] = {
+  UBX_NMEA, UBX_NMEA_RMC, 1,
+  UBX_NMEA, UBX_NMEA_GGA, 1,
+  UBX_NMEA, UBX_NMEA_GLL, 0,
+  UBX_NMEA, UBX_NMEA_GSA, 0,
+  UBX_NMEA, UBX_NMEA_GSV, 0,
+  UBX_NMEA, UBX_NMEA_VTG, 0
+};
+const int GPS_READ_SIZE = 64;  // Bytes parsed per call, the receive buffer size
+
+// Radio output formats
+const int TELEMETRY_TEXT = 0;
+const int TELEMETRY_BINARY = 1;
+const int TELEMETRY_FORMAT = TELEMETRY_BINARY;
+
+// Longest text message: $, code, number, T, timestamp and CRLF
+const int TEXT_MESSAGE_MAX = 48;
+
+// Values measured further apart than this (ms) do not share a frame, as
+// its one timestamp would misplace them
+const unsigned long FRAME_TIME_SLACK = 0ul;
+
+// Channels given up first when the radio falls behind. Attitude and the
+// time sync record are never shed. Text messages from these channels are
+// also dropped while the transmit queue is more than half full, keeping
+// the rest for attitude.
+const byte SHED_ORDER[] = {
+  TELEMETRY_TMP, TELEMETRY_VIN, TELEMETRY_AIN, TELEMETRY_HDG,
+  TELEMETRY_LON, TELEMETRY_LAT, TELEMETRY_CLB, TELEMETRY_ALT, TELEMETRY_SPD
+};
+const int SHED_COUNT = sizeof(SHED_ORDER);
+const int SHED_TEXT_LEVEL = TELEMETRY_QUEUE_SIZE / 2;
+
+// Debug log subsystems
+const uint16_t LOG_ATTITUDE = 0x0001;
+const uint16_t LOG_AIRSPEED = 0x0002;
+const uint16_t LOG_ALTITUDE = 0x0004;
+const uint16_t LOG_HEADING = 0x0008;
+const uint16_t LOG_POSITION = 0x0010;
+const uint16_t LOG_POWER = 0x0020;
+const uint16_t LOG_TEMPERATURE = 0x0040;
+const uint16_t LOG_SCHEDULER = 0x0080;
+const uint16_t LOG_MPU = 0x0100;
+const uint16_t LOG_RADIO = 0x0200;
+const uint16_t LOG_TIME = 0x0400;
+const uint16_t LOG_ALL = 0xFFFF;
+
+// Debug output on the USB port. Sensor readings are logged at
+// DEBUG_LOG_DEBUG, so they are compiled out unless asked for here.
+typedef DebugLog<DEBUG_LOG_INFO, LOG_ALL> Log;
+
+// Task periods (ms). Four text messages take about 84 bytes, too many to
+// send at 50 Hz on a 38400 baud link.
+const unsigned long ATTITUDE_PERIOD = TELEMETRY_FORMAT == TELEMETRY_BINARY ? 20ul : 100ul;
+const unsigned long AIRSPEED_PERIOD = 50ul;
+const unsigned long ALTITUDE_PERIOD = 50ul;
+const unsigned long HEADING_PERIOD = 100ul;
+const unsigned long POSITION_PERIOD = 200ul;
+const unsigned long POWER_PERIOD = 500ul;
+const unsigned long TIME_SYNC_PERIOD = 1000ul;
+const unsigned long TEMPERATURE_PERIOD = 2000ul;
+const unsigned long STATUS_PERIOD = 10000ul;
+
+// Periodic task. A task is released every period and has until deadline
+// after its release to run; a later start counts as an overrun.
+struct Task {
+  const char *name;
+  void (*run)();
+  unsigned long period;    // ms
+  unsigned long deadline;  // ms
+  unsigned long release;   // millis() of the next release
+  unsigned long overruns;
+};
+
 // Globals
-unsigned long previous_time = 0ul;
 int ground_level_pressure;
+boolean frame_open = false;
+unsigned long shed_values = 0;
+boolean gps_fix = false;
 unsigned short dmp_packet_size;
+volatile boolean mpu_interrupt = false;
+volatile unsigned long mpu_interrupt_micros;
+MPU6050_DMPSample dmp_queue[DMP_QUEUE_SIZE];
+unsigned char dmp_head = 0;  // Next slot to fill
+unsigned long dmp_samples = 0;
+I2Ctransfer dmp_transfer;  // FIFO reads, on the bus while the loop goes on
+byte dmp_buffer[MPU6050_DMP_BATCH_PACKETS * MPU6050_DMP_PACKET_SIZE];
+byte dmp_read_state = DMP_IDLE;
+unsigned long dmp_transfer_micros;  // When the FIFO transfer was submitted
+unsigned short dmp_unread = 0;  // Packets counted but not read yet
+unsigned long dmp_next_stamp;  // Their INT times, from the oldest
+volatile unsigned long dmp_count_micros;
+unsigned long gps_fix_micros;
+volatile boolean gps_pulse_pending = false;
+volatile unsigned long gps_pulse_micros;
 
 // Sensors
 Adafruit_BMP085 *bmp = new Adafruit_BMP085;
 MPU6050 *mpu = new MPU6050;
 TinyGPS *gps = new TinyGPS;
+UbxGps ubx;
+
+// Altitude and climb rate from pressure and vertical acceleration
+AltitudeFilter altitude_filter;
+
+// UTC
+TimeSync time_sync;
+
+// Measured values on their way to the radio
+TelemetrySampleQueue samples;
+
+// Radio
+TelemetryFrame frame;
+TelemetryQueue radio;
+
+// Functions
+Task *next_task(unsigned long current_time);
+void run_task(Task *task, unsigned long current_time);
+void print_task_status();
+void configure_gps(boolean warm);
+void feed_gps();
+void gps_pulse();
+void gps_solution(unsigned long received);
+boolean gps_utc(unsigned long *utc);
+unsigned long fix_time();
+void save_ground_level();
+boolean load_ground_level();
+unsigned long millis_at(uint32_t local);
+void dmp_data_ready();
+void dmp_counted(I2Ctransfer *transfer);
+void drain_dmp_fifo();
+void fuse_accel(const MPU6050_DMPSample &sample);
+void send_ampere_measure();
+void send_altitude();
+void send_attitude();
+void send_heading();
+void send_position();
+void send_airspeed();
+void send_voltage_measure();
+void send_temperature();
+void send_time_sync();
+void select_adc_mux(int pin);
+void record_value(int channel, float value, int digits, unsigned long timestamp);
+void record_fixed(int channel, long value, int decimals, unsigned long timestamp);
+void send_samples();
+void send_value(int channel, float value, int digits, unsigned long timestamp);
+void send_fixed(int channel, long value, int decimals, unsigned long timestamp);
+void add_to_frame(int channel, unsigned long timestamp);
+void send_message(int channel, const char *number, unsigned long timestamp);
+void send_frame();
+void send_radio();
+boolean sheddable(int channel);
+
+// Rate monotonic: ordered by period, shortest (highest priority) first
+Task tasks[] = {
+  { "attitude", send_attitude, ATTITUDE_PERIOD, ATTITUDE_PERIOD, 0ul, 0ul },
+  { "airspeed", send_airspeed, AIRSPEED_PERIOD, AIRSPEED_PERIOD, 0ul, 0ul },
+  { "altitude", send_altitude, ALTITUDE_PERIOD, ALTITUDE_PERIOD, 0ul, 0ul },
+  { "heading", send_heading, HEADING_PERIOD, HEADING_PERIOD, 0ul, 0ul },
+  { "position", send_position, POSITION_PERIOD, POSITION_PERIOD, 0ul, 0ul },
+  { "current", send_ampere_measure, POWER_PERIOD, POWER_PERIOD, 0ul, 0ul },
+  { "voltage", send_voltage_measure, POWER_PERIOD, POWER_PERIOD, 0ul, 0ul },
+  { "time sync", send_time_sync, TIME_SYNC_PERIOD, TIME_SYNC_PERIOD, 0ul, 0ul },
+  { "temperature", send_temperature, TEMPERATURE_PERIOD, TEMPERATURE_PERIOD, 0ul, 0ul },
+  { "status", print_task_status, STATUS_PERIOD, STATUS_PERIOD, 0ul, 0ul }
+};
+const int TASK_COUNT = sizeof(tasks) / sizeof(tasks[0]);
 
 void setup() {
+  boolean warm;
+  
   // ADC
   analogReadResolution(ADC_RESOLUTION);
   analogReadAveraging(5);
   
-  // I2C
-  Wire.begin();
-  
   // Debug info
   Serial.begin(115200);
   
   // Comm radio
   Serial1.begin(38400);
   
+  // After a reset of the Teensy alone (brownout, watchdog) the MPU can still
+  // be running the DMP from before, and the GPS be set up; carry on with
+  // both as they are rather than start over. Straight after power on the
+  // MPU is not yet answering, and the check fails at the first read.
+  // Setting a config register then takes a single bus write.
+  mpu->shadowConfigRegisters();
+  unsigned long dmp_start = millis();
+  warm = mpu->dmpResume();
+  if (warm) {
+    Serial.print(F("DMP still running, resumed in "));
+    Serial.print(millis() - dmp_start);
+    Serial.println(F(" ms"));
+  }
+  
   // GPS
-  Serial2.begin(9600);
+  configure_gps(warm);
   
   // GPIO
   pinMode(ANALOG_MUX_S0, OUTPUT);
   pinMode(ANALOG_MUX_S1, OUTPUT);
   pinMode(ANALOG_MUX_S2, OUTPUT);
   pinMode(ANALOG_MUX_S3, OUTPUT);
+  pinMode(MPU_INT, INPUT);
+  pinMode(GPS_PPS, INPUT);
   pinMode(LED, OUTPUT);
   
-  // Turn on LED once system has been given time to initialize
-  delay(5000);
+  // Turn on LED once the sensors have had time to start up, which the GPS
+  // setup above has usually given them already
+  while (!warm && millis() < MPU_STARTUP_TIME);
   digitalWrite(LED, HIGH);
   
   // Test communication with sensors
@@ -180,25 +445,52 @@ void setup() {
   }
   Serial.println(F("Pressure sensor OK"));
   
-  mpu->initialize();
-  while (!mpu->testConnection()) {
-    Serial.println(F("Unable to connect to attitude sensor, retrying"));
-    delay(100);
+  if (!warm) {
+    mpu->initialize();
+    while (!mpu->testConnection()) {
+      Serial.println(F("Unable to connect to attitude sensor, retrying"));
+      delay(100);
+    }
+    Serial.println(F("Attitude sensor OK"));
+    
+    dmp_start = millis();
+    if (mpu->dmpInitialize() != 0) {
+      Serial.println(F("DMP failed"));
+      while (true);
+    }
+    Serial.print(F("DMP OK, loaded in "));
+    Serial.print(millis() - dmp_start);
+    Serial.println(F(" ms"));
+    
+    // Turn on the DMP
+    mpu->setDMPEnabled(true);
   }
-  Serial.println(F("Attitude sensor OK"));
+  dmp_packet_size = mpu->dmpGetFIFOPacketSize();
   
-  if (mpu->dmpInitialize() != 0) {
-    Serial.println(F("DMP failed"));
-    while (true);
+  // The DMP raises INT for every packet it puts in the FIFO
+  attachInterrupt(MPU_INT, dmp_data_ready, RISING);
+  
+  // The GPS timepulse, if wired, rises at the top of every UTC second
+  attachInterrupt(GPS_PPS, gps_pulse, RISING);
+  
+  // Store the pressure at ground level, or mid-flight keep the one stored
+  // at power on, so altitude carries on from where it was
+  if (warm && load_ground_level()) {
+    Serial.println(F("Ground level kept"));
+  } else {
+    ground_level_pressure = bmp->readPressure();
+    save_ground_level();
   }
-  Serial.println(F("DMP OK"));
   
-  // Turn on the DMP
-  mpu->setDMPEnabled(true);
-  dmp_packet_size = mpu->dmpGetFIFOPacketSize();
+  // Take a first sample so the frames always have one to report
+  bmp->requestSample();
+  while (!bmp->update());
+  I2Cdev::readTimeout = I2C_LOOP_TIMEOUT;
   
-  // Store the pressure at ground level
-  ground_level_pressure = bmp->readPressure();
+  // Release every task now
+  for (int i = 0; i < TASK_COUNT; i++) {
+    tasks[i].release = millis();
+  }
   
   // Print a blank line
   Serial.println();
@@ -206,37 +498,100 @@ void setup() {
 
 void loop() {
   unsigned long current_time = millis();
-  unsigned long delta_time = current_time - previous_time;
+  Task *task;
   
-  if (delta_time >= 200ul) {
-    previous_time = current_time;
-    
-    // AQW, AQX, AQY, AQZ
-    send_attitude();
-    
-    // SPD
-    send_airspeed();
-    
-    // AIN
-    send_ampere_measure();
-    
-    // ALT, CLB
-    send_altitude();
-    
-    // HDG
-    send_heading();
-    
-    // VIN
-    send_voltage_measure();
-    
-    // LAT, LON
-    send_position();
-    
-    // TMP
-    send_temperature();
-    
-    // Print blank line in debug output
-    Serial.println();
+  // Move new DMP packets off the sensor as they arrive. The reads run on
+  // the bus while the rest of the loop goes on.
+  drain_dmp_fifo();
+  
+  // Keep the pressure sensor converting back to back, every sample going
+  // into the altitude filter
+  if (bmp->update()) {
+    altitude_filter.addAltitude(bmp->getAltitude(ground_level_pressure), bmp->getSampleTime());
+  }
+  if (!bmp->busy()) {
+    bmp->requestSample();
+  }
+  
+  // Decode GPS sentences before the serial buffer fills
+  feed_gps();
+  
+  // What the last task measured goes into the frame or out as text
+  send_samples();
+  
+  // Keep the radio UART busy without ever waiting for it
+  send_radio();
+  
+  // One task per pass so the interrupt driven work above is never held up
+  // for more than a task. Values from tasks due together share a frame,
+  // which goes out once nothing else is due.
+  task = next_task(current_time);
+  if (task) {
+    run_task(task, current_time);
+  } else if (frame_open) {
+    send_frame();
+  } else {
+    // Idle, the only time debug output is formatted and written
+    Log::drain(Serial);
+  }
+}
+
+/**
+ * Highest priority task that has been released, or 0 if none has.
+ */
+Task *next_task(unsigned long current_time) {
+  for (int i = 0; i < TASK_COUNT; i++) {
+    if ((long)(current_time - tasks[i].release) >= 0) {
+      return &tasks[i];
+    }
+  }
+  return 0;
+}
+
+/**
+ * https://en.wikipedia.org/wiki/Rate-monotonic_scheduling
+ */
+void run_task(Task *task, unsigned long current_time) {
+  if (current_time - task->release > task->deadline) {
+    task->overruns++;
+  }
+  
+  // Releases that were missed altogether are dropped rather than run late
+  // back to back
+  task->release += task->period;
+  if ((long)(current_time - task->release) >= 0) {
+    task->release = current_time + task->period;
+  }
+  
+  task->run();
+}
+
+void print_task_status() {
+  Log::text<DEBUG_LOG_INFO, LOG_SCHEDULER>("Task overruns");
+  for (int i = 0; i < TASK_COUNT; i++) {
+    Log::value<DEBUG_LOG_INFO, LOG_SCHEDULER>(tasks[i].name, tasks[i].overruns, 0);
+  }
+  
+  Log::value<DEBUG_LOG_INFO, LOG_RADIO>("Radio queue peak", radio.peak(), 0, "bytes");
+  Log::value<DEBUG_LOG_INFO, LOG_RADIO>("Radio values shed", shed_values, 0);
+  Log::value<DEBUG_LOG_INFO, LOG_RADIO>("Radio messages dropped", radio.dropped(), 0);
+  Log::value<DEBUG_LOG_INFO, LOG_RADIO>("Samples queued peak", samples.peak(), 0);
+  Log::value<DEBUG_LOG_INFO, LOG_RADIO>("Samples dropped", samples.dropped(), 0);
+  
+  if (GPS_PROTOCOL == GPS_UBX) {
+    Log::value<DEBUG_LOG_INFO, LOG_POSITION>("GPS messages", ubx.stats().messages, 0);
+    Log::value<DEBUG_LOG_INFO, LOG_POSITION>("GPS failed checksums", ubx.stats().failedChecksum, 0);
+    Log::value<DEBUG_LOG_INFO, LOG_POSITION>("GPS bad lengths", ubx.stats().badLength, 0);
+    Log::value<DEBUG_LOG_INFO, LOG_POSITION>("GPS acknowledged", ubx.stats().acks, 0);
+    Log::value<DEBUG_LOG_INFO, LOG_POSITION>("GPS rejected", ubx.stats().naks, 0);
+  }
+  
+  if (time_sync.synced()) {
+    Log::text<DEBUG_LOG_INFO, LOG_TIME>(time_sync.pps() ? "Clock synced to PPS" :
+                                        "Clock synced to GPS messages");
+    Log::value<DEBUG_LOG_INFO, LOG_TIME>("Clock drift", time_sync.drift(), 2, "ppm");
+    Log::value<DEBUG_LOG_INFO, LOG_TIME>("Clock residual", time_sync.residual(), 0, "us");
+    Log::value<DEBUG_LOG_INFO, LOG_TIME>("Clock pairs rejected", time_sync.stats().rejected, 0);
   }
 }
 
@@ -244,120 +599,227 @@ void loop() {
  * https://www.sparkfun.com/products/9028
  */
 void send_ampere_measure() {
+  unsigned long acquired;
   float amps;
   
   // Read the current sensor and convert to amperes
   select_adc_mux(AMPERE_SENSOR);
+  acquired = micros();
   amps = (float)analogRead(ANALOG_MUX_SIG) / 23.0193;
   
-  // Print debug message
-  Serial.print("Current: ");
-  Serial.print(amps, 3);
-  Serial.println(" A");
+  // Log debug message
+  Log::value<DEBUG_LOG_DEBUG, LOG_POWER>("Current", amps, 3, "A");
   
   // Send comm message
-  Serial1.print("$AIN");
-  Serial1.print(amps, 3);
-  Serial1.print("T");
-  Serial1.println(millis());
+  record_value(TELEMETRY_AIN, amps, 3, acquired);
+}
+
+void save_ground_level() {
+  unsigned long words[2] = { GROUND_LEVEL_MAGIC, (unsigned long)ground_level_pressure };
+  
+  // Little endian, a byte at a time
+  for (int i = 0; i < 8; i++) {
+    EEPROM.write(EEPROM_GROUND_LEVEL + i, (byte)(words[i / 4] >> (8 * (i % 4))));
+  }
+}
+
+/**
+ * The pressure at ground level as save_ground_level() left it
+ * @return false if it never did
+ */
+boolean load_ground_level() {
+  unsigned long words[2] = { 0ul, 0ul };
+  
+  for (int i = 0; i < 8; i++) {
+    words[i / 4] |= (unsigned long)EEPROM.read(EEPROM_GROUND_LEVEL + i) << (8 * (i % 4));
+  }
+  if (words[0] != GROUND_LEVEL_MAGIC) return false;
+  ground_level_pressure = (int)words[1];
+  return true;
 }
 
 /**
  * http://learn.adafruit.com/bmp085/using-the-bmp085
  */
 void send_altitude() {
-  unsigned long current_time = millis();
-  static unsigned long previous_time;
-  static float previous_altitude;
-  float current_altitude;
+  const uint32_t current_time = altitude_filter.time();
+  static uint32_t previous_time;
+  float altitude;
   float climb;
   
-  // Read pressure sensor
-  current_altitude = bmp->readAltitude(ground_level_pressure);
-  
-  // Determine climb rate
-  climb = (current_altitude - previous_altitude)
-    / (1000.0 / (float)(current_time - previous_time));
-  
+  // Nothing new since the last run, or no pressure sample yet
+  if (!altitude_filter.started() || current_time == previous_time) {
+    return;
+  }
   previous_time = current_time;
-  previous_altitude = current_altitude;
   
-  // Print debug message
-  Serial.print("Altitude: ");
-  Serial.print(current_altitude, 6);
-  Serial.println(" m");
+  // Latest estimate
+  altitude = altitude_filter.altitude();
+  climb = altitude_filter.climb();
   
-  Serial.print("Climb rate: ");
-  Serial.print(climb, 6);
-  Serial.println(" m/s");
+  // Log debug message
+  Log::value<DEBUG_LOG_DEBUG, LOG_ALTITUDE>("Altitude", altitude, 6, "m");
+  Log::value<DEBUG_LOG_DEBUG, LOG_ALTITUDE>("Climb rate", climb, 6, "m/s");
+  Log::value<DEBUG_LOG_DEBUG, LOG_ALTITUDE>("Accel bias", altitude_filter.accelBias(), 3, "m/s2");
   
   // Send comm message
-  Serial1.print("$ALT");
-  Serial1.print(current_altitude, 6);
-  Serial1.print("T");
-  Serial1.println(current_time);
+  record_value(TELEMETRY_ALT, altitude, 6, current_time);
   
-  Serial1.print("$CLB");
-  Serial1.print(climb, 6);
-  Serial1.print("T");
-  Serial1.println(current_time);
+  record_value(TELEMETRY_CLB, climb, 6, current_time);
 }
 
 /**
  * https://github.com/sparkfun/MPU-9150_Breakout
  */
 void send_attitude() {
-  const unsigned long current_time = millis();
-  unsigned short count = mpu->getFIFOCount();
-  Quaternion q;
-  byte buffer[64];
+  static unsigned long sent = 0;
+  unsigned long count;
   
-  // Reset in order to continue cleanly
-  if (count == 1024) {
-    mpu->resetFIFO();
-    count = mpu->getFIFOCount();
+  // Every packet drained from the DMP since the last run, oldest first.
+  // Text only has room for the newest.
+  count = min(dmp_samples - sent, (unsigned long)DMP_QUEUE_SIZE);
+  if (TELEMETRY_FORMAT != TELEMETRY_BINARY) {
+    count = min(count, 1ul);
   }
+  sent = dmp_samples;
   
-  // Wait for the correct available data length
-  while (count < dmp_packet_size) count = mpu->getFIFOCount();
-  
-  // Read a packet from the sensor's FIFO
-  mpu->getFIFOBytes(buffer, dmp_packet_size);
-  
-  // Get a quaternion from the buffer
-  mpu->dmpGetQuaternion(&q, buffer);
+  while (count > 0) {
+    const MPU6050_DMPSample &sample = dmp_queue[(dmp_head - count) & (DMP_QUEUE_SIZE - 1)];
+    const Quaternion &q = sample.q;
+    count--;
+    
+    // Log debug message
+    Log::value<DEBUG_LOG_DEBUG, LOG_ATTITUDE>("Attitude W", q.w, 4);
+    Log::value<DEBUG_LOG_DEBUG, LOG_ATTITUDE>("Attitude X", q.x, 4);
+    Log::value<DEBUG_LOG_DEBUG, LOG_ATTITUDE>("Attitude Y", q.y, 4);
+    Log::value<DEBUG_LOG_DEBUG, LOG_ATTITUDE>("Attitude Z", q.z, 4);
+    
+    // Send comm message
+    record_value(TELEMETRY_AQW, q.w, 6, sample.timestamp);
+    
+    record_value(TELEMETRY_AQX, q.x, 6, sample.timestamp);
+    
+    record_value(TELEMETRY_AQY, q.y, 6, sample.timestamp);
+    
+    record_value(TELEMETRY_AQZ, q.z, 6, sample.timestamp);
+  }
+}
+
+/**
+ * Interrupt handler for the MPU INT pin. Bus traffic stays out of the ISR,
+ * the main loop does the draining.
+ */
+void dmp_data_ready() {
+  mpu_interrupt_micros = micros();
+  mpu_interrupt = true;
+}
+
+/**
+ * Called from the I2C interrupt once the FIFO count is in. The DMP raises
+ * INT once a packet is in the FIFO, so the newest packet counted is the one
+ * the latest pulse announced.
+ */
+void dmp_counted(I2Ctransfer *transfer) {
+  dmp_count_micros = mpu_interrupt_micros;
+}
+
+/**
+ * One step of moving packets off the DMP: the FIFO count is read after an
+ * interrupt, then the packets it counts, each read queued on the bus and
+ * picked up on a later pass once it has finished.
+ * https://github.com/jrowberg/i2cdevlib/tree/master/Arduino/MPU6050/Examples/MPU6050_DMP6
+ */
+void drain_dmp_fifo() {
+  unsigned short count;
+  unsigned char batch;
   
-  // Print debug message
-  Serial.print("Attitude:");
-  Serial.print(" W=");
-  Serial.print(q.w, 4);
-  Serial.print(" X=");
-  Serial.print(q.x, 4);
-  Serial.print(" Y=");
-  Serial.print(q.y, 4);
-  Serial.print(" Z=");
-  Serial.println(q.z, 4);
+  // A transfer the bus never finishes would stop attitude for good and hold
+  // up every blocking read behind it, so it is taken back and fails
+  if (dmp_transfer.pending()) {
+    if (micros() - dmp_transfer_micros < DMP_TRANSFER_TIMEOUT) {
+      return;
+    }
+    I2Cqueue::cancel(&dmp_transfer);
+  }
   
-  // Send comm message
-  Serial1.print("$AQW");
-  Serial1.print(q.w, 6);
-  Serial1.print("T");
-  Serial1.println(current_time);
+  if (dmp_read_state == DMP_COUNTING) {
+    dmp_read_state = DMP_IDLE;
+    if (dmp_transfer.status != I2CQUEUE_DONE) {
+      Log::text<DEBUG_LOG_WARNING, LOG_MPU>("DMP FIFO count failed");
+      return;
+    }
+    count = ((unsigned short)dmp_buffer[0] << 8) | dmp_buffer[1];
+    
+    // An overflow leaves the FIFO out of step with the packet boundaries, so
+    // the only way back is a reset. Draining on every interrupt keeps it from
+    // happening unless the loop stalls for a whole FIFO's worth of packets.
+    if (count >= MPU_FIFO_SIZE) {
+      mpu->resetFIFO();
+      Log::text<DEBUG_LOG_WARNING, LOG_MPU>("DMP FIFO overflow");
+      return;
+    }
+    
+    // Earlier packets came at the DMP rate before the newest
+    dmp_unread = count / dmp_packet_size;
+    dmp_next_stamp = dmp_count_micros - (dmp_unread - 1) * DMP_PERIOD;
+  } else if (dmp_read_state == DMP_READING) {
+    dmp_read_state = DMP_IDLE;
+    if (dmp_transfer.status != I2CQUEUE_DONE) {
+      // Part of a packet may have been clocked out already, which would put
+      // every later read off the packet boundaries, so it goes the way of an
+      // overflow. Counted again on the next interrupt.
+      mpu->resetFIFO();
+      dmp_unread = 0;
+      Log::text<DEBUG_LOG_WARNING, LOG_MPU>("DMP FIFO read failed");
+      return;
+    }
+    batch = dmp_transfer.length / dmp_packet_size;
+    mpu->dmpParseFIFOSamples(&dmp_queue[dmp_head], dmp_buffer, batch);
+    
+    // The altitude filter runs at the DMP rate, oldest packet first
+    for (unsigned char i = 0; i < batch; i++) {
+      dmp_queue[dmp_head + i].timestamp = dmp_next_stamp;
+      dmp_next_stamp += DMP_PERIOD;
+      fuse_accel(dmp_queue[dmp_head + i]);
+    }
+    dmp_head = (dmp_head + batch) & (DMP_QUEUE_SIZE - 1);
+    dmp_samples += batch;
+    dmp_unread -= batch;
+  }
   
-  Serial1.print("$AQX");
-  Serial1.print(q.x, 6);
-  Serial1.print("T");
-  Serial1.println(current_time);
+  if (dmp_unread > 0) {
+    // Every complete packet counted, in reads up to the end of the queue
+    batch = min(dmp_unread, min(MPU6050_DMP_BATCH_PACKETS, DMP_QUEUE_SIZE - dmp_head));
+    if (mpu->startFIFOStream(&dmp_transfer, dmp_buffer, batch * dmp_packet_size)) {
+      dmp_read_state = DMP_READING;
+      dmp_transfer_micros = micros();
+    }
+  } else if (mpu_interrupt) {
+    // INT is a pulse, so there is no status to read back and clear
+    mpu_interrupt = false;
+    if (mpu->startFIFOCount(&dmp_transfer, dmp_buffer, dmp_counted)) {
+      dmp_read_state = DMP_COUNTING;
+      dmp_transfer_micros = micros();
+    }
+  }
+}
+
+/**
+ * https://github.com/jrowberg/i2cdevlib/tree/master/Arduino/MPU6050/Examples/MPU6050_DMP6
+ */
+void fuse_accel(const MPU6050_DMPSample &sample) {
+  Quaternion q = sample.q;
+  VectorInt16 accel = sample.accel;
+  VectorFloat gravity;
+  VectorInt16 linear;
+  VectorInt16 world;
   
-  Serial1.print("$AQY");
-  Serial1.print(q.y, 6);
-  Serial1.print("T");
-  Serial1.println(current_time);
+  // Gravity removed and turned into the world frame, +1 g = 4096
+  mpu->dmpGetGravity(&gravity, &q);
+  mpu->dmpGetLinearAccel(&linear, &accel, &gravity);
+  mpu->dmpGetLinearAccelInWorld(&world, &linear, &q);
   
-  Serial1.print("$AQZ");
-  Serial1.print(q.z, 6);
-  Serial1.print("T");
-  Serial1.println(current_time);
+  altitude_filter.addAccel(world.z * (9.80665f / 4096.0f), sample.timestamp);
 }
 
 /**
@@ -365,9 +827,11 @@ void send_attitude() {
  */
 void send_heading() {
   int16_t ax, ay, az, gx, gy, gz, mx, my, mz;
+  unsigned long acquired;
   float heading;
   
   // Read sensor
+  acquired = micros();
   mpu->getMotion9(&ax, &ay, &az,
                   &gx, &gy, &gz,
                   &mx, &my, &mz);
@@ -382,58 +846,219 @@ void send_heading() {
     heading = 180.0;
   } else if (my == 0 && mx > 0) {
     heading = 0.0;
+  } else {
+    // No horizontal field reading, so no heading to report
+    return;
   }
   
-  // Print debug message
-  Serial.print("Heading: ");
-  Serial.print(heading, 2);
-  Serial.println(" deg");
+  // Log debug message
+  Log::value<DEBUG_LOG_DEBUG, LOG_HEADING>("Heading", heading, 2, "deg");
   
   // Send comm message
-  Serial1.print("$HDG");
-  Serial1.print(heading, 2);
-  Serial1.print("T");
-  Serial1.println(millis());
+  record_value(TELEMETRY_HDG, heading, 2, acquired);
+}
+
+/**
+ * u-blox 6 Receiver Description, CFG-PRT, CFG-MSG and CFG-RATE
+ */
+void configure_gps(boolean warm) {
+  GpsSetup gps_setup(Serial2, ubx);
+  GpsSetup::Result result;
+  
+  // A receiver still at GPS_BAUD has kept everything set below
+  if (warm && gps_setup.resume(GPS_BAUD)) {
+    Serial.print(F("GPS still set up at "));
+    Serial.print(GPS_BAUD);
+    Serial.println(F(" baud"));
+    return;
+  }
+  
+  if (GPS_PROTOCOL == GPS_UBX) {
+    result = gps_setup.begin(GPS_BAUD, GPS_PERIODS, sizeof(GPS_PERIODS) / sizeof(GPS_PERIODS[0]),
+                             UBX_PROTOCOL_UBX, GPS_UBX_MESSAGES, sizeof(GPS_UBX_MESSAGES) / 3);
+  } else {
+    result = gps_setup.begin(GPS_BAUD, GPS_PERIODS, sizeof(GPS_PERIODS) / sizeof(GPS_PERIODS[0]),
+                             UBX_PROTOCOL_NMEA, GPS_NMEA_MESSAGES, sizeof(GPS_NMEA_MESSAGES) / 3);
+  }
+  
+  if (!result.foundBaud) {
+    // Listen at the factory setting in case it is only slow to start
+    Serial2.begin(9600);
+    Serial.println(F("GPS not answering"));
+    return;
+  }
+  Serial.print(F("GPS found at "));
+  Serial.print(result.foundBaud);
+  Serial.print(F(" baud, now "));
+  Serial.print(result.baud);
+  Serial.print(F(" baud, "));
+  Serial.print(result.period);
+  Serial.print(F(" ms, "));
+  Serial.print(result.rejected);
+  Serial.println(F(" settings refused"));
 }
 
 /**
  * http://arduiniana.org/libraries/tinygps/
  */
+void feed_gps() {
+  char buffer[GPS_READ_SIZE];
+  unsigned long received;
+  unsigned long pulse;
+  int n;
+  
+  // A timepulse has to reach the clock before the solution naming its
+  // second does
+  if (gps_pulse_pending) {
+    noInterrupts();
+    pulse = gps_pulse_micros;
+    gps_pulse_pending = false;
+    interrupts();
+    time_sync.pulse(pulse);
+  }
+  
+  while (Serial2.available()) {
+    // Copy out what has arrived, then parse it in one go
+    received = micros();
+    n = 0;
+    while (n < GPS_READ_SIZE && Serial2.available()) {
+      buffer[n++] = Serial2.read();
+    }
+    if (GPS_PROTOCOL == GPS_UBX) {
+      ubx.encode((const uint8_t *)buffer, n);
+      if (ubx.updated() & UBX_UPDATED_POSITION) {
+        gps_fix = true;
+        gps_fix_micros = received;
+        gps_solution(received);
+      }
+    } else if (gps->encode(buffer, n)) {
+      gps_fix = true;
+      gps_fix_micros = received;
+      gps_solution(received);
+    }
+  }
+}
+
+/**
+ * Interrupt handler for the GPS PPS pin. Only the time is taken here, the
+ * main loop passes it on.
+ */
+void gps_pulse() {
+  gps_pulse_micros = micros();
+  gps_pulse_pending = true;
+}
+
+/**
+ * Tells the clock when a solution arrived, the first time its UTC is seen
+ */
+void gps_solution(unsigned long received) {
+  static unsigned long previous_utc = TIME_SYNC_DAY_MILLIS;
+  unsigned long utc;
+  
+  if (!gps_utc(&utc) || utc == previous_utc) {
+    return;
+  }
+  previous_utc = utc;
+  time_sync.solution(utc, received);
+}
+
+/**
+ * UTC of the latest solution, in ms into the day
+ */
+boolean gps_utc(unsigned long *utc) {
+  unsigned long date;
+  unsigned long time;  // hhmmsscc
+  uint32_t ubx_utc;
+  
+  if (GPS_PROTOCOL == GPS_UBX) {
+    if (!ubx.utc(ubx.position().tow, &ubx_utc)) {
+      return false;
+    }
+    *utc = ubx_utc;
+    return true;
+  }
+  
+  gps->get_datetime(&date, &time);
+  if (time == TinyGPS::GPS_INVALID_TIME) {
+    return false;
+  }
+  *utc = (time / 1000000) * 3600000ul + (time / 10000 % 100) * 60000ul +
+         (time / 100 % 100) * 1000ul + (time % 100) * 10ul;
+  return true;
+}
+
+/**
+ * micros() when the latest fix was taken, or when it arrived while the
+ * clock is not synchronized to GPS yet
+ */
+unsigned long fix_time() {
+  unsigned long utc;
+  
+  if (time_sync.synced() && gps_utc(&utc)) {
+    return time_sync.local(utc);
+  }
+  return gps_fix_micros;
+}
+
+/**
+ * millis() at a micros() time. micros() wraps long before millis() does,
+ * so this goes by the distance from now.
+ */
+unsigned long millis_at(uint32_t local) {
+  const uint32_t current_time = millis();
+  const int32_t d = (int32_t)(local - (uint32_t)(current_time * 1000u));
+  
+  return current_time + (d >= 0 ? d / 1000 : -((999 - d) / 1000));
+}
+
+/**
+ * Sends the fix from the last complete sentence, once.
+ */
 void send_position() {
-  const unsigned long current_time = millis();
+  unsigned long timestamp;
   unsigned long age;
-  float lat;
-  float lon;
+  long lat;  // Microdegrees
+  long lon;
   
-  while (Serial2.available()) {
-    if (gps->encode(Serial2.read())) {
-      gps->f_get_position(&lat, &lon, &age);
+  if (!gps_fix) {
+    return;
+  }
+  gps_fix = false;
+  timestamp = fix_time();
+  
+  if (GPS_PROTOCOL == GPS_UBX) {
+    if (ubx.hasFix()) {
+      const UbxGps::Position &position = ubx.position();
       
-      if (age == TinyGPS::GPS_INVALID_AGE) {
-        // No signal
-      } else if (age > 5000) {
-        // Signal lost
-      } else {
-        // Valid signal
-        // Print debug message
-        Serial.print("Latitude: ");
-        Serial.println(lat, 6);
-        
-        Serial.print("Longitude: ");
-        Serial.println(lon, 6);
-        
-        // Send comm message
-        Serial1.print("$LAT");
-        Serial1.print(lat, 6);
-        Serial1.print("T");
-        Serial1.println(current_time);
-        
-        Serial1.print("$LON");
-        Serial1.print(lon, 6);
-        Serial1.print("T");
-        Serial1.println(current_time);
-      }
+      // Log debug message
+      Log::value<DEBUG_LOG_DEBUG, LOG_POSITION>("Latitude", position.latitude / 1e7f, 7);
+      Log::value<DEBUG_LOG_DEBUG, LOG_POSITION>("Longitude", position.longitude / 1e7f, 7);
+      Log::value<DEBUG_LOG_DEBUG, LOG_POSITION>("Accuracy", position.horizontalAccuracy / 1e3f, 1, "m");
+      
+      // Send comm message, at the 1e-7 degrees UBX resolves
+      record_fixed(TELEMETRY_LAT, position.latitude, 7, timestamp);
+      
+      record_fixed(TELEMETRY_LON, position.longitude, 7, timestamp);
     }
+    return;
+  }
+  
+  gps->get_position(&lat, &lon, &age);
+  
+  if (age == TinyGPS::GPS_INVALID_AGE) {
+    // No signal
+  } else if (age > 5000) {
+    // Signal lost
+  } else {
+    // Valid signal
+    // Log debug message
+    Log::value<DEBUG_LOG_DEBUG, LOG_POSITION>("Latitude", lat / 1e6f, 6);
+    Log::value<DEBUG_LOG_DEBUG, LOG_POSITION>("Longitude", lon / 1e6f, 6);
+    
+    // Send comm message
+    record_fixed(TELEMETRY_LAT, lat, 6, timestamp);
+    
+    record_fixed(TELEMETRY_LON, lon, 6, timestamp);
   }
 }
 
@@ -443,14 +1068,16 @@ void send_position() {
 void send_airspeed() {
   const float a0 = 340.29;                 // Speed of sound at sea level (m/s)
   const float t0 = 15.0;                   // Standard sea level temperature (C)
-  const float t = bmp->readTemperature();  // Measured temperature (C)
+  const float t = bmp->getTemperature();   // Measured temperature (C)
   float qc_over_p;                         // Measured differential pressure
   float vt;                                // True velocity (m/s)
+  unsigned long acquired;
   
   // Read the differential pressure sensor
   // P(at 5V) = Vo - (2.5 +- 6.25%)
   // P(at 3V) = Vo - (1.5 +- 3.75%)
   select_adc_mux(AIRSPEED_SENSOR);
+  acquired = micros();
   qc_over_p = ((float)analogRead(ANALOG_MUX_SIG) *
     (VREF / ADC_MAX)) - (1.5 - 0.2);
   
@@ -462,38 +1089,30 @@ void send_airspeed() {
       * (t / t0));
   }
   
-  // Print debug message
-  Serial.print("Airspeed: ");
-  Serial.print(vt, 6);
-  Serial.println(" m/s");
+  // Log debug message
+  Log::value<DEBUG_LOG_DEBUG, LOG_AIRSPEED>("Airspeed", vt, 6, "m/s");
   
   // Send comm message
-  Serial1.print("$SPD");
-  Serial1.print(vt, 6);
-  Serial1.print("T");
-  Serial1.println(millis());
+  record_value(TELEMETRY_SPD, vt, 6, acquired);
 }
 
 /**
  * https://www.sparkfun.com/products/9028
  */
 void send_voltage_measure() {
+  unsigned long acquired;
   float voltage;
   
   // Read the voltage sensor and convert to volts
   select_adc_mux(VOLTAGE_SENSOR);
+  acquired = micros();
   voltage = (float)analogRead(ANALOG_MUX_SIG) / 45.4082;
   
-  // Print debug message
-  Serial.print("Voltage: ");
-  Serial.print(voltage, 3);
-  Serial.println(" V");
+  // Log debug message
+  Log::value<DEBUG_LOG_DEBUG, LOG_POWER>("Voltage", voltage, 3, "V");
   
   // Send comm message
-  Serial1.print("$VIN");
-  Serial1.print(voltage, 3);
-  Serial1.print("T");
-  Serial1.println(millis());
+  record_value(TELEMETRY_VIN, voltage, 3, acquired);
 }
 
 /**
@@ -502,19 +1121,39 @@ void send_voltage_measure() {
 void send_temperature() {
   float t;
   
-  // Read the temperature sensor
-  t = bmp->readTemperature();
+  // Latest temperature sample
+  t = bmp->getTemperature();
   
-  // Print debug message
-  Serial.print("Temperature: ");
-  Serial.print(t, 4);
-  Serial.println(" C");
+  // Log debug message
+  Log::value<DEBUG_LOG_DEBUG, LOG_TEMPERATURE>("Temperature", t, 4, "C");
   
   // Send comm message
-  Serial1.print("$TMP");
-  Serial1.print(t, 4);
-  Serial1.print("T");
-  Serial1.println(millis());
+  record_value(TELEMETRY_TMP, t, 4, bmp->getTemperatureTime());
+}
+
+/**
+ * UTC at the timestamp the record goes out under, and the clock drift
+ */
+void send_time_sync() {
+  // On a millisecond tick, so that the record holds exactly for the
+  // timestamp it goes out under
+  const uint32_t local = (uint32_t)(millis() * 1000ul);
+  unsigned long utc;
+  uint16_t micros_past;
+  
+  if (!time_sync.synced()) {
+    return;
+  }
+  utc = time_sync.utc(local, &micros_past);
+  
+  // Log debug message
+  Log::value<DEBUG_LOG_DEBUG, LOG_TIME>("UTC", utc / 1000.0f, 3, "s");
+  Log::value<DEBUG_LOG_DEBUG, LOG_TIME>("Clock drift", time_sync.drift(), 2, "ppm");
+  
+  // Send comm message, in 0.1 ms
+  record_fixed(TELEMETRY_UTC, utc * 10 + (micros_past + 50) / 100, 4, local);
+  
+  record_value(TELEMETRY_DRF, time_sync.drift(), 2, local);
 }
 
 void select_adc_mux(int pin) {
@@ -542,3 +1181,162 @@ void select_adc_mux(int pin) {
     digitalWrite(ANALOG_MUX_S3, LOW);
   }
 }
+
+/**
+ * Queues a value for the radio, with the micros() it was measured at
+ */
+void record_value(int channel, float value, int digits, unsigned long timestamp) {
+  TelemetrySample sample;
+  
+  sample.channel = channel;
+  sample.timestamp = timestamp;
+  sample.setValue(value, digits);
+  samples.push(sample);
+}
+
+/**
+ * record_value() for a value in units of 10^-decimals
+ */
+void record_fixed(int channel, long value, int decimals, unsigned long timestamp) {
+  TelemetrySample sample;
+  
+  sample.channel = channel;
+  sample.timestamp = timestamp;
+  sample.setFixed(value, decimals);
+  samples.push(sample);
+}
+
+/**
+ * Passes queued samples on to the frame or the text link, timestamped with
+ * the millis() at which they were measured
+ */
+void send_samples() {
+  TelemetrySample sample;
+  
+  while (samples.pop(&sample)) {
+    if (sample.fixed) {
+      send_fixed(sample.channel, sample.fixedValue, sample.decimals, millis_at(sample.timestamp));
+    } else {
+      send_value(sample.channel, sample.value, sample.decimals, millis_at(sample.timestamp));
+    }
+  }
+}
+
+/**
+ * Sends one value as a text message or adds it to the binary frame,
+ * depending on TELEMETRY_FORMAT
+ */
+void send_value(int channel, float value, int digits, unsigned long timestamp) {
+  char number[TELEMETRY_NUMBER_MAX];
+  
+  add_to_frame(channel, timestamp);
+  if (TELEMETRY_FORMAT == TELEMETRY_BINARY) {
+    frame.set(channel, value);
+    return;
+  }
+  
+  TelemetryFormat::formatFloat(number, value, digits);
+  send_message(channel, number, timestamp);
+}
+
+/**
+ * send_value() for a value in units of 10^-decimals, e.g. microdegrees,
+ * which both formats carry without rounding it through a float
+ */
+void send_fixed(int channel, long value, int decimals, unsigned long timestamp) {
+  char number[TELEMETRY_NUMBER_MAX];
+  
+  add_to_frame(channel, timestamp);
+  if (TELEMETRY_FORMAT == TELEMETRY_BINARY) {
+    frame.setFixed(channel, value, decimals);
+    return;
+  }
+  
+  TelemetryFormat::formatFixed(number, value, decimals);
+  send_message(channel, number, timestamp);
+}
+
+void add_to_frame(int channel, unsigned long timestamp) {
+  const long apart = (long)(timestamp - frame.timestamp());
+  
+  // A task that comes round again before the frame went out starts the next
+  // one instead of overwriting its own values, and so does a value measured
+  // at another time, such as a GPS fix
+  if (frame_open && (frame.has(channel) || apart > (long)FRAME_TIME_SLACK ||
+                     apart < -(long)FRAME_TIME_SLACK)) {
+    send_frame();
+  }
+  
+  if (!frame_open) {
+    frame.begin(timestamp);
+    frame_open = true;
+  }
+}
+
+/**
+ * One text message, written to the radio in one go
+ */
+void send_message(int channel, const char *number, unsigned long timestamp) {
+  char message[TEXT_MESSAGE_MAX];
+  int n = 0;
+  
+  message[n++] = '$';
+  memcpy(message + n, TelemetryFrame::code(channel), 3);
+  n += 3;
+  n += strlen(strcpy(message + n, number));
+  message[n++] = 'T';
+  n += TelemetryFormat::formatUnsigned(message + n, timestamp);
+  message[n++] = '\r';
+  message[n++] = '\n';
+  
+  if (sheddable(channel) && (int)radio.used() > SHED_TEXT_LEVEL) {
+    shed_values++;
+    return;
+  }
+  radio.push((const uint8_t *)message, n);
+}
+
+boolean sheddable(int channel) {
+  for (int i = 0; i < SHED_COUNT; i++) {
+    if (SHED_ORDER[i] == channel) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * http://www.stuartcheshire.org/papers/COBSforToN.pdf
+ */
+void send_frame() {
+  byte buffer[TELEMETRY_FRAME_MAX];
+  
+  frame_open = false;
+  if (TELEMETRY_FORMAT != TELEMETRY_BINARY) {
+    return;
+  }
+  
+  // Rather than wait for the radio, leave out the least important values
+  // until the frame fits
+  for (int i = 0; i < SHED_COUNT && frame.maxEncodedLength() > radio.free(); i++) {
+    if (frame.has(SHED_ORDER[i])) {
+      frame.remove(SHED_ORDER[i]);
+      shed_values++;
+    }
+  }
+  radio.push(buffer, frame.encode(buffer));
+}
+
+/**
+ * Hands queued bytes to the UART, as many as its buffer has room for
+ */
+void send_radio() {
+  const uint8_t *data;
+  size_t n;
+  
+  n = min(radio.peek(&data), (size_t)Serial1.availableForWrite());
+  if (n > 0) {
+    Serial1.write(data, n);
+    radio.consume(n);
+  }
+}
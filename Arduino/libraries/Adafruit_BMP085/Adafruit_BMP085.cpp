@@ -18,6 +18,15 @@
 #include <util/delay.h>
 
 Adafruit_BMP085::Adafruit_BMP085() {
+  state = BMP085_IDLE;
+  sampleUnreported = false;
+  sampleB5 = 0;
+  samplePressure = 0;
+  sampleB5Micros = 0;
+  samplePressureMicros = 0;
+  cachedB5Micros = 0;
+  cachedB5Valid = false;
+  temperatureMaxAge = BMP085_TEMPERATURE_MAX_AGE;
 }
 
 
@@ -25,8 +34,9 @@ boolean Adafruit_BMP085::begin(uint8_t mode) {
   if (mode > BMP085_ULTRAHIGHRES) 
     mode = BMP085_ULTRAHIGHRES;
   oversampling = mode;
-
-  Wire.begin();
+  state = BMP085_IDLE;
+  sampleUnreported = false;
+  cachedB5Valid = false;
 
   if (read8(0xD0) != 0x55) return false;
 
@@ -59,21 +69,25 @@ boolean Adafruit_BMP085::begin(uint8_t mode) {
   Serial.print("mc = "); Serial.println(mc, DEC);
   Serial.print("md = "); Serial.println(md, DEC);
 #endif
+
+  return true;
 }
 
 uint16_t Adafruit_BMP085::readRawTemperature(void) {
-  write8(BMP085_CONTROL, BMP085_READTEMPCMD);
+  finishSample();
+  startTemperature();
   _delay_ms(5);
 #if BMP085_DEBUG == 1
   Serial.print("Raw temp: "); Serial.println(read16(BMP085_TEMPDATA));
 #endif
-  return read16(BMP085_TEMPDATA);
+  return collectRawTemperature();
 }
 
 uint32_t Adafruit_BMP085::readRawPressure(void) {
   uint32_t raw;
 
-  write8(BMP085_CONTROL, BMP085_READPRESSURECMD + (oversampling << 6));
+  finishSample();
+  startPressure();
 
   if (oversampling == BMP085_ULTRALOWPOWER) 
     _delay_ms(5);
@@ -84,11 +98,7 @@ uint32_t Adafruit_BMP085::readRawPressure(void) {
   else 
     _delay_ms(26);
 
-  raw = read16(BMP085_PRESSUREDATA);
-
-  raw <<= 8;
-  raw |= read8(BMP085_PRESSUREDATA+2);
-  raw >>= (8 - oversampling);
+  raw = collectRawPressure();
 
  /* this pull broke stuff, look at it later?
   if (oversampling==0) {
@@ -106,15 +116,13 @@ uint32_t Adafruit_BMP085::readRawPressure(void) {
 
 
 int32_t Adafruit_BMP085::readPressure(void) {
-  int32_t UT, UP, B3, B5, B6, X1, X2, X3, p;
-  uint32_t B4, B7;
+  int32_t B5, UP;
 
-  UT = readRawTemperature();
+  B5 = currentB5();
   UP = readRawPressure();
 
 #if BMP085_DEBUG == 1
   // use datasheet numbers!
-  UT = 27898;
   UP = 23843;
   ac6 = 23153;
   ac5 = 32757;
@@ -127,12 +135,236 @@ int32_t Adafruit_BMP085::readPressure(void) {
   ac1 = 408;
   ac4 = 32741;
   oversampling = 0;
+  B5 = computeB5(27898);
+#endif
+
+  return computePressure(B5, UP);
+}
+
+
+float Adafruit_BMP085::readTemperature(void) {
+  int32_t B5;     // following ds convention
+
+  B5 = currentB5();
+
+#if BMP085_DEBUG == 1
+  // use datasheet numbers!
+  ac6 = 23153;
+  ac5 = 32757;
+  mc = -8711;
+  md = 2868;
+  B5 = computeB5(27898);
 #endif
 
+  return computeTemperature(B5);
+}
+
+void Adafruit_BMP085::readSample(bmp085_sample_t *sample) {
+  int32_t B5 = currentB5();
+
+  sample->temperature = computeTemperature(B5);
+  sample->pressure = computePressure(B5, readRawPressure());
+}
+
+float Adafruit_BMP085::readAltitude(float sealevelPressure) {
+  return pressureToAltitude(readPressure(), sealevelPressure);
+}
+
+// 44330 * (1 - r^0.1903) for r = p / p0 from 0.45 to 1.09 in steps of 0.01,
+// about 6250 m down to -730 m
+#define BMP085_ALTITUDE_RATIO_MIN  0.45f
+#define BMP085_ALTITUDE_RATIO_STEP 0.01f
+#define BMP085_ALTITUDE_TABLE_SIZE 65
+
+static const float altitudeTable[BMP085_ALTITUDE_TABLE_SIZE] = {
+  6249.3746, 6089.7655, 5932.9417, 5778.7967, 5627.2303,
+  5478.1482, 5331.4611, 5187.0847, 5044.9392, 4904.9490,
+  4767.0424, 4631.1512, 4497.2109, 4365.1600, 4234.9399,
+  4106.4947, 3979.7715, 3854.7193, 3731.2897, 3609.4364,
+  3489.1151, 3370.2835, 3252.9009, 3136.9283, 3022.3286,
+  2909.0659, 2797.1059, 2686.4154, 2576.9629, 2468.7177,
+  2361.6505, 2255.7331, 2150.9381, 2047.2394, 1944.6116,
+  1843.0304, 1742.4722, 1642.9142, 1544.3344, 1446.7117,
+  1350.0256, 1254.2561, 1159.3841, 1065.3909,  972.2587,
+   879.9700,  788.5078,  697.8559,  607.9983,  518.9197,
+   430.6052,  343.0401,  256.2106,  170.1028,   84.7036,
+     0.0000,  -84.0205, -167.3701, -250.0607, -332.1037,
+  -413.5105, -494.2919, -574.4586, -654.0209, -732.9889
+};
+
+float Adafruit_BMP085::pressureToAltitude(int32_t pressure, float sealevelPressure) {
+  float x = (pressure / sealevelPressure - BMP085_ALTITUDE_RATIO_MIN) /
+            BMP085_ALTITUDE_RATIO_STEP;
+
+  // outside the table (or a silly sea level pressure) go the slow way
+  if (!(x >= 0 && x < BMP085_ALTITUDE_TABLE_SIZE - 1))
+    return 44330 * (1.0 - pow(pressure / sealevelPressure, 0.1903));
+
+  uint8_t i = (uint8_t)x;
+  float f = x - i;
+  return altitudeTable[i] + f * (altitudeTable[i + 1] - altitudeTable[i]);
+}
+
+/*********************************************************************/
+
+void Adafruit_BMP085::setTemperatureMaxAge(unsigned long ms) {
+  temperatureMaxAge = ms;
+}
+
+void Adafruit_BMP085::invalidateTemperature(void) {
+  cachedB5Valid = false;
+}
+
+boolean Adafruit_BMP085::temperatureStale(void) {
+  return !cachedB5Valid || millis() - cachedB5Time >= temperatureMaxAge;
+}
+
+void Adafruit_BMP085::cacheB5(int32_t B5) {
+  cachedB5 = B5;
+  cachedB5Time = millis();
+  cachedB5Micros = micros();
+  cachedB5Valid = true;
+}
+
+int32_t Adafruit_BMP085::currentB5(void) {
+  if (temperatureStale()) cacheB5(computeB5(readRawTemperature()));
+  return cachedB5;
+}
+
+/*********************************************************************/
+
+void Adafruit_BMP085::startTemperature(void) {
+  write8(BMP085_CONTROL, BMP085_READTEMPCMD);
+  conversionStart = micros();
+  conversionTime = 5000;
+}
+
+void Adafruit_BMP085::startPressure(void) {
+  write8(BMP085_CONTROL, BMP085_READPRESSURECMD + (oversampling << 6));
+  conversionStart = micros();
+
+  if (oversampling == BMP085_ULTRALOWPOWER) 
+    conversionTime = 5000;
+  else if (oversampling == BMP085_STANDARD) 
+    conversionTime = 8000;
+  else if (oversampling == BMP085_HIGHRES) 
+    conversionTime = 14000;
+  else 
+    conversionTime = 26000;
+}
+
+// Goes by the datasheet conversion time rather than polling the SCO bit,
+// so waiting costs no bus traffic
+boolean Adafruit_BMP085::conversionReady(void) {
+  return micros() - conversionStart >= conversionTime;
+}
+
+uint16_t Adafruit_BMP085::collectRawTemperature(void) {
+  return read16(BMP085_TEMPDATA);
+}
+
+uint32_t Adafruit_BMP085::collectRawPressure(void) {
+  uint32_t raw;
+
+  raw = read16(BMP085_PRESSUREDATA);
+
+  raw <<= 8;
+  raw |= read8(BMP085_PRESSUREDATA+2);
+  raw >>= (8 - oversampling);
+
+  return raw;
+}
+
+boolean Adafruit_BMP085::requestSample(void) {
+  if (state != BMP085_IDLE) return false;
+
+  // Skip the temperature conversion while the cached one is fresh
+  if (temperatureStale()) {
+    startTemperature();
+    state = BMP085_TEMPERATURE;
+  } else {
+    sampleB5 = cachedB5;
+    sampleB5Micros = cachedB5Micros;
+    startPressure();
+    state = BMP085_PRESSURE;
+  }
+  return true;
+}
+
+boolean Adafruit_BMP085::update(void) {
+  if (sampleUnreported) {
+    sampleUnreported = false;
+    return true;
+  }
+  if (state == BMP085_IDLE || !conversionReady()) return false;
+
+  if (state == BMP085_TEMPERATURE) {
+    sampleB5 = computeB5(collectRawTemperature());
+    sampleB5Micros = conversionStart + conversionTime / 2;
+    cacheB5(sampleB5);
+    cachedB5Micros = sampleB5Micros;
+    startPressure();
+    state = BMP085_PRESSURE;
+    return false;
+  }
+
+  samplePressure = computePressure(sampleB5, collectRawPressure());
+  samplePressureMicros = conversionStart + conversionTime / 2;
+  state = BMP085_IDLE;
+  return true;
+}
+
+// A blocking read starting its own conversion in the middle of a cycle
+// would restart the device under it and leave update() to collect the wrong
+// result, so the cycle is run to the end first. The next update() still
+// reports the sample.
+void Adafruit_BMP085::finishSample(void) {
+  while (state != BMP085_IDLE) {
+    if (update()) sampleUnreported = true;
+  }
+}
+
+boolean Adafruit_BMP085::busy(void) {
+  return state != BMP085_IDLE;
+}
+
+float Adafruit_BMP085::getTemperature(void) {
+  return computeTemperature(sampleB5);
+}
+
+int32_t Adafruit_BMP085::getPressure(void) {
+  return samplePressure;
+}
+
+float Adafruit_BMP085::getAltitude(float sealevelPressure) {
+  return pressureToAltitude(samplePressure, sealevelPressure);
+}
+
+void Adafruit_BMP085::getSample(bmp085_sample_t *sample) {
+  sample->temperature = computeTemperature(sampleB5);
+  sample->pressure = samplePressure;
+}
+
+unsigned long Adafruit_BMP085::getSampleTime(void) {
+  return samplePressureMicros;
+}
+
+unsigned long Adafruit_BMP085::getTemperatureTime(void) {
+  return sampleB5Micros;
+}
+
+/*********************************************************************/
+
+int32_t Adafruit_BMP085::computeB5(int32_t UT) {
+  int32_t X1, X2, B5;
+
   // do temperature calculations
-  X1=(UT-(int32_t)(ac6))*((int32_t)(ac5))/pow(2,15);
-  X2=((int32_t)mc*pow(2,11))/(X1+(int32_t)md);
-  B5=X1 + X2;
+  // a signed divide rather than the datasheet's >> 15: it still compiles
+  // to shifts but truncates toward zero like the old pow(2,15) code did,
+  // which matters below about -37 C where X1 goes negative
+  X1 = ((UT - (int32_t)ac6) * (int32_t)ac5) / 32768;
+  X2 = ((int32_t)mc * 2048) / (X1 + (int32_t)md);
+  B5 = X1 + X2;
 
 #if BMP085_DEBUG == 1
   Serial.print("X1 = "); Serial.println(X1);
@@ -140,6 +372,24 @@ int32_t Adafruit_BMP085::readPressure(void) {
   Serial.print("B5 = "); Serial.println(B5);
 #endif
 
+  return B5;
+}
+
+float Adafruit_BMP085::computeTemperature(int32_t B5) {
+  float temp;
+
+  // exact in a float, so this matches the datasheet ((B5 + 8) >> 4) / 10
+  // but keeps the sixteenths
+  temp = (B5 + 8) / 16.0f;
+  temp /= 10;
+
+  return temp;
+}
+
+int32_t Adafruit_BMP085::computePressure(int32_t B5, int32_t UP) {
+  int32_t B3, B6, X1, X2, X3, p;
+  uint32_t B4, B7;
+
   // do pressure calcs
   B6 = B5 - 4000;
   X1 = ((int32_t)b2 * ( (B6 * B6)>>12 )) >> 11;
@@ -190,102 +440,24 @@ int32_t Adafruit_BMP085::readPressure(void) {
 }
 
 
-float Adafruit_BMP085::readTemperature(void) {
-  int32_t UT, X1, X2, B5;     // following ds convention
-  float temp;
-
-  UT = readRawTemperature();
-
-#if BMP085_DEBUG == 1
-  // use datasheet numbers!
-  UT = 27898;
-  ac6 = 23153;
-  ac5 = 32757;
-  mc = -8711;
-  md = 2868;
-#endif
-
-  // step 1
-  X1 = (UT - (int32_t)ac6) * ((int32_t)ac5) / pow(2,15);
-  X2 = ((int32_t)mc * pow(2,11)) / (X1+(int32_t)md);
-  B5 = X1 + X2;
-  temp = (B5+8)/pow(2,4);
-  temp /= 10;
-  
-  return temp;
-}
-
-float Adafruit_BMP085::readAltitude(float sealevelPressure) {
-  float altitude;
-
-  float pressure = readPressure();
-
-  altitude = 44330 * (1.0 - pow(pressure /sealevelPressure,0.1903));
-
-  return altitude;
-}
-
-
 /*********************************************************************/
 
-uint8_t Adafruit_BMP085::read8(uint8_t a) {
-  uint8_t ret;
+// Through I2Cdev, so that the bus is shared with the MPU's queued transfers
 
-  Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device 
-#if (ARDUINO >= 100)
-  Wire.write(a); // sends register address to read from
-#else
-  Wire.send(a); // sends register address to read from
-#endif
-  Wire.endTransmission(); // end transmission
-  
-  Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device 
-  Wire.requestFrom(BMP085_I2CADDR, 1);// send data n-bytes read
-#if (ARDUINO >= 100)
-  ret = Wire.read(); // receive DATA
-#else
-  ret = Wire.receive(); // receive DATA
-#endif
-  Wire.endTransmission(); // end transmission
+uint8_t Adafruit_BMP085::read8(uint8_t a) {
+  uint8_t ret = 0;
 
+  I2Cdev::readByte(BMP085_I2CADDR, a, &ret);
   return ret;
 }
 
 uint16_t Adafruit_BMP085::read16(uint8_t a) {
-  uint16_t ret;
+  uint8_t buffer[2] = { 0, 0 };
 
-  Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device 
-#if (ARDUINO >= 100)
-  Wire.write(a); // sends register address to read from
-#else
-  Wire.send(a); // sends register address to read from
-#endif
-  Wire.endTransmission(); // end transmission
-  
-  Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device 
-  Wire.requestFrom(BMP085_I2CADDR, 2);// send data n-bytes read
-#if (ARDUINO >= 100)
-  ret = Wire.read(); // receive DATA
-  ret <<= 8;
-  ret |= Wire.read(); // receive DATA
-#else
-  ret = Wire.receive(); // receive DATA
-  ret <<= 8;
-  ret |= Wire.receive(); // receive DATA
-#endif
-  Wire.endTransmission(); // end transmission
-
-  return ret;
+  I2Cdev::readBytes(BMP085_I2CADDR, a, 2, buffer);
+  return ((uint16_t)buffer[0] << 8) | buffer[1];
 }
 
 void Adafruit_BMP085::write8(uint8_t a, uint8_t d) {
-  Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device 
-#if (ARDUINO >= 100)
-  Wire.write(a); // sends register address to read from
-  Wire.write(d);  // write data
-#else
-  Wire.send(a); // sends register address to read from
-  Wire.send(d);  // write data
-#endif
-  Wire.endTransmission(); // end transmission
+  I2Cdev::writeByte(BMP085_I2CADDR, a, d);
 }
@@ -19,7 +19,7 @@
 #else
  #include "WProgram.h"
 #endif
-#include "Wire.h"
+#include "I2Cdev.h"
 
 #define BMP085_DEBUG 0
 
@@ -47,6 +47,20 @@
 #define BMP085_READTEMPCMD          0x2E
 #define BMP085_READPRESSURECMD            0x34
 
+// Default max age of the cached temperature compensation (ms)
+#define BMP085_TEMPERATURE_MAX_AGE 1000
+
+// State of the non-blocking measurement cycle
+#define BMP085_IDLE              0
+#define BMP085_TEMPERATURE       1
+#define BMP085_PRESSURE          2
+
+
+/* Compensated temperature and pressure taken together */
+typedef struct {
+  float temperature;  // degrees C
+  int32_t pressure;   // Pa
+} bmp085_sample_t;
 
 class Adafruit_BMP085 {
  public:
@@ -55,16 +69,79 @@ class Adafruit_BMP085 {
   float readTemperature(void);
   int32_t readPressure(void);
   float readAltitude(float sealevelPressure = 101325); // std atmosphere
+  void readSample(bmp085_sample_t *sample);
   uint16_t readRawTemperature(void);
   uint32_t readRawPressure(void);
+
+  // Temperature compensation (B5) is cached and only refreshed with a new
+  // temperature conversion once it is older than this; 0 always refreshes
+  void setTemperatureMaxAge(unsigned long ms);
+  void invalidateTemperature(void);
+
+  // Non-blocking conversions: start, poll until ready, then collect. Not
+  // while busy(), they would cut the cycle below short
+  void startTemperature(void);
+  void startPressure(void);
+  boolean conversionReady(void);
+  uint16_t collectRawTemperature(void);
+  uint32_t collectRawPressure(void);
+
+  // Non-blocking temperature + pressure cycle. requestSample() starts it,
+  // update() must then be called often and returns true once the new
+  // sample is in. The getters return the last completed sample. A blocking
+  // read above waits for a cycle under way to finish before it starts.
+  boolean requestSample(void);
+  boolean update(void);
+  boolean busy(void);
+  float getTemperature(void);
+  int32_t getPressure(void);
+  float getAltitude(float sealevelPressure = 101325);
+  void getSample(bmp085_sample_t *sample);
+
+  // micros() half way through the conversions the last completed sample
+  // came from. The temperature may be older than the pressure, as it is
+  // reused while fresh (see setTemperatureMaxAge)
+  unsigned long getSampleTime(void);
+  unsigned long getTemperatureTime(void);
+
+  // Datasheet compensation of raw readings with the calibration read by
+  // begin(), in integer arithmetic only
+  int32_t computeB5(int32_t UT);
+  float computeTemperature(int32_t B5);
+  int32_t computePressure(int32_t B5, int32_t UP);
+
+  // Barometric formula by table lookup. Within 0.11 m of the exact formula
+  // below 1000 m and 0.36 m up to 6250 m (p/p0 0.45 to 1.09); falls back
+  // to pow() outside that range
+  static float pressureToAltitude(int32_t pressure, float sealevelPressure = 101325);
   
  private:
   uint8_t read8(uint8_t addr);
   uint16_t read16(uint8_t addr);
   void write8(uint8_t addr, uint8_t data);
 
+  int32_t currentB5(void);
+  boolean temperatureStale(void);
+  void finishSample(void);
+  void cacheB5(int32_t B5);
+
   uint8_t oversampling;
 
+  uint8_t state;
+  boolean sampleUnreported;  // finished by a blocking read, update() to say so
+  unsigned long conversionStart;
+  unsigned long conversionTime;
+  int32_t sampleB5;
+  int32_t samplePressure;
+  unsigned long sampleB5Micros;
+  unsigned long samplePressureMicros;
+
+  int32_t cachedB5;
+  unsigned long cachedB5Time;
+  unsigned long cachedB5Micros;
+  unsigned long temperatureMaxAge;
+  boolean cachedB5Valid;
+
   int16_t ac1, ac2, ac3, b1, b2, mb, mc, md;
   uint16_t ac4, ac5, ac6;
 };
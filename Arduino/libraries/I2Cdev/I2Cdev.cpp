@@ -214,6 +214,16 @@ int8_t I2Cdev::readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8
         Serial.print("...");
     #endif
 
+    #if I2CDEV_SHADOW_SIZE > 0
+        // known config registers, no bus traffic
+        if (shadowLoad(devAddr, regAddr, length, data)) {
+            #ifdef I2CDEV_SERIAL_DEBUG
+                Serial.println(". Done (shadowed).");
+            #endif
+            return length;
+        }
+    #endif
+
     int8_t count = 0;
     uint32_t t1 = millis();
 
@@ -272,13 +282,13 @@ int8_t I2Cdev::readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8
 
             // I2C/TWI subsystem uses internal buffer that breaks with large data requests
             // so if user requests more than BUFFER_LENGTH bytes, we have to do it in
-            // smaller chunks instead of all at once
+            // smaller chunks instead of all at once. Each chunk is one transaction: the
+            // register address, then a repeated start and the read, with no STOP between
             for (uint8_t k = 0; k < length; k += min(length, BUFFER_LENGTH)) {
                 Wire.beginTransmission(devAddr);
                 Wire.write(regAddr);
-                Wire.endTransmission();
-                Wire.beginTransmission(devAddr);
-                Wire.requestFrom(devAddr, (uint8_t)min(length - k, BUFFER_LENGTH));
+                Wire.endTransmission(false);
+                Wire.requestFrom(devAddr, (uint8_t)min(length - k, BUFFER_LENGTH), (uint8_t)true);
         
                 for (; Wire.available() && (timeout == 0 || millis() - t1 < timeout); count++) {
                     data[count] = Wire.read();
@@ -287,8 +297,6 @@ int8_t I2Cdev::readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8
                         if (count + 1 < length) Serial.print(" ");
                     #endif
                 }
-        
-                Wire.endTransmission();
             }
         #endif
 
@@ -303,11 +311,21 @@ int8_t I2Cdev::readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8
             count = -1; // error
         }
 
+    #elif (I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE)
+        // queued behind any transfers already waiting, no buffer limit
+        I2Ctransfer transfer;
+        transfer.setRead(devAddr, regAddr, length, data);
+        count = I2Cqueue::run(&transfer, timeout) == I2CQUEUE_DONE ? length : -1;
+
     #endif
 
     // check for timeout
     if (timeout > 0 && millis() - t1 >= timeout && count < length) count = -1; // timeout
 
+    #if I2CDEV_SHADOW_SIZE > 0
+        if (count == length) shadowStore(devAddr, regAddr, length, data, false);
+    #endif
+
     #ifdef I2CDEV_SERIAL_DEBUG
         Serial.print(". Done (");
         Serial.print(count, DEC);
@@ -412,13 +430,13 @@ int8_t I2Cdev::readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint1
 
             // I2C/TWI subsystem uses internal buffer that breaks with large data requests
             // so if user requests more than BUFFER_LENGTH bytes, we have to do it in
-            // smaller chunks instead of all at once
+            // smaller chunks instead of all at once. No STOP between the register address
+            // and the read, as in readBytes()
             for (uint8_t k = 0; k < length * 2; k += min(length * 2, BUFFER_LENGTH)) {
                 Wire.beginTransmission(devAddr);
                 Wire.write(regAddr);
-                Wire.endTransmission();
-                Wire.beginTransmission(devAddr);
-                Wire.requestFrom(devAddr, (uint8_t)(length * 2)); // length=words, this wants bytes
+                Wire.endTransmission(false);
+                Wire.requestFrom(devAddr, (uint8_t)(length * 2), (uint8_t)true); // length=words, this wants bytes
         
                 bool msb = true; // starts with MSB, then LSB
                 for (; Wire.available() && count < length && (timeout == 0 || millis() - t1 < timeout);) {
@@ -436,8 +454,6 @@ int8_t I2Cdev::readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint1
                     }
                     msb = !msb;
                 }
-        
-                Wire.endTransmission();
             }
         #endif
 
@@ -456,6 +472,19 @@ int8_t I2Cdev::readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint1
             count = -1; // error
         }
 
+    #elif (I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE)
+        // read as bytes, then put each MSB/LSB pair together in place
+        I2Ctransfer transfer;
+        uint8_t *bytes = (uint8_t *)data;
+        transfer.setRead(devAddr, regAddr, length * 2, bytes);
+        if (I2Cqueue::run(&transfer, timeout) == I2CQUEUE_DONE) {
+            for (; count < length; count++) {
+                data[count] = ((uint16_t)bytes[2*count] << 8) | bytes[2*count + 1];
+            }
+        } else {
+            count = -1;
+        }
+
     #endif
 
     if (timeout > 0 && millis() - t1 >= timeout && count < length) count = -1; // timeout
@@ -469,6 +498,93 @@ int8_t I2Cdev::readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint1
     return count;
 }
 
+/** Read a long run of bytes from a register that does not auto-increment.
+ * Meant for FIFO data registers. The register address is sent once and the
+ * device keeps pointing at it, so every BUFFER_LENGTH chunk after the first
+ * is a bare read instead of another address write plus read as in
+ * readBytes(). The length is not limited to 255 bytes either. With
+ * I2CDEV_ASYNC_QUEUE the whole run is a single read.
+ * @param devAddr I2C slave device address
+ * @param regAddr FIFO register regAddr to read from
+ * @param length Number of bytes to read
+ * @param data Buffer to store read data in
+ * @param timeout Optional read timeout in milliseconds (0 to disable, leave off to use default class value in I2Cdev::readTimeout)
+ * @return Number of bytes read (-1 indicates failure)
+ */
+int16_t I2Cdev::readStream(uint8_t devAddr, uint8_t regAddr, uint16_t length, uint8_t *data, uint16_t timeout) {
+    #ifdef I2CDEV_SERIAL_DEBUG
+        Serial.print("I2C (0x");
+        Serial.print(devAddr, HEX);
+        Serial.print(") streaming ");
+        Serial.print(length, DEC);
+        Serial.print(" bytes from 0x");
+        Serial.print(regAddr, HEX);
+        Serial.print("...");
+    #endif
+
+    int16_t count = 0;
+    uint32_t t1 = millis();
+
+    #if (I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE)
+
+        Wire.beginTransmission(devAddr);
+        #if (ARDUINO < 100)
+            Wire.send(regAddr);
+            if (Wire.endTransmission() != 0) return -1;
+        #elif (ARDUINO == 100)
+            Wire.write(regAddr);
+            if (Wire.endTransmission() != 0) return -1;
+        #else
+            // repeated start into the first chunk
+            Wire.write(regAddr);
+            if (Wire.endTransmission(false) != 0) return -1;
+        #endif
+
+        for (uint16_t k = 0; k < length; k += BUFFER_LENGTH) {
+            uint8_t chunk = min(length - k, BUFFER_LENGTH);
+            Wire.requestFrom(devAddr, chunk);
+
+            for (; Wire.available() && (timeout == 0 || millis() - t1 < timeout); count++) {
+                #if (ARDUINO < 100)
+                    data[count] = Wire.receive();
+                #else
+                    data[count] = Wire.read();
+                #endif
+            }
+
+            // short read, the device went away
+            if (count < k + chunk) break;
+        }
+
+    #elif (I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE)
+
+        // the queue has no buffer to split the run up for
+        I2Ctransfer transfer;
+        transfer.setRead(devAddr, regAddr, length, data);
+        count = I2Cqueue::run(&transfer, timeout) == I2CQUEUE_DONE ? length : -1;
+
+    #else
+
+        // no way to leave out the address write here, fall back to readBytes()
+        for (uint16_t k = 0; k < length; k += 32) {
+            int8_t n = readBytes(devAddr, regAddr, min(length - k, 32), data + k, timeout);
+            if (n < 0) return -1;
+            count += n;
+        }
+
+    #endif
+
+    if (timeout > 0 && millis() - t1 >= timeout && count < length) count = -1; // timeout
+
+    #ifdef I2CDEV_SERIAL_DEBUG
+        Serial.print(". Done (");
+        Serial.print(count, DEC);
+        Serial.println(" read).");
+    #endif
+
+    return count;
+}
+
 /** write a single bit in an 8-bit device register.
  * @param devAddr I2C slave device address
  * @param regAddr Register regAddr to write to
@@ -593,6 +709,11 @@ bool I2Cdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_
         Serial.print("...");
     #endif
     uint8_t status = 0;
+    #if (I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE)
+        I2Ctransfer transfer;
+        transfer.setWrite(devAddr, regAddr, length, data);
+        if (I2Cqueue::run(&transfer, readTimeout) != I2CQUEUE_DONE) status = 4;
+    #endif
     #if ((I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE && ARDUINO < 100) || I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_NBWIRE)
         Wire.beginTransmission(devAddr);
         Wire.send((uint8_t) regAddr); // send address
@@ -619,12 +740,50 @@ bool I2Cdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_
     #elif (I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE && ARDUINO >= 100)
         status = Wire.endTransmission();
     #endif
+    #if I2CDEV_SHADOW_SIZE > 0
+        // write-through; after a failed write the registers are anyone's guess
+        shadowStore(devAddr, regAddr, length, status == 0 ? data : 0, true);
+    #endif
     #ifdef I2CDEV_SERIAL_DEBUG
         Serial.println(". Done.");
     #endif
     return status == 0;
 }
 
+/** Write a long run of bytes to a register that does not auto-increment.
+ * The counterpart of readStream(), for FIFO and memory data registers: the
+ * length is not limited to 255 bytes, and with I2CDEV_ASYNC_QUEUE the whole
+ * run is a single write. Otherwise it goes out as writeBytes() of up to 31
+ * bytes (what fits in the Wire buffer with the register address in front).
+ * @param devAddr I2C slave device address
+ * @param regAddr FIFO register address to write to
+ * @param length Number of bytes to write
+ * @param data Buffer to copy new data from
+ * @return Status of operation (true = success)
+ */
+bool I2Cdev::writeStream(uint8_t devAddr, uint8_t regAddr, uint16_t length, uint8_t *data) {
+    #if (I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE)
+        #ifdef I2CDEV_SERIAL_DEBUG
+            Serial.print("I2C (0x");
+            Serial.print(devAddr, HEX);
+            Serial.print(") streaming ");
+            Serial.print(length, DEC);
+            Serial.print(" bytes to 0x");
+            Serial.print(regAddr, HEX);
+            Serial.println("...");
+        #endif
+
+        I2Ctransfer transfer;
+        transfer.setWrite(devAddr, regAddr, length, data);
+        return I2Cqueue::run(&transfer, readTimeout) == I2CQUEUE_DONE;
+    #else
+        for (uint16_t k = 0; k < length; k += 31) {
+            if (!writeBytes(devAddr, regAddr, min(length - k, 31), data + k)) return false;
+        }
+        return true;
+    #endif
+}
+
 /** Write multiple words to a 16-bit device register.
  * @param devAddr I2C slave device address
  * @param regAddr First register address to write to
@@ -643,6 +802,29 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16
         Serial.print("...");
     #endif
     uint8_t status = 0;
+    #if (I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE)
+        // MSB first, as the device wants them, a chunk at a time with the
+        // register address moved on past the words already written
+        uint8_t bytes[I2CDEV_WRITE_WORDS_CHUNK * 2];
+        bool done = true;
+        for (uint8_t k = 0; done && k < length; k += I2CDEV_WRITE_WORDS_CHUNK) {
+            uint8_t n = min(length - k, I2CDEV_WRITE_WORDS_CHUNK);
+            for (uint8_t i = 0; i < n; i++) {
+                bytes[2*i] = (uint8_t)(data[k + i] >> 8);
+                bytes[2*i + 1] = (uint8_t)data[k + i];
+            }
+            I2Ctransfer transfer;
+            transfer.setWrite(devAddr, regAddr + 2*k, n * 2, bytes);
+            done = I2Cqueue::run(&transfer, readTimeout) == I2CQUEUE_DONE;
+            #if I2CDEV_SHADOW_SIZE > 0
+                shadowStore(devAddr, regAddr + 2*k, n * 2, done ? bytes : 0, true);
+            #endif
+        }
+        #ifdef I2CDEV_SERIAL_DEBUG
+            Serial.println(". Done.");
+        #endif
+        return done;
+    #endif
     #if ((I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE && ARDUINO < 100) || I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_NBWIRE)
         Wire.beginTransmission(devAddr);
         Wire.send(regAddr); // send address
@@ -671,12 +853,100 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16
     #elif (I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE && ARDUINO >= 100)
         status = Wire.endTransmission();
     #endif
+    #if I2CDEV_SHADOW_SIZE > 0
+        // the bytes went out MSB first, but aren't kept; forget them
+        shadowStore(devAddr, regAddr, length * 2, 0, true);
+    #endif
     #ifdef I2CDEV_SERIAL_DEBUG
         Serial.println(". Done.");
     #endif
     return status == 0;
 }
 
+/** Shadow an 8-bit config register, one that only changes when it is written.
+ * Once its contents are known, from a read or a successful write, readByte()
+ * and friends return them without touching the bus, so writeBit() and
+ * writeBits() take a single write instead of a read and a write. Registers
+ * the device changes on its own (status, data, FIFO) must not be shadowed,
+ * nor ones that don't auto-increment. Call shadowInvalidate() whenever the
+ * device is reset.
+ * @param devAddr I2C slave device address
+ * @param regAddr Register address to shadow
+ * @param selfClearing Bits the device clears by itself once written (reset
+ *        triggers and the like), never kept as set
+ * @return False if the shadow is full (or left out), the register then goes
+ *         to the bus every time as before
+ */
+bool I2Cdev::shadowRegister(uint8_t devAddr, uint8_t regAddr, uint8_t selfClearing) {
+    #if I2CDEV_SHADOW_SIZE > 0
+        if (shadowFind(devAddr, regAddr) >= 0) return true;
+        if (shadowUsed == I2CDEV_SHADOW_SIZE) return false;
+        ShadowRegister &r = shadow[shadowUsed++];
+        r.devAddr = devAddr;
+        r.regAddr = regAddr;
+        r.selfClearing = selfClearing;
+        r.valid = false;
+        return true;
+    #else
+        return false;
+    #endif
+}
+
+/** Forget what is known about a device's shadowed registers, after a reset
+ * or anything else that changes them behind I2Cdev's back. They are read from
+ * the device again the next time they are needed.
+ * @param devAddr I2C slave device address
+ */
+void I2Cdev::shadowInvalidate(uint8_t devAddr) {
+    #if I2CDEV_SHADOW_SIZE > 0
+        for (uint8_t i = 0; i < shadowUsed; i++) {
+            if (shadow[i].devAddr == devAddr) shadow[i].valid = false;
+        }
+    #endif
+}
+
+#if I2CDEV_SHADOW_SIZE > 0
+    I2Cdev::ShadowRegister I2Cdev::shadow[I2CDEV_SHADOW_SIZE];
+    uint8_t I2Cdev::shadowUsed = 0;
+
+    int8_t I2Cdev::shadowFind(uint8_t devAddr, uint8_t regAddr) {
+        for (uint8_t i = 0; i < shadowUsed; i++) {
+            if (shadow[i].devAddr == devAddr && shadow[i].regAddr == regAddr) return i;
+        }
+        return -1;
+    }
+
+    // Fills data if every register in the run is shadowed and known
+    bool I2Cdev::shadowLoad(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data) {
+        if (shadowUsed == 0 || length == 0) return false;
+        for (uint8_t i = 0; i < length; i++) {
+            int8_t n = shadowFind(devAddr, regAddr + i);
+            if (n < 0 || !shadow[n].valid) return false;
+            data[i] = shadow[n].value;
+        }
+        return true;
+    }
+
+    // Keeps a run read from or written to the device (data 0 when a write
+    // failed). Only a run made up of shadowed registers is trusted to have
+    // auto-incremented through them; a write that strays outside one leaves
+    // the registers it may have touched unknown, a read like that is ignored.
+    void I2Cdev::shadowStore(uint8_t devAddr, uint8_t regAddr, uint8_t length, const uint8_t *data, bool write) {
+        if (shadowUsed == 0) return;
+        bool covered = true;
+        for (uint8_t i = 0; covered && i < length; i++) {
+            if (shadowFind(devAddr, regAddr + i) < 0) covered = false;
+        }
+        if (!covered && !write) return;
+        for (uint8_t i = 0; i < length; i++) {
+            int8_t n = shadowFind(devAddr, regAddr + i);
+            if (n < 0) continue;
+            shadow[n].valid = covered && data;
+            if (shadow[n].valid) shadow[n].value = data[i] & ~shadow[n].selfClearing;
+        }
+    }
+#endif
+
 /** Default timeout value for read operations.
  * Set this to 0 to disable timeout detection.
  */
@@ -47,7 +47,9 @@ THE SOFTWARE.
 // -----------------------------------------------------------------------------
 // I2C interface implementation setting
 // -----------------------------------------------------------------------------
-#define I2CDEV_IMPLEMENTATION       I2CDEV_ARDUINO_WIRE
+// The transfer queue, for LtuAeroTelemetry on its Teensy 3.0. Other boards need
+// I2CDEV_ARDUINO_WIRE here; the examples pick Wire up from this setting.
+#define I2CDEV_IMPLEMENTATION       I2CDEV_ASYNC_QUEUE
 
 // comment this out if you are using a non-optimal IDE/implementation setting
 // but want the compiler to shut up about it
@@ -61,6 +63,8 @@ THE SOFTWARE.
                                       // ^^^ NBWire implementation is still buggy w/some interrupts!
 #define I2CDEV_BUILTIN_FASTWIRE     3 // FastWire object from Francesco Ferrara's project
                                       // ^^^ FastWire implementation in I2Cdev is INCOMPLETE!
+#define I2CDEV_ASYNC_QUEUE          4 // Interrupt driven transfer queue, see I2Cqueue.h
+                                      // ^^^ Teensy 3.x only, and can't be linked with Wire
 
 // -----------------------------------------------------------------------------
 // Arduino-style "Serial.print" debug constant (uncomment to enable)
@@ -75,6 +79,8 @@ THE SOFTWARE.
     #endif
     #if I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE
         #include <Wire.h>
+    #elif I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE
+        #include "I2Cqueue.h"
     #endif
 #else
     #include "ArduinoWrapper.h"
@@ -83,6 +89,14 @@ THE SOFTWARE.
 // 1000ms default read timeout (modify with "I2Cdev::readTimeout = [ms];")
 #define I2CDEV_DEFAULT_READ_TIMEOUT     1000
 
+// Registers that can be shadowed with I2Cdev::shadowRegister(), across all
+// devices (set to 0 to leave the shadow out)
+#define I2CDEV_SHADOW_SIZE              32
+
+// Words per write in writeWords() with I2CDEV_ASYNC_QUEUE, buffered on the
+// stack MSB first; longer runs go out in several writes
+#define I2CDEV_WRITE_WORDS_CHUNK        16
+
 class I2Cdev {
     public:
         I2Cdev();
@@ -95,6 +109,7 @@ class I2Cdev {
         static int8_t readWord(uint8_t devAddr, uint8_t regAddr, uint16_t *data, uint16_t timeout=I2Cdev::readTimeout);
         static int8_t readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout=I2Cdev::readTimeout);
         static int8_t readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data, uint16_t timeout=I2Cdev::readTimeout);
+        static int16_t readStream(uint8_t devAddr, uint8_t regAddr, uint16_t length, uint8_t *data, uint16_t timeout=I2Cdev::readTimeout);
 
         static bool writeBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t data);
         static bool writeBitW(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint16_t data);
@@ -104,8 +119,30 @@ class I2Cdev {
         static bool writeWord(uint8_t devAddr, uint8_t regAddr, uint16_t data);
         static bool writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data);
         static bool writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data);
+        static bool writeStream(uint8_t devAddr, uint8_t regAddr, uint16_t length, uint8_t *data);
+
+        static bool shadowRegister(uint8_t devAddr, uint8_t regAddr, uint8_t selfClearing=0);
+        static void shadowInvalidate(uint8_t devAddr);
 
         static uint16_t readTimeout;
+
+    #if I2CDEV_SHADOW_SIZE > 0
+    private:
+        struct ShadowRegister {
+            uint8_t devAddr;
+            uint8_t regAddr;
+            uint8_t selfClearing; // bits that always read back as 0
+            uint8_t value;
+            bool valid;
+        };
+
+        static int8_t shadowFind(uint8_t devAddr, uint8_t regAddr);
+        static bool shadowLoad(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data);
+        static void shadowStore(uint8_t devAddr, uint8_t regAddr, uint8_t length, const uint8_t *data, bool write);
+
+        static ShadowRegister shadow[I2CDEV_SHADOW_SIZE];
+        static uint8_t shadowUsed;
+    #endif
 };
 
 #if I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_FASTWIRE
@@ -0,0 +1,337 @@
+// I2Cdev library collection - Interrupt driven I2C transfer queue
+// Runs register reads and writes on the bus in the background, one after the
+// other, and reports each one through a status flag and an optional callback
+// from the I2C interrupt. Behind I2Cdev when I2CDEV_IMPLEMENTATION is
+// I2CDEV_ASYNC_QUEUE, and usable directly to overlap bus traffic with work.
+
+/* ============================================
+I2Cdev device library code is placed under the MIT license
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+===============================================
+*/
+
+#include "I2Cdev.h"
+#include "I2Cqueue.h"
+
+#include "Arduino.h"
+
+// Built only behind I2Cdev, so a sketch left on Wire doesn't get a second
+// i2c0_isr, or calls into a port its board doesn't have
+#if I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE
+
+I2Ctransfer * volatile I2Cqueue::queue[I2CQUEUE_SIZE];
+volatile uint8_t I2Cqueue::head = 0;
+volatile uint8_t I2Cqueue::used = 0;
+I2Ctransfer * volatile I2Cqueue::active = 0;
+bool I2Cqueue::begun = false;
+
+/** Set up a register read: regAddr is written, then length bytes are read
+ * into data. Clears the callback.
+ * @param devAddr I2C slave device address
+ * @param regAddr First register to read from
+ * @param length Number of bytes to read
+ * @param data Buffer to store read data in
+ */
+void I2Ctransfer::setRead(uint8_t devAddr, uint8_t regAddr, uint16_t length, uint8_t *data) {
+    this->devAddr = devAddr;
+    this->regAddr = regAddr;
+    this->flags = I2CQUEUE_READ;
+    this->length = length;
+    this->data = data;
+    this->callback = 0;
+    this->context = 0;
+    this->status = I2CQUEUE_DONE;
+    this->count = 0;
+}
+
+/** Set up a register write: regAddr then length bytes from data. Clears the
+ * callback.
+ * @param devAddr I2C slave device address
+ * @param regAddr First register to write to
+ * @param length Number of bytes to write
+ * @param data Buffer to copy new data from, read as the bytes go out
+ */
+void I2Ctransfer::setWrite(uint8_t devAddr, uint8_t regAddr, uint16_t length, uint8_t *data) {
+    setRead(devAddr, regAddr, length, data);
+    this->flags = 0;
+}
+
+/** Queue a transfer behind the ones already waiting. Returns at once; the
+ * transfer's status says when it has finished, and its callback, if any, is
+ * called from the I2C interrupt.
+ * @param transfer Descriptor set up with setRead() or setWrite()
+ * @return False if the queue is full (the transfer is left alone)
+ */
+bool I2Cqueue::submit(I2Ctransfer *transfer) {
+    if (!begun) {
+        portBegin();
+        begun = true;
+    }
+
+    noInterrupts();
+    if (used == I2CQUEUE_SIZE) {
+        interrupts();
+        return false;
+    }
+    transfer->status = I2CQUEUE_QUEUED;
+    transfer->count = 0;
+    queue[(head + used) % I2CQUEUE_SIZE] = transfer;
+    used++;
+    if (!active) startNext();
+    interrupts();
+    return true;
+}
+
+/** Queue a transfer and wait for it, the blocking path behind I2Cdev. Waits
+ * for room in the queue as well. Not for use with interrupts disabled.
+ * @param transfer Descriptor set up with setRead() or setWrite()
+ * @param timeout Milliseconds to wait before giving up (0 to disable)
+ * @return Final status, I2CQUEUE_DONE on success
+ */
+int8_t I2Cqueue::run(I2Ctransfer *transfer, uint16_t timeout) {
+    uint32_t t1 = millis();
+    while (!submit(transfer)) {
+        if (timeout > 0 && millis() - t1 >= timeout) return I2CQUEUE_CANCELLED;
+        portWait();
+    }
+    return wait(transfer, timeout);
+}
+
+/** Wait for a queued transfer to finish, taking it back if it takes too
+ * long. Not for use with interrupts disabled.
+ * @param transfer Descriptor passed to submit()
+ * @param timeout Milliseconds to wait before cancelling it (0 to disable)
+ * @return Final status, I2CQUEUE_DONE on success
+ */
+int8_t I2Cqueue::wait(I2Ctransfer *transfer, uint16_t timeout) {
+    uint32_t t1 = millis();
+    while (transfer->pending()) {
+        if (timeout > 0 && millis() - t1 >= timeout) {
+            cancel(transfer);
+            break;
+        }
+        portWait();
+    }
+    return transfer->status;
+}
+
+/** Take a transfer back. One still waiting leaves the queue, the one on the
+ * bus is cut short with a STOP. Its status becomes I2CQUEUE_CANCELLED and its
+ * callback is not called.
+ * @param transfer Descriptor passed to submit()
+ */
+void I2Cqueue::cancel(I2Ctransfer *transfer) {
+    noInterrupts();
+    if (transfer == active) {
+        portAbort();
+        active = 0;
+        transfer->status = I2CQUEUE_CANCELLED;
+        startNext();
+    } else if (transfer->status == I2CQUEUE_QUEUED) {
+        // close the gap so the slot can't be started later
+        uint8_t i = 0;
+        while (i < used && queue[(head + i) % I2CQUEUE_SIZE] != transfer) i++;
+        for (; i + 1 < used; i++) {
+            queue[(head + i) % I2CQUEUE_SIZE] = queue[(head + i + 1) % I2CQUEUE_SIZE];
+        }
+        if (i < used) used--;
+        transfer->status = I2CQUEUE_CANCELLED;
+    }
+    interrupts();
+}
+
+/** True once every queued transfer has finished.
+ */
+bool I2Cqueue::idle() {
+    return !active && used == 0;
+}
+
+/** Called by the port, from the I2C interrupt, when the transfer on the bus
+ * has finished. The next one goes out before the callback runs, so the bus
+ * is kept busy.
+ * @param status Final status of the transfer
+ */
+void I2Cqueue::finished(int8_t status) {
+    I2Ctransfer *transfer = active;
+    if (!transfer) return;
+
+    active = 0;
+    transfer->status = status;
+    startNext();
+    if (transfer->callback) transfer->callback(transfer);
+}
+
+// With interrupts disabled or from the interrupt
+void I2Cqueue::startNext() {
+    if (active || used == 0) return;
+
+    I2Ctransfer *transfer = queue[head];
+    head = (head + 1) % I2CQUEUE_SIZE;
+    used--;
+    active = transfer;
+    transfer->status = I2CQUEUE_ACTIVE;
+    portStart(transfer);
+}
+
+#if defined(I2CQUEUE_EXTERNAL_PORT)
+    // The port is built elsewhere, as in the host build
+#elif defined(__MK20DX128__) || defined(__MK20DX256__)
+    // Teensy 3.x port on the I2C0 module (pins 18 and 19), one interrupt per
+    // byte. Wire sets the module up for polling and has its own i2c0_isr for
+    // slave mode, so the two can't be linked together.
+
+    #define I2CQUEUE_C1_IDLE    (I2C_C1_IICEN | I2C_C1_IICIE)
+    #define I2CQUEUE_C1_TX      (I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX)
+    #define I2CQUEUE_C1_RX      (I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST)
+
+    enum {
+        PORT_IDLE,
+        PORT_ADDRESS_WRITE,  // address sent for writing
+        PORT_REGISTER,       // regAddr sent
+        PORT_WRITE,          // data byte sent
+        PORT_ADDRESS_READ,   // address sent for reading
+        PORT_READ            // data byte being clocked in
+    };
+
+    static volatile uint8_t portState = PORT_IDLE;
+    static I2Ctransfer *portTransfer;
+
+    // A STOP takes a bit time to leave the bus, and a START can't go out
+    // before it has; bounded in case the bus is held low
+    static void portWaitForBus() {
+        for (uint16_t i = 0; (I2C0_S & I2C_S_BUSY) && i < 1000; i++);
+    }
+
+    static void portAddress(uint8_t devAddr, bool read) {
+        portWaitForBus();
+        I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
+        I2C0_C1 = I2CQUEUE_C1_TX;
+        portState = read ? PORT_ADDRESS_READ : PORT_ADDRESS_WRITE;
+        I2C0_D = (devAddr << 1) | (read ? 1 : 0);
+    }
+
+    static void portStop(int8_t status) {
+        I2C0_C1 = I2CQUEUE_C1_IDLE;
+        portState = PORT_IDLE;
+        portTransfer = 0;
+        I2Cqueue::finished(status);
+    }
+
+    void I2Cqueue::portBegin() {
+        SIM_SCGC4 |= SIM_SCGC4_I2C0;
+        I2C0_C1 = 0;
+        CORE_PIN18_CONFIG = PORT_PCR_MUX(2) | PORT_PCR_ODE | PORT_PCR_SRE | PORT_PCR_DSE;
+        CORE_PIN19_CONFIG = PORT_PCR_MUX(2) | PORT_PCR_ODE | PORT_PCR_SRE | PORT_PCR_DSE;
+        #if F_BUS == 48000000
+            I2C0_F = 0x27; // 100 kHz
+            I2C0_FLT = 4;
+        #elif F_BUS == 24000000
+            I2C0_F = 0x1F; // 100 kHz
+            I2C0_FLT = 2;
+        #else
+            #error "F_BUS must be 48 MHz or 24 MHz"
+        #endif
+        I2C0_C2 = I2C_C2_HDRS;
+        I2C0_C1 = I2CQUEUE_C1_IDLE;
+        NVIC_ENABLE_IRQ(IRQ_I2C0);
+    }
+
+    void I2Cqueue::portStart(I2Ctransfer *transfer) {
+        portTransfer = transfer;
+        portAddress(transfer->devAddr, (transfer->flags & I2CQUEUE_READ) && (transfer->flags & I2CQUEUE_NO_REGISTER));
+    }
+
+    void I2Cqueue::portAbort() {
+        I2C0_C1 = I2CQUEUE_C1_IDLE;
+        portState = PORT_IDLE;
+        portTransfer = 0;
+    }
+
+    void I2Cqueue::portWait() {
+    }
+
+    void i2c0_isr(void) {
+        uint8_t status = I2C0_S;
+        I2C0_S = I2C_S_IICIF;
+
+        I2Ctransfer *t = portTransfer;
+        if (!t || portState == PORT_IDLE) return;
+
+        if (status & I2C_S_ARBL) {
+            I2C0_S = I2C_S_ARBL;
+            portStop(I2CQUEUE_ARBITRATION);
+            return;
+        }
+
+        switch (portState) {
+            case PORT_ADDRESS_WRITE:
+            case PORT_REGISTER:
+            case PORT_WRITE:
+                if (status & I2C_S_RXAK) {
+                    portStop(I2CQUEUE_NACK);
+                } else if (portState == PORT_ADDRESS_WRITE && !(t->flags & I2CQUEUE_NO_REGISTER)) {
+                    portState = PORT_REGISTER;
+                    I2C0_D = t->regAddr;
+                } else if (t->flags & I2CQUEUE_READ) {
+                    // register pointer set; repeated START for reading,
+                    // the bus stays ours
+                    I2C0_C1 = I2CQUEUE_C1_TX | I2C_C1_RSTA;
+                    portState = PORT_ADDRESS_READ;
+                    I2C0_D = (t->devAddr << 1) | 1;
+                } else if (t->count < t->length) {
+                    portState = PORT_WRITE;
+                    I2C0_D = t->data[t->count++];
+                } else {
+                    portStop(I2CQUEUE_DONE);
+                }
+                break;
+
+            case PORT_ADDRESS_READ:
+                if (status & I2C_S_RXAK) {
+                    portStop(I2CQUEUE_NACK);
+                } else if (t->length == 0) {
+                    portStop(I2CQUEUE_DONE);
+                } else {
+                    // NACK the last byte; reading D clocks in the first
+                    I2C0_C1 = I2CQUEUE_C1_RX | (t->length == 1 ? I2C_C1_TXAK : 0);
+                    portState = PORT_READ;
+                    (void)I2C0_D;
+                }
+                break;
+
+            case PORT_READ:
+                if (t->length - t->count == 1) {
+                    // last byte in, STOP before reading it out of D
+                    I2C0_C1 = I2CQUEUE_C1_IDLE;
+                    t->data[t->count++] = I2C0_D;
+                    portStop(I2CQUEUE_DONE);
+                } else {
+                    if (t->length - t->count == 2) I2C0_C1 = I2CQUEUE_C1_RX | I2C_C1_TXAK;
+                    t->data[t->count++] = I2C0_D;
+                }
+                break;
+        }
+    }
+#else
+    #error "I2CDEV_ASYNC_QUEUE needs a Teensy 3.x"
+#endif
+
+#endif /* I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE */
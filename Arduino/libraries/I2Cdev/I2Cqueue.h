@@ -0,0 +1,111 @@
+// I2Cdev library collection - Interrupt driven I2C transfer queue header file
+// Runs register reads and writes on the bus in the background, one after the
+// other, and reports each one through a status flag and an optional callback
+// from the I2C interrupt. Behind I2Cdev when I2CDEV_IMPLEMENTATION is
+// I2CDEV_ASYNC_QUEUE, and usable directly to overlap bus traffic with work.
+
+/* ============================================
+I2Cdev device library code is placed under the MIT license
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+===============================================
+*/
+
+#ifndef _I2CQUEUE_H_
+#define _I2CQUEUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Transfers waiting behind the one on the bus
+#define I2CQUEUE_SIZE               8
+
+// I2Ctransfer::status
+#define I2CQUEUE_DONE               0  // finished, every byte acknowledged
+#define I2CQUEUE_QUEUED             1  // waiting for the bus
+#define I2CQUEUE_ACTIVE             2  // on the bus
+#define I2CQUEUE_NACK               -1 // address or data byte not acknowledged
+#define I2CQUEUE_ARBITRATION        -2 // lost the bus to another master
+#define I2CQUEUE_CANCELLED          -3 // taken back by cancel() (e.g. timed out)
+
+// I2Ctransfer::flags
+#define I2CQUEUE_READ               0x01 // read data after writing regAddr
+#define I2CQUEUE_NO_REGISTER        0x02 // no regAddr byte, data only
+
+struct I2Ctransfer;
+
+typedef void (*I2CtransferCallback)(I2Ctransfer *transfer);
+
+/** One addressed transfer: the register address is written and then data is
+ * either written after it or read back after a repeated START, length bytes
+ * in one go (not limited to the Wire buffer) and all in one bus transaction.
+ * The descriptor and its data buffer belong to the caller and must stay put
+ * until status is no longer queued or active.
+ */
+struct I2Ctransfer {
+    uint8_t devAddr;
+    uint8_t regAddr;
+    uint8_t flags;
+    uint16_t length;
+    uint8_t *data;
+
+    // Called from the I2C interrupt once the transfer has finished, whatever
+    // its status; may start further transfers
+    I2CtransferCallback callback;
+    void *context;
+
+    volatile int8_t status;
+    volatile uint16_t count; // bytes moved, read or written after regAddr
+
+    void setRead(uint8_t devAddr, uint8_t regAddr, uint16_t length, uint8_t *data);
+    void setWrite(uint8_t devAddr, uint8_t regAddr, uint16_t length, uint8_t *data);
+    bool pending() const { return status > 0; }
+};
+
+class I2Cqueue {
+    public:
+        static bool submit(I2Ctransfer *transfer);
+        static int8_t run(I2Ctransfer *transfer, uint16_t timeout);
+        static int8_t wait(I2Ctransfer *transfer, uint16_t timeout);
+        static void cancel(I2Ctransfer *transfer);
+        static bool idle();
+
+        // Called by the port from the I2C interrupt when the transfer on the
+        // bus has finished
+        static void finished(int8_t status);
+
+    private:
+        static void startNext();
+
+        // The bus side, one per platform: I2Cqueue.cpp has the Teensy 3.x
+        // one on the I2C0 interrupt, the host build brings a simulated one
+        static void portBegin();
+        static void portStart(I2Ctransfer *transfer);
+        static void portAbort();
+        static void portWait();
+
+        static I2Ctransfer * volatile queue[I2CQUEUE_SIZE];
+        static volatile uint8_t head;   // next to start
+        static volatile uint8_t used;
+        static I2Ctransfer * volatile active;
+        static bool begun;
+};
+
+#endif /* _I2CQUEUE_H_ */
@@ -0,0 +1,125 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include <string.h>
+
+#include "AltitudeFilter.h"
+
+// Starting uncertainty of the climb rate (m/s) and bias (m/s^2), RMS
+#define CLIMB_START 1.0f
+#define BIAS_START 0.5f
+
+AltitudeFilter::AltitudeFilter() {
+  setNoise(ALTITUDE_FILTER_ACCEL_NOISE, ALTITUDE_FILTER_BIAS_NOISE,
+           ALTITUDE_FILTER_ALTITUDE_NOISE);
+  reset();
+}
+
+void AltitudeFilter::setNoise(float accel, float bias, float altitude) {
+  accel_variance_ = accel * accel;
+  bias_variance_ = bias * bias;
+  altitude_variance_ = altitude * altitude;
+}
+
+void AltitudeFilter::reset() {
+  started_ = false;
+  time_ = 0;
+  accel_ = 0.0f;
+  memset(x_, 0, sizeof(x_));
+  memset(p_, 0, sizeof(p_));
+}
+
+void AltitudeFilter::addAccel(float accel, uint32_t time) {
+  if (started_) predict(time);
+  accel_ = accel;
+}
+
+void AltitudeFilter::addAltitude(float altitude, uint32_t time) {
+  if (!started_) {
+    started_ = true;
+    time_ = time;
+    x_[0] = altitude;
+    x_[1] = 0.0f;
+    x_[2] = 0.0f;
+    memset(p_, 0, sizeof(p_));
+    p_[0][0] = altitude_variance_;
+    p_[1][1] = CLIMB_START * CLIMB_START;
+    p_[2][2] = BIAS_START * BIAS_START;
+    return;
+  }
+  predict(time);
+
+  // Scalar measurement of the altitude alone, so the gain is the first
+  // column of the covariance over its first element
+  const float residual = altitude - x_[0];
+  const float s = p_[0][0] + altitude_variance_;
+  float k[3];
+  for (int i = 0; i < 3; i++) k[i] = p_[i][0] / s;
+  for (int i = 0; i < 3; i++) x_[i] += k[i] * residual;
+
+  float row[3];
+  for (int j = 0; j < 3; j++) row[j] = p_[0][j];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) p_[i][j] -= k[i] * row[j];
+  }
+}
+
+void AltitudeFilter::predict(uint32_t time) {
+  int32_t step = (int32_t)(time - time_);
+  if (step <= 0) return;
+  time_ = time;
+  if (step > ALTITUDE_FILTER_MAX_STEP) step = ALTITUDE_FILTER_MAX_STEP;
+
+  const float dt = step * 1e-6f;
+  const float half_dt2 = 0.5f * dt * dt;
+  const float a = accel_ - x_[2];
+  x_[0] += x_[1] * dt + a * half_dt2;
+  x_[1] += a * dt;
+
+  // P = F P F' + Q, with F = [1 dt -dt^2/2; 0 1 -dt; 0 0 1]
+  const float f[3][3] = {
+    { 1.0f, dt, -half_dt2 },
+    { 0.0f, 1.0f, -dt },
+    { 0.0f, 0.0f, 1.0f }
+  };
+  float fp[3][3];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      fp[i][j] = f[i][0] * p_[0][j] + f[i][1] * p_[1][j] + f[i][2] * p_[2][j];
+    }
+  }
+  for (int i = 0; i < 3; i++) {
+    for (int j = i; j < 3; j++) {
+      p_[i][j] = fp[i][0] * f[j][0] + fp[i][1] * f[j][1] + fp[i][2] * f[j][2];
+      p_[j][i] = p_[i][j];
+    }
+  }
+
+  // Acceleration noise enters altitude and climb rate together
+  const float g[2] = { half_dt2, dt };
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 2; j++) p_[i][j] += accel_variance_ * g[i] * g[j];
+  }
+  p_[2][2] += bias_variance_ * dt;
+}
@@ -0,0 +1,110 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*****************************************************************************
+
+Altitude and climb rate estimator
+
+A three state Kalman filter that fuses the barometric altitude with the
+vertical acceleration from the IMU. The state is altitude, climb rate and
+the accelerometer's vertical bias:
+
+  predict  every IMU sample: altitude and climb rate carried forward by
+           the acceleration since the last one, less the bias
+  correct  every pressure conversion: pulled towards the barometric
+           altitude, the bias learnt from what is left over
+
+The accelerometer follows changes in climb straight away; the barometer
+keeps altitude from drifting and calibrates the bias out. Compared with
+differencing barometric altitudes and low-pass filtering the result, the
+climb rate is both quieter and has no lag to speak of.
+
+Acceleration is the linear acceleration in the world frame, gravity
+removed, up positive (dmpGetLinearAccelInWorld() z, in m/s^2). Times are
+micros() at which the values were measured. A pressure sample is usually
+read half a conversion after the time it stands for, by which time newer
+IMU samples have moved the filter on; it is applied as it is, which is off
+by the climb over that time, a few cm.
+
+The noise figures are set for the BMP085 at ultra high resolution and a
+DMP on an airframe with some vibration. Without a barometer sample the
+filter does nothing, and the first one starts it level at that altitude.
+
+This file has no Arduino dependencies so that the host tools can use it.
+****************************************************************************/
+
+#ifndef ALTITUDE_FILTER_H
+#define ALTITUDE_FILTER_H
+
+#include <stdint.h>
+
+// Default noise: acceleration (m/s^2), bias random walk (m/s^2 per root
+// second) and barometric altitude (m), all RMS
+#define ALTITUDE_FILTER_ACCEL_NOISE 0.5f
+#define ALTITUDE_FILTER_BIAS_NOISE 0.02f
+#define ALTITUDE_FILTER_ALTITUDE_NOISE 0.3f
+
+// Longest prediction step, in microseconds. Gaps beyond it, such as a
+// stalled loop, are not integrated past it.
+#define ALTITUDE_FILTER_MAX_STEP 200000
+
+class AltitudeFilter {
+ public:
+  AltitudeFilter();
+
+  /** Set the noise figures, RMS, in the units above. */
+  void setNoise(float accel, float bias, float altitude);
+
+  /** Start over, waiting for the first barometer sample. */
+  void reset();
+
+  /** Vertical acceleration, m/s^2 up, measured at micros() time. */
+  void addAccel(float accel, uint32_t time);
+
+  /** Barometric altitude, m, measured at micros() time. */
+  void addAltitude(float altitude, uint32_t time);
+
+  /** True once the first barometer sample has started the filter. */
+  bool started() const { return started_; }
+
+  /** micros() the estimate holds for. */
+  uint32_t time() const { return time_; }
+
+  float altitude() const { return x_[0]; }
+  float climb() const { return x_[1]; }
+  float accelBias() const { return x_[2]; }
+
+ private:
+  void predict(uint32_t time);
+
+  bool started_;
+  uint32_t time_;
+  float accel_;     // latest acceleration, held until the next
+  float x_[3];      // altitude, climb rate, acceleration bias
+  float p_[3][3];   // covariance
+
+  float accel_variance_;
+  float bias_variance_;
+  float altitude_variance_;
+};
+
+#endif
@@ -0,0 +1,80 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include <Print.h>
+
+#include "DebugLog.h"
+#include "TelemetryFormat.h"
+
+struct DebugLogRecord {
+  const char *label;
+  const char *unit;
+  float value;
+  uint8_t digits;
+};
+
+static DebugLogRecord records[DEBUG_LOG_SIZE];
+static uint8_t head;  // Next record to fill
+static uint8_t tail;  // Next record to print
+static uint16_t dropped;
+
+void DebugLogQueue::add(const char *label, float value, uint8_t digits, const char *unit) {
+  if ((uint8_t)(head - tail) >= DEBUG_LOG_SIZE) {
+    dropped++;
+    return;
+  }
+
+  DebugLogRecord &r = records[head & (DEBUG_LOG_SIZE - 1)];
+  r.label = label;
+  r.unit = unit;
+  r.value = value;
+  r.digits = digits;
+  head++;
+}
+
+bool DebugLogQueue::drain(Print &out) {
+  if (dropped > 0) {
+    out.print(dropped);
+    out.println(" debug records dropped");
+    dropped = 0;
+    return true;
+  }
+  if (head == tail) return false;
+
+  const DebugLogRecord &r = records[tail & (DEBUG_LOG_SIZE - 1)];
+  out.print(r.label);
+  if (r.digits != NO_VALUE) {
+    char number[TELEMETRY_NUMBER_MAX];
+    TelemetryFormat::formatFloat(number, r.value, r.digits);
+    out.print(": ");
+    out.print(number);
+    if (r.unit) {
+      out.print(" ");
+      out.print(r.unit);
+    }
+  }
+  out.println();
+  tail++;
+  return true;
+}
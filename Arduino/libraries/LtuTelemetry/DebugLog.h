@@ -0,0 +1,113 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*****************************************************************************
+
+Debug log
+
+Messages for the USB debug port, filtered at compile time by level and by
+subsystem. The sketch picks the most verbose level and a subsystem mask
+once:
+
+  typedef DebugLog<DEBUG_LOG_INFO, LOG_ALTITUDE | LOG_SCHEDULER> Log;
+
+  Log::value<DEBUG_LOG_DEBUG, LOG_ALTITUDE>("Altitude", altitude, 2, "m");
+  Log::text<DEBUG_LOG_WARNING, LOG_MPU>("DMP FIFO overflow");
+
+A call that the level or the mask rules out dispatches to an empty inline
+function and compiles to nothing, buffer included. The others only queue
+the label, value and unit; nothing is formatted until drain() is called,
+which the sketch does when it has nothing else to do. Labels and units are
+not copied, so they must be string literals (or otherwise outlive the
+record). When the queue is full new records are dropped and counted.
+****************************************************************************/
+
+#ifndef DEBUG_LOG_H
+#define DEBUG_LOG_H
+
+#include <stdint.h>
+
+class Print;
+
+enum DebugLogLevel {
+  DEBUG_LOG_OFF,
+  DEBUG_LOG_ERROR,
+  DEBUG_LOG_WARNING,
+  DEBUG_LOG_INFO,
+  DEBUG_LOG_DEBUG
+};
+
+// Records waiting to be printed, a power of two
+#define DEBUG_LOG_SIZE 32
+
+// Record queue shared by every DebugLog configuration
+class DebugLogQueue {
+ public:
+  static void add(const char *label, float value, uint8_t digits, const char *unit);
+
+  /** Print the oldest record. @return false if there was none */
+  static bool drain(Print &out);
+
+  /** digits of a record without a value */
+  static const uint8_t NO_VALUE = 0xFF;
+};
+
+template <bool Enabled>
+struct DebugLogSink {
+  static void add(const char *, float, uint8_t, const char *) {}
+  static bool drain(Print &) { return false; }
+};
+
+template <>
+struct DebugLogSink<true> {
+  static void add(const char *label, float value, uint8_t digits, const char *unit) {
+    DebugLogQueue::add(label, value, digits, unit);
+  }
+  static bool drain(Print &out) { return DebugLogQueue::drain(out); }
+};
+
+template <uint8_t MaxLevel, uint16_t Mask>
+class DebugLog {
+ public:
+  static constexpr bool enabled(uint8_t level, uint16_t subsystem) {
+    return level != DEBUG_LOG_OFF && level <= MaxLevel && (subsystem & Mask) != 0;
+  }
+
+  /** Queue "label: value unit" */
+  template <uint8_t Level, uint16_t Subsystem>
+  static void value(const char *label, float value, uint8_t digits = 2, const char *unit = 0) {
+    DebugLogSink<enabled(Level, Subsystem)>::add(label, value, digits, unit);
+  }
+
+  /** Queue a line of text */
+  template <uint8_t Level, uint16_t Subsystem>
+  static void text(const char *text) {
+    DebugLogSink<enabled(Level, Subsystem)>::add(text, 0.0f, DebugLogQueue::NO_VALUE, 0);
+  }
+
+  /** Print the oldest queued record. @return false if there was none */
+  static bool drain(Print &out) {
+    return DebugLogSink<MaxLevel != DEBUG_LOG_OFF && Mask != 0>::drain(out);
+  }
+};
+
+#endif
@@ -0,0 +1,131 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include <Arduino.h>
+
+#include "GpsSetup.h"
+
+// Most likely first: factory default, then what this sketch sets
+static const uint32_t BAUDS[] = { 9600, 115200, 38400, 57600, 19200, 4800 };
+static const uint8_t BAUD_COUNT = sizeof(BAUDS) / sizeof(BAUDS[0]);
+
+GpsSetup::GpsSetup(HardwareSerial &port, UbxGps &ubx)
+  : port_(port)
+  , ubx_(ubx) {
+}
+
+uint32_t GpsSetup::probe() {
+  for (uint8_t i = 0; i < BAUD_COUNT; i++) {
+    port_.begin(BAUDS[i]);
+    if (poll()) return BAUDS[i];
+  }
+  return 0;
+}
+
+bool GpsSetup::resume(uint32_t baud) {
+  port_.begin(baud);
+  return poll(GPS_POLL_INTERVAL);
+}
+
+UbxAck GpsSetup::send(const uint8_t *message, size_t length) {
+  ubx_.expectAck(message[2], message[3]);
+  port_.write(message, length);
+  return wait(GPS_SETUP_TIMEOUT);
+}
+
+GpsSetup::Result GpsSetup::begin(uint32_t baud, const uint16_t *periods, uint8_t periodCount,
+                                 uint16_t outProtocols, const uint8_t *messages,
+                                 uint8_t messageCount) {
+  const uint16_t inProtocols = UBX_PROTOCOL_UBX | UBX_PROTOCOL_NMEA;
+  uint8_t message[UBX_CONFIG_MAX];
+  Result result = { 0, 0, 0, 0 };
+
+  result.foundBaud = probe();
+  if (!result.foundBaud) return result;
+  result.baud = result.foundBaud;
+
+  if (send(message, UbxGps::configurePort(message, result.baud, inProtocols, outProtocols)) !=
+      UBX_ACK_ACKED) {
+    result.rejected++;
+  }
+
+  for (uint8_t i = 0; i < messageCount; i++) {
+    const uint8_t *m = messages + 3 * i;
+    if (send(message, UbxGps::configureMessage(message, m[0], m[1], m[2])) != UBX_ACK_ACKED) {
+      result.rejected++;
+    }
+  }
+
+  for (uint8_t i = 0; i < periodCount && !result.period; i++) {
+    if (send(message, UbxGps::configureRate(message, periods[i])) == UBX_ACK_ACKED) {
+      result.period = periods[i];
+    } else {
+      result.rejected++;
+    }
+  }
+
+  if (baud != result.baud) {
+    // Answered, if at all, at the new rate mid-switch
+    port_.write(message, UbxGps::configurePort(message, baud, inProtocols, outProtocols));
+    port_.flush();
+    port_.begin(baud);
+    if (poll()) {
+      result.baud = baud;
+    } else {
+      result.rejected++;
+      result.baud = probe();
+    }
+  }
+  return result;
+}
+
+// Poll the port settings, answered by CFG-PRT and ACK-ACK. Repeated until
+// timeout, in case the receiver was still switching baud rate when the
+// first went out.
+bool GpsSetup::poll(uint16_t timeout) {
+  const uint8_t port = 1;
+  uint8_t message[UBX_OVERHEAD + 1];
+  const size_t length = UbxGps::frame(message, UBX_CFG, UBX_CFG_PRT, &port, 1);
+
+  for (uint16_t waited = 0; waited < timeout; waited += GPS_POLL_INTERVAL) {
+    ubx_.expectAck(UBX_CFG, UBX_CFG_PRT);
+    port_.write(message, length);
+    if (wait(GPS_POLL_INTERVAL) == UBX_ACK_ACKED) return true;
+  }
+  return false;
+}
+
+UbxAck GpsSetup::wait(uint16_t timeout) {
+  const unsigned long start = millis();
+  uint8_t buffer[64];
+
+  while (ubx_.ack() == UBX_ACK_PENDING && millis() - start < timeout) {
+    size_t n = 0;
+    while (n < sizeof(buffer) && port_.available()) {
+      buffer[n++] = port_.read();
+    }
+    ubx_.encode(buffer, n);
+  }
+  return ubx_.ack();
+}
@@ -0,0 +1,117 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*****************************************************************************
+
+GPS startup
+
+Brings a NEO-6M from whatever state it is in to the baud rate, measurement
+rate and message set the sketch wants, over UBX configuration messages:
+
+  1. Probe. At each of the baud rates a u-blox 6 supports, poll the port
+     settings (CFG-PRT) until acknowledged or GPS_SETUP_TIMEOUT passes.
+     The first rate that answers is the one the receiver is at, whether
+     that is the factory 9600 or what an earlier run left it at.
+  2. Set the output protocols at that baud rate, so nothing unwanted is
+     queued behind the answers that follow.
+  3. Set each message's rate, enabling the ones consumed and turning the
+     rest (GSV and GSA above all) off.
+  4. Set the measurement period, trying each of the periods given in
+     turn until one is accepted; the NEO-6M refuses anything faster than
+     5 Hz, other u-blox 6 receivers go to 10 Hz.
+  5. Move the port to the final baud rate. The acknowledgement is sent
+     while the receiver switches and is lost, so the new rate is checked
+     with a poll, and the receiver probed again if it does not answer.
+
+Each other step waits for ACK-ACK or ACK-NAK, and gives up after
+GPS_SETUP_TIMEOUT ms. Bytes that arrive meanwhile go through the UbxGps
+parser, so the caller's statistics include them.
+
+After a reset of the MCU alone the receiver still runs as set up, and
+resume() checks that with a single poll at the final baud rate instead.
+****************************************************************************/
+
+#ifndef GPS_SETUP_H
+#define GPS_SETUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "UbxGps.h"
+
+class HardwareSerial;
+
+// Longest wait for an answer, in ms. At 9600 baud the receiver may have up
+// to a second of NMEA queued ahead of it.
+#define GPS_SETUP_TIMEOUT 1200
+
+// Probe polls go out this often, in ms, until one is answered
+#define GPS_POLL_INTERVAL 200
+
+class GpsSetup {
+ public:
+  struct Result {
+    uint32_t foundBaud;  // what the receiver was at, 0 if it never answered
+    uint32_t baud;       // what it is at now
+    uint16_t period;     // ms between measurements, 0 if none was accepted
+    uint8_t rejected;    // configuration messages refused or unanswered
+  };
+
+  GpsSetup(HardwareSerial &port, UbxGps &ubx);
+
+  /**
+   * Find the receiver's baud rate and leave the port at it.
+   * @return the baud rate, or 0 if nothing answered
+   */
+  uint32_t probe();
+
+  /**
+   * Pick up a receiver that begin() has already set up, as after a reset of
+   * the MCU alone. It keeps its configuration for as long as it has power,
+   * and only answers at a baud rate other than the factory 9600 while it
+   * does, so one poll at that rate tells. Leaves the port at baud.
+   * @return true if it answered within GPS_POLL_INTERVAL ms
+   */
+  bool resume(uint32_t baud);
+
+  /** Send a configuration message and wait for its answer. */
+  UbxAck send(const uint8_t *message, size_t length);
+
+  /**
+   * Configure the receiver.
+   * @param baud Final baud rate
+   * @param periods Measurement periods in ms, preferred first
+   * @param outProtocols UBX_PROTOCOL_* to send on the port
+   * @param messages Class, id and rate of each message to set, as triples
+   */
+  Result begin(uint32_t baud, const uint16_t *periods, uint8_t periodCount,
+               uint16_t outProtocols, const uint8_t *messages, uint8_t messageCount);
+
+ private:
+  bool poll(uint16_t timeout = GPS_SETUP_TIMEOUT);
+  UbxAck wait(uint16_t timeout);
+
+  HardwareSerial &port_;
+  UbxGps &ubx_;
+};
+
+#endif
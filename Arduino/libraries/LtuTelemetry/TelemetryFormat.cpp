@@ -0,0 +1,119 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include <string.h>
+
+#include "TelemetryFormat.h"
+
+static const uint32_t powers_of_ten[TELEMETRY_DECIMALS_MAX + 1] = {
+  1ul, 10ul, 100ul, 1000ul, 10000ul, 100000ul, 1000000ul, 10000000ul,
+  100000000ul, 1000000000ul
+};
+
+/**
+ * Digits of value, zero padded to at least width. Division by the constant
+ * 10 compiles to a multiply and shift.
+ */
+static uint8_t digits(char *out, uint32_t value, uint8_t width) {
+  char reversed[10];
+  uint8_t n = 0;
+
+  do {
+    const uint32_t quotient = value / 10;
+    reversed[n++] = '0' + (char)(value - quotient * 10);
+    value = quotient;
+  } while (value || n < width);
+
+  for (uint8_t i = 0; i < n; i++) {
+    out[i] = reversed[n - 1 - i];
+  }
+  return n;
+}
+
+/**
+ * whole.fraction with the fraction zero padded to decimals digits
+ */
+static uint8_t decimal(char *out, uint32_t whole, uint32_t fraction, uint8_t decimals) {
+  char *p = out;
+
+  p += digits(p, whole, 1);
+  if (decimals > 0) {
+    *p++ = '.';
+    p += digits(p, fraction, decimals);
+  }
+  *p = '\0';
+  return p - out;
+}
+
+uint8_t TelemetryFormat::formatUnsigned(char *out, uint32_t value) {
+  const uint8_t n = digits(out, value, 1);
+  out[n] = '\0';
+  return n;
+}
+
+uint8_t TelemetryFormat::formatFixed(char *out, int32_t value, uint8_t decimals) {
+  const uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+  uint8_t n = 0;
+
+  if (decimals > TELEMETRY_DECIMALS_MAX) decimals = TELEMETRY_DECIMALS_MAX;
+  if (value < 0) out[n++] = '-';
+
+  const uint32_t unit = powers_of_ten[decimals];
+  return n + decimal(out + n, magnitude / unit, magnitude % unit, decimals);
+}
+
+uint8_t TelemetryFormat::formatFloat(char *out, float value, uint8_t digits) {
+  uint8_t n = 0;
+
+  // Same special cases as Print::printFloat()
+  if (value != value) {
+    strcpy(out, "nan");
+    return 3;
+  }
+  if (value > 4294967040.0f || value < -4294967040.0f) {
+    // Infinity compares larger than anything too
+    strcpy(out, value - value != value - value ? "inf" : "ovf");
+    return 3;
+  }
+
+  if (digits > TELEMETRY_DECIMALS_MAX) digits = TELEMETRY_DECIMALS_MAX;
+  if (value < 0.0f) {
+    out[n++] = '-';
+    value = -value;
+  }
+
+  // Subtracting the whole part of a float and scaling by 2^32 are both
+  // exact, which leaves the fraction as a 32 bit binary fixed point number.
+  // One 32 x 32 bit multiply turns that into decimals, rounded to nearest.
+  const uint32_t unit = powers_of_ten[digits];
+  uint32_t whole = (uint32_t)value;
+  const uint32_t binary = (uint32_t)((value - (float)whole) * 4294967296.0f);
+  uint32_t fraction = (uint32_t)(((uint64_t)binary * unit + 0x80000000ul) >> 32);
+  if (fraction >= unit) {
+    fraction -= unit;
+    whole++;
+  }
+
+  return n + decimal(out + n, whole, fraction, digits);
+}
@@ -0,0 +1,65 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*****************************************************************************
+
+Number formatting for the text telemetry format
+
+Writes numbers as decimal text into a caller supplied buffer, for the
+message fields that used to go through Print::print(float, digits). The
+core's float printing builds each digit with a double multiply and
+subtract, which the Teensy 3.0 (no FPU) runs in software; here the digits
+come from integer arithmetic only:
+
+  formatUnsigned(out, 5861)             "5861"
+  formatFixed(out, -83249560, 6)        "-83.249560"  (microdegrees)
+  formatFloat(out, -0.70721f, 4)        "-0.7072"
+
+formatFixed() takes a value already scaled by a power of ten and is exact.
+formatFloat() rounds to nearest and otherwise prints what
+Print::print(float, digits) does, including "nan", "inf", "ovf" and a
+minus sign on values that round to zero. Only exact ties can come out
+differently: they round away from zero here, while printFloat()'s inexact
+rounding constant sends some of them the other way. Every function writes
+a terminating NUL, never more than TELEMETRY_NUMBER_MAX bytes in all, and
+returns the length without it.
+****************************************************************************/
+
+#ifndef TELEMETRY_FORMAT_H
+#define TELEMETRY_FORMAT_H
+
+#include <stdint.h>
+
+// Longest number written, NUL included: sign, 10 digits, point, 9 decimals
+#define TELEMETRY_NUMBER_MAX 22
+
+// Most decimals formatFixed() and formatFloat() write
+#define TELEMETRY_DECIMALS_MAX 9
+
+class TelemetryFormat {
+ public:
+  static uint8_t formatUnsigned(char *out, uint32_t value);
+  static uint8_t formatFixed(char *out, int32_t value, uint8_t decimals);
+  static uint8_t formatFloat(char *out, float value, uint8_t digits);
+};
+
+#endif
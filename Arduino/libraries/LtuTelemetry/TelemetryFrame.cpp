@@ -0,0 +1,248 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include "TelemetryFrame.h"
+
+// Frame without the values
+#define HEADER_SIZE 8
+#define CRC_SIZE 2
+
+struct ChannelFormat {
+  char code[4];
+  uint8_t size;
+  uint8_t digits;
+  float scale;
+};
+
+static const ChannelFormat formats[TELEMETRY_CHANNELS] = {
+  { "AQW", 2, 4, 16384.0f },
+  { "AQX", 2, 4, 16384.0f },
+  { "AQY", 2, 4, 16384.0f },
+  { "AQZ", 2, 4, 16384.0f },
+  { "SPD", 2, 2, 100.0f },
+  { "AIN", 2, 2, 100.0f },
+  { "ALT", 4, 2, 100.0f },
+  { "CLB", 2, 2, 100.0f },
+  { "HDG", 2, 1, 10.0f },
+  { "VIN", 2, 2, 100.0f },
+  { "LAT", 4, 7, 1e7f },
+  { "LON", 4, 7, 1e7f },
+  { "TMP", 2, 2, 100.0f },
+  { "UTC", 4, 4, 1e4f },
+  { "DRF", 2, 2, 100.0f }
+};
+
+static void store(uint8_t *p, int32_t value, uint8_t size) {
+  for (uint8_t i = 0; i < size; i++) {
+    p[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static int32_t load(const uint8_t *p, uint8_t size) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < size; i++) {
+    value |= (uint32_t)p[i] << (8 * i);
+  }
+  // Sign extend the 2 byte fields
+  if (size == 2) return (int16_t)value;
+  return (int32_t)value;
+}
+
+TelemetryFrame::TelemetryFrame()
+  : timestamp_(0)
+  , sequence_(0)
+  , channels_(0) {
+}
+
+void TelemetryFrame::begin(uint32_t timestamp) {
+  timestamp_ = timestamp;
+  channels_ = 0;
+}
+
+void TelemetryFrame::set(uint8_t channel, float value) {
+  if (channel >= TELEMETRY_CHANNELS) return;
+
+  const ChannelFormat &f = formats[channel];
+  const float limit = f.size == 2 ? 32767.0f : 2147483520.0f;
+  float scaled = value * f.scale;
+
+  // NaN fails both tests and goes out as 0
+  if (scaled > limit) scaled = limit;
+  else if (scaled < -limit) scaled = -limit;
+  else if (!(scaled == scaled)) scaled = 0.0f;
+
+  values_[channel] = (int32_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+  channels_ |= 1 << channel;
+}
+
+void TelemetryFrame::setFixed(uint8_t channel, int32_t value, uint8_t decimals) {
+  if (channel >= TELEMETRY_CHANNELS) return;
+
+  const ChannelFormat &f = formats[channel];
+  const int64_t limit = f.size == 2 ? 32767 : 2147483647;
+  int64_t unit = 1;
+  for (uint8_t i = 0; i < decimals; i++) unit *= 10;
+
+  // Every scale is a whole number; round half away from zero
+  int64_t scaled = (int64_t)value * (int32_t)f.scale;
+  scaled = (scaled + (scaled < 0 ? -unit / 2 : unit / 2)) / unit;
+  if (scaled > limit) scaled = limit;
+  else if (scaled < -limit) scaled = -limit;
+
+  values_[channel] = (int32_t)scaled;
+  channels_ |= 1 << channel;
+}
+
+void TelemetryFrame::remove(uint8_t channel) {
+  if (channel < TELEMETRY_CHANNELS) channels_ &= ~(1 << channel);
+}
+
+size_t TelemetryFrame::maxEncodedLength() const {
+  size_t length = HEADER_SIZE + CRC_SIZE;
+  for (uint8_t channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+    if (has(channel)) length += formats[channel].size;
+  }
+  // One COBS code byte per started 254 byte run, and the delimiter
+  return length + length / 254 + 2;
+}
+
+bool TelemetryFrame::has(uint8_t channel) const {
+  return channel < TELEMETRY_CHANNELS && (channels_ & (1 << channel));
+}
+
+float TelemetryFrame::get(uint8_t channel) const {
+  if (!has(channel)) return 0.0f;
+  return values_[channel] / formats[channel].scale;
+}
+
+int32_t TelemetryFrame::raw(uint8_t channel) const {
+  return has(channel) ? values_[channel] : 0;
+}
+
+float TelemetryFrame::scale(uint8_t channel) {
+  return channel < TELEMETRY_CHANNELS ? formats[channel].scale : 1.0f;
+}
+
+const char *TelemetryFrame::code(uint8_t channel) {
+  return channel < TELEMETRY_CHANNELS ? formats[channel].code : "???";
+}
+
+uint8_t TelemetryFrame::digits(uint8_t channel) {
+  return channel < TELEMETRY_CHANNELS ? formats[channel].digits : 0;
+}
+
+size_t TelemetryFrame::encode(uint8_t *out) {
+  uint8_t raw[TELEMETRY_FRAME_MAX];
+  size_t length = 0;
+
+  raw[length++] = TELEMETRY_FRAME_VERSION;
+  raw[length++] = sequence_++;
+  store(raw + length, timestamp_, 4);
+  length += 4;
+  store(raw + length, channels_, 2);
+  length += 2;
+
+  for (uint8_t channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+    if (!has(channel)) continue;
+    store(raw + length, values_[channel], formats[channel].size);
+    length += formats[channel].size;
+  }
+
+  store(raw + length, crc16(raw, length), CRC_SIZE);
+  length += CRC_SIZE;
+
+  // COBS: each run of non-zero bytes is prefixed with its length + 1, the
+  // zero that ends it is dropped. Runs stop at 254 bytes without a zero.
+  size_t n = 0;
+  size_t code_at = n++;
+  uint8_t code = 1;
+  for (size_t i = 0; i < length; i++) {
+    if (raw[i] != 0) {
+      out[n++] = raw[i];
+      code++;
+    }
+    if (raw[i] == 0 || code == 0xFF) {
+      out[code_at] = code;
+      code_at = n++;
+      code = 1;
+    }
+  }
+  out[code_at] = code;
+  out[n++] = 0;
+
+  return n;
+}
+
+bool TelemetryFrame::decode(const uint8_t *in, size_t length) {
+  uint8_t raw[TELEMETRY_FRAME_MAX];
+  size_t n = 0;
+
+  // Undo the COBS runs
+  for (size_t i = 0; i < length; ) {
+    const uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > length) return false;
+    for (uint8_t k = 1; k < code; k++) {
+      if (n >= sizeof(raw) || in[i] == 0) return false;
+      raw[n++] = in[i++];
+    }
+    if (code != 0xFF && i < length) {
+      if (n >= sizeof(raw)) return false;
+      raw[n++] = 0;
+    }
+  }
+
+  if (n < HEADER_SIZE + CRC_SIZE) return false;
+  if ((uint16_t)load(raw + n - CRC_SIZE, CRC_SIZE) != crc16(raw, n - CRC_SIZE)) return false;
+  if (raw[0] != TELEMETRY_FRAME_VERSION) return false;
+
+  const uint16_t channels = (uint16_t)load(raw + 6, 2);
+  size_t at = HEADER_SIZE;
+  for (uint8_t channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+    if (!(channels & (1 << channel))) continue;
+    if (at + formats[channel].size > n - CRC_SIZE) return false;
+    values_[channel] = load(raw + at, formats[channel].size);
+    at += formats[channel].size;
+  }
+  if (at != n - CRC_SIZE || (channels >> TELEMETRY_CHANNELS)) return false;
+
+  sequence_ = raw[1];
+  timestamp_ = (uint32_t)load(raw + 2, 4);
+  channels_ = channels;
+  return true;
+}
+
+/**
+ * CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF
+ */
+uint16_t TelemetryFrame::crc16(const uint8_t *data, size_t length) {
+  uint16_t crc = 0xFFFF;
+
+  while (length--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
@@ -0,0 +1,164 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*****************************************************************************
+
+Binary telemetry frame
+
+One frame carries everything measured in one telemetry period under a
+single timestamp. Before framing it is laid out as follows, multi-byte
+values little endian:
+
+  version    1 byte   TELEMETRY_FRAME_VERSION
+  sequence   1 byte   counts frames, wraps at 255
+  timestamp  4 bytes  milliseconds (millis())
+  channels   2 bytes  bitmap, bit n set when channel n is present
+  values     present channels in channel order, 2 or 4 bytes each, as
+             signed fixed point (see the table below)
+  crc        2 bytes  CRC-16/CCITT-FALSE of everything above
+
+The block is then COBS encoded, so it contains no zero bytes, and followed
+by a single zero byte. A receiver that joins mid-stream or sees a corrupt
+frame resynchronizes at the next zero.
+
+  bit code  size  unit
+    0 AQW   2     quaternion w / 16384
+    1 AQX   2     quaternion x / 16384
+    2 AQY   2     quaternion y / 16384
+    3 AQZ   2     quaternion z / 16384
+    4 SPD   2     airspeed, cm/s
+    5 AIN   2     current, 10 mA
+    6 ALT   4     altitude, cm
+    7 CLB   2     climb rate, cm/s
+    8 HDG   2     heading, 0.1 degrees
+    9 VIN   2     voltage, 10 mV
+   10 LAT   4     latitude, 1e-7 degrees
+   11 LON   4     longitude, 1e-7 degrees
+   12 TMP   2     temperature, 0.01 degrees C
+   13 UTC   4     UTC at the timestamp, 0.1 ms into the day
+   14 DRF   2     clock drift against UTC, 0.01 ppm
+
+UTC and DRF make up the time sync record: the aircraft's clock read as
+UTC, and how fast it runs against UTC, for mapping the other frames'
+timestamps until the next record.
+
+A full frame is 50 bytes on the wire, against roughly 340 for the same
+values as text messages.
+
+This file has no Arduino dependencies so that the ground station can
+decode with the same code.
+****************************************************************************/
+
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_FRAME_VERSION 1
+
+// Largest frame on the wire, COBS overhead and delimiter included
+#define TELEMETRY_FRAME_MAX 64
+
+enum TelemetryChannel {
+  TELEMETRY_AQW,
+  TELEMETRY_AQX,
+  TELEMETRY_AQY,
+  TELEMETRY_AQZ,
+  TELEMETRY_SPD,
+  TELEMETRY_AIN,
+  TELEMETRY_ALT,
+  TELEMETRY_CLB,
+  TELEMETRY_HDG,
+  TELEMETRY_VIN,
+  TELEMETRY_LAT,
+  TELEMETRY_LON,
+  TELEMETRY_TMP,
+  TELEMETRY_UTC,
+  TELEMETRY_DRF,
+  TELEMETRY_CHANNELS
+};
+
+class TelemetryFrame {
+ public:
+  TelemetryFrame();
+
+  /** Start a new frame. Clears all channels. */
+  void begin(uint32_t timestamp);
+
+  /** Set a channel from its value in SI units. Out of range values clamp. */
+  void set(uint8_t channel, float value);
+
+  /**
+   * Set a channel from an integer value in units of 10^-decimals of the SI
+   * unit, e.g. microdegrees with decimals = 6. Exact, unlike a detour
+   * through float, where the channel resolves that many decimals.
+   */
+  void setFixed(uint8_t channel, int32_t value, uint8_t decimals);
+
+  /** Leave a channel out of the frame. */
+  void remove(uint8_t channel);
+
+  /** Most bytes encode() can write for the frame as it stands. */
+  size_t maxEncodedLength() const;
+
+  /**
+   * COBS encode the frame and its delimiter into out, which must hold
+   * TELEMETRY_FRAME_MAX bytes. Advances the sequence number.
+   * @return bytes written
+   */
+  size_t encode(uint8_t *out);
+
+  /**
+   * Decode one frame as received, COBS encoded, without its delimiter.
+   * @return false if it is malformed, fails the CRC or is another version
+   */
+  bool decode(const uint8_t *in, size_t length);
+
+  uint32_t timestamp() const { return timestamp_; }
+  uint8_t sequence() const { return sequence_; }
+  uint16_t channels() const { return channels_; }
+  bool has(uint8_t channel) const;
+
+  /** Channel value in SI units, 0 if absent. */
+  float get(uint8_t channel) const;
+
+  /** Channel value as sent, in units of 1 / scale(channel). */
+  int32_t raw(uint8_t channel) const;
+  static float scale(uint8_t channel);
+
+  /** Three letter code of a channel, as used by the text format. */
+  static const char *code(uint8_t channel);
+
+  /** Digits after the decimal point that the channel resolves. */
+  static uint8_t digits(uint8_t channel);
+
+  static uint16_t crc16(const uint8_t *data, size_t length);
+
+ private:
+  uint32_t timestamp_;
+  uint8_t sequence_;
+  uint16_t channels_;
+  int32_t values_[TELEMETRY_CHANNELS];
+};
+
+#endif
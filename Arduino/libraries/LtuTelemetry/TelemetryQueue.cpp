@@ -0,0 +1,68 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include <string.h>
+
+#include "TelemetryQueue.h"
+
+#define INDEX_MASK (TELEMETRY_QUEUE_SIZE - 1)
+
+TelemetryQueue::TelemetryQueue()
+  : head_(0)
+  , tail_(0)
+  , peak_(0)
+  , dropped_(0)
+  , dropped_bytes_(0) {
+}
+
+bool TelemetryQueue::push(const uint8_t *data, size_t length) {
+  if (length > free()) {
+    dropped_++;
+    dropped_bytes_ += length;
+    return false;
+  }
+
+  // At most two copies, either side of the wrap
+  const size_t at = head_ & INDEX_MASK;
+  const size_t first = length < TELEMETRY_QUEUE_SIZE - at ? length : TELEMETRY_QUEUE_SIZE - at;
+  memcpy(buffer_ + at, data, first);
+  memcpy(buffer_, data + first, length - first);
+  head_ += length;
+
+  if (used() > peak_) peak_ = used();
+  return true;
+}
+
+size_t TelemetryQueue::peek(const uint8_t **data) const {
+  const size_t at = tail_ & INDEX_MASK;
+  const size_t contiguous = TELEMETRY_QUEUE_SIZE - at;
+
+  *data = buffer_ + at;
+  return used() < contiguous ? used() : contiguous;
+}
+
+void TelemetryQueue::consume(size_t length) {
+  if (length > used()) length = used();
+  tail_ += length;
+}
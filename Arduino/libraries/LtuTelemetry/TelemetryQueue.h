@@ -0,0 +1,87 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*****************************************************************************
+
+Radio transmit queue
+
+A byte ring buffer between the telemetry encoder and the radio UART. The
+core's UART buffer only holds 64 bytes, so writing a burst of messages
+straight to Serial1 blocks the loop until the UART has shifted most of it
+out. Instead, frames and messages are pushed here whole, which never
+blocks, and the loop moves bytes on to the UART only as fast as it has
+room for them:
+
+  const uint8_t *data;
+  size_t n = queue.peek(&data);
+  n = min(n, Serial1.availableForWrite());
+  Serial1.write(data, n);
+  queue.consume(n);
+
+A push that does not fit is refused whole and counted, so the receiver
+never sees half a message; free() lets the encoder make the message
+smaller first.
+****************************************************************************/
+
+#ifndef TELEMETRY_QUEUE_H
+#define TELEMETRY_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Queue size in bytes, a power of two
+#define TELEMETRY_QUEUE_SIZE 1024
+
+class TelemetryQueue {
+ public:
+  TelemetryQueue();
+
+  /** Queue all of data, or nothing if it does not fit. */
+  bool push(const uint8_t *data, size_t length);
+
+  /**
+   * The oldest queued bytes that are contiguous in memory.
+   * @return how many there are
+   */
+  size_t peek(const uint8_t **data) const;
+
+  /** Remove bytes returned by peek() once they are sent. */
+  void consume(size_t length);
+
+  size_t used() const { return (uint16_t)(head_ - tail_); }
+  size_t free() const { return TELEMETRY_QUEUE_SIZE - used(); }
+
+  // Statistics
+  size_t peak() const { return peak_; }
+  uint32_t dropped() const { return dropped_; }
+  uint32_t droppedBytes() const { return dropped_bytes_; }
+
+ private:
+  uint8_t buffer_[TELEMETRY_QUEUE_SIZE];
+  uint16_t head_;  // Next byte to fill
+  uint16_t tail_;  // Next byte to send
+  uint16_t peak_;
+  uint32_t dropped_;
+  uint32_t dropped_bytes_;
+};
+
+#endif
@@ -0,0 +1,55 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include "TelemetrySample.h"
+
+#define INDEX_MASK (TELEMETRY_SAMPLE_QUEUE_SIZE - 1)
+
+TelemetrySampleQueue::TelemetrySampleQueue()
+  : head_(0)
+  , tail_(0)
+  , peak_(0)
+  , dropped_(0) {
+}
+
+bool TelemetrySampleQueue::push(const TelemetrySample &sample) {
+  if (used() == TELEMETRY_SAMPLE_QUEUE_SIZE) {
+    dropped_++;
+    return false;
+  }
+
+  samples_[head_ & INDEX_MASK] = sample;
+  head_++;
+
+  if (used() > peak_) peak_ = used();
+  return true;
+}
+
+bool TelemetrySampleQueue::pop(TelemetrySample *sample) {
+  if (empty()) return false;
+
+  *sample = samples_[tail_ & INDEX_MASK];
+  tail_++;
+  return true;
+}
@@ -0,0 +1,105 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*****************************************************************************
+
+Sample records
+
+What a sensor task hands on: one value of one channel, and the micros()
+at which it was measured, taken by the driver when the measurement was
+made (a DMP packet's interrupt, the middle of a BMP085 conversion, the
+epoch of a GPS fix) rather than when the value is formatted or sent.
+Tasks push samples here and return; the transmit path pops them later,
+in whatever batches suit the radio, and turns the time into the frame or
+message timestamp.
+
+  TelemetrySample s;
+  s.channel = TELEMETRY_ALT;
+  s.timestamp = bmp->getSampleTime();
+  s.setValue(altitude, 6);
+  samples.push(s);
+
+A value is either a float sent with a number of decimals, or fixed point
+in units of 10^-decimals (microdegrees, say), which is carried to the
+radio without rounding it through a float.
+
+A push to a full queue is refused and counted. The queue is sized so that
+this only happens when the transmit path is not being run at all.
+****************************************************************************/
+
+#ifndef TELEMETRY_SAMPLE_H
+#define TELEMETRY_SAMPLE_H
+
+#include <stdint.h>
+
+// Samples queued, a power of two
+#define TELEMETRY_SAMPLE_QUEUE_SIZE 32
+
+struct TelemetrySample {
+  uint32_t timestamp;  // micros() when measured
+  union {
+    float value;
+    int32_t fixedValue;
+  };
+  uint8_t channel;     // TelemetryChannel
+  uint8_t decimals;
+  bool fixed;
+
+  void setValue(float v, uint8_t d) {
+    value = v;
+    decimals = d;
+    fixed = false;
+  }
+
+  void setFixed(int32_t v, uint8_t d) {
+    fixedValue = v;
+    decimals = d;
+    fixed = true;
+  }
+};
+
+class TelemetrySampleQueue {
+ public:
+  TelemetrySampleQueue();
+
+  /** Queue a sample, or count it as dropped if the queue is full. */
+  bool push(const TelemetrySample &sample);
+
+  /** Take the oldest sample, if there is one. */
+  bool pop(TelemetrySample *sample);
+
+  bool empty() const { return head_ == tail_; }
+  uint8_t used() const { return (uint8_t)(head_ - tail_); }
+
+  // Statistics
+  uint8_t peak() const { return peak_; }
+  uint32_t dropped() const { return dropped_; }
+
+ private:
+  TelemetrySample samples_[TELEMETRY_SAMPLE_QUEUE_SIZE];
+  uint8_t head_;  // Next slot to fill
+  uint8_t tail_;  // Next sample to take
+  uint8_t peak_;
+  uint32_t dropped_;
+};
+
+#endif
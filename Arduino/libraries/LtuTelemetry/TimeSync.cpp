@@ -0,0 +1,220 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include <math.h>
+
+#include "TimeSync.h"
+
+// Three pairs in a row off the line means the line is wrong
+#define REJECTED_RUN_MAX 3
+
+// A pulse a second after the last one, give or take 1000 ppm
+#define PULSE_MIN 999000ul
+#define PULSE_MAX 1001000ul
+
+// a - b in ms, the short way round the day
+static int32_t dayDifference(uint32_t a, uint32_t b) {
+  int32_t d = (int32_t)(a - b);
+  if (d > (int32_t)(TIME_SYNC_DAY_MILLIS / 2)) d -= TIME_SYNC_DAY_MILLIS;
+  else if (d < -(int32_t)(TIME_SYNC_DAY_MILLIS / 2)) d += TIME_SYNC_DAY_MILLIS;
+  return d;
+}
+
+static int32_t roundToInt(float x) {
+  return (int32_t)(x < 0 ? x - 0.5f : x + 0.5f);
+}
+
+TimeSync::TimeSync() {
+  reset();
+  stats_.pulses = 0;
+  stats_.points = 0;
+  stats_.rejected = 0;
+  stats_.restarts = 0;
+}
+
+void TimeSync::reset() {
+  head_ = 0;
+  count_ = 0;
+  rejected_run_ = 0;
+  anchor_local_ = 0;
+  anchor_utc_ = 0;
+  anchor_micros_ = 0;
+  rate_ = 0.0f;
+  residual_ = 0;
+  pps_ = false;
+  pulse_ = 0;
+  used_pulse_ = 0;
+  pulse_regular_ = false;
+  have_pulse_ = false;
+  have_candidate_ = false;
+  candidate_local_ = 0;
+  candidate_utc_ = 0;
+}
+
+void TimeSync::pulse(uint32_t local) {
+  const uint32_t interval = local - pulse_;
+
+  pulse_regular_ = have_pulse_ && interval >= PULSE_MIN && interval <= PULSE_MAX;
+  pulse_ = local;
+  have_pulse_ = true;
+  stats_.pulses++;
+}
+
+void TimeSync::solution(uint32_t utc, uint32_t received) {
+  const uint32_t into = utc % 1000;
+
+  // The pulse at the top of this second has come and not been used yet
+  if (into == 0 && pulse_regular_ && pulse_ != used_pulse_ && received - pulse_ < 1000000ul) {
+    if (!pps_) {
+      pps_ = true;
+      restart();
+    }
+    used_pulse_ = pulse_;
+    add(pulse_, utc);
+    return;
+  }
+  // Solutions lost on the way do not matter as long as the pulses keep
+  // coming
+  if (pps_) {
+    if (pulse_regular_ && received - pulse_ < TIME_SYNC_PPS_TIMEOUT) return;
+    pps_ = false;
+    restart();
+  }
+
+  // Top of the second as this solution places it. The earliest of the
+  // second's solutions goes into the fit once the next second starts.
+  const uint32_t second = utc - into;
+  const uint32_t start = received - into * 1000;
+  if (have_candidate_ && second == candidate_utc_) {
+    if ((int32_t)(start - candidate_local_) < 0) candidate_local_ = start;
+    return;
+  }
+  if (have_candidate_) add(candidate_local_, candidate_utc_);
+  have_candidate_ = true;
+  candidate_local_ = start;
+  candidate_utc_ = second;
+}
+
+uint32_t TimeSync::utc(uint32_t local, uint16_t *micros) const {
+  const int32_t x = (int32_t)(local - anchor_local_);
+  const int64_t at = (int64_t)anchor_micros_ + x + roundToInt(x * rate_);
+
+  // Floor division, so that the microseconds are never negative
+  int64_t ms = at / 1000;
+  int32_t rest = (int32_t)(at - ms * 1000);
+  if (rest < 0) {
+    ms--;
+    rest += 1000;
+  }
+  if (micros) *micros = (uint16_t)rest;
+
+  int64_t day = ((int64_t)anchor_utc_ + ms) % (int64_t)TIME_SYNC_DAY_MILLIS;
+  if (day < 0) day += TIME_SYNC_DAY_MILLIS;
+  return (uint32_t)day;
+}
+
+uint32_t TimeSync::local(uint32_t utc) const {
+  const int64_t at = (int64_t)dayDifference(utc, anchor_utc_) * 1000 - anchor_micros_;
+  return anchor_local_ + (uint32_t)(at - roundToInt(at * rate_));
+}
+
+void TimeSync::restart() {
+  head_ = 0;
+  count_ = 0;
+  rejected_run_ = 0;
+  have_candidate_ = false;
+  stats_.restarts++;
+}
+
+void TimeSync::add(uint32_t local, uint32_t utc) {
+  if (count_ > 0) {
+    const int64_t error = offset(local, utc);
+    if (error > TIME_SYNC_TOLERANCE || error < -TIME_SYNC_TOLERANCE) {
+      stats_.rejected++;
+      if (++rejected_run_ < REJECTED_RUN_MAX) return;
+      restart();
+    }
+  }
+  rejected_run_ = 0;
+
+  points_[head_].local = local;
+  points_[head_].utc = utc;
+  head_ = (head_ + 1) % TIME_SYNC_POINTS;
+  if (count_ < TIME_SYNC_POINTS) count_++;
+  stats_.points++;
+  fit();
+}
+
+/**
+ * https://en.wikipedia.org/wiki/Simple_linear_regression
+ *
+ * In microseconds from the newest pair, so that the sums keep their
+ * precision. Runs once a second, double is affordable.
+ */
+void TimeSync::fit() {
+  const Point &newest = points_[(head_ + TIME_SYNC_POINTS - 1) % TIME_SYNC_POINTS];
+  double x[TIME_SYNC_POINTS];
+  double y[TIME_SYNC_POINTS];
+  double mean_x = 0.0, mean_y = 0.0;
+
+  for (uint8_t i = 0; i < count_; i++) {
+    const Point &p = points_[i];
+    x[i] = (int32_t)(p.local - newest.local);
+    y[i] = dayDifference(p.utc, newest.utc) * 1000.0;
+    mean_x += x[i];
+    mean_y += y[i];
+  }
+  mean_x /= count_;
+  mean_y /= count_;
+
+  double slope = 1.0 + rate_;
+  if (count_ >= TIME_SYNC_SLOPE_POINTS) {
+    double sxx = 0.0, sxy = 0.0;
+    for (uint8_t i = 0; i < count_; i++) {
+      sxx += (x[i] - mean_x) * (x[i] - mean_x);
+      sxy += (x[i] - mean_x) * (y[i] - mean_y);
+    }
+    if (sxx > 0.0) slope = sxy / sxx;
+  }
+  const double intercept = mean_y - slope * mean_x;
+
+  double squares = 0.0;
+  for (uint8_t i = 0; i < count_; i++) {
+    const double r = y[i] - (intercept + slope * x[i]);
+    squares += r * r;
+  }
+
+  anchor_local_ = newest.local;
+  anchor_utc_ = newest.utc;
+  anchor_micros_ = (int32_t)floor(intercept + 0.5);
+  rate_ = (float)(slope - 1.0);
+  residual_ = (uint32_t)(sqrt(squares / count_) + 0.5);
+}
+
+// Distance of a pair from the line, in microseconds
+int64_t TimeSync::offset(uint32_t local, uint32_t utc) const {
+  const int32_t x = (int32_t)(local - anchor_local_);
+  const int64_t predicted = (int64_t)anchor_micros_ + x + roundToInt(x * rate_);
+  return (int64_t)dayDifference(utc, anchor_utc_) * 1000 - predicted;
+}
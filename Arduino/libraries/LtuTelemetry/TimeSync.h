@@ -0,0 +1,157 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*****************************************************************************
+
+Clock synchronization with GPS time
+
+Relates the Teensy's micros() to UTC, as milliseconds into the UTC day, so
+that samples stamped with the local clock can be placed in GPS time. The
+local crystal is off by some tens of ppm and wanders with temperature, so
+both the offset and the drift between the two clocks are estimated: a
+least squares line through the last TIME_SYNC_POINTS pairs of local time
+and UTC second, one pair per second.
+
+Where the pairs come from, best first:
+
+  PPS     The receiver's timepulse, a rising edge at the top of every UTC
+          second once it has a fix. The ISR takes micros(); the next
+          solution for a whole second names the second. A pulse only counts
+          when it comes a second after the last one, so a floating pin
+          stays out of it.
+  arrival Without pulses, the time each solution is parsed, less its
+          offset into the second. The earliest of the second's solutions
+          is the least delayed by the main loop; what remains is the
+          receiver's own output latency, tens of ms, which ends up in the
+          offset. Drift is unaffected.
+
+Switching between the two starts the fit afresh. A pair more than
+TIME_SYNC_TOLERANCE away from the current line is dropped, unless three in
+a row are, which means the line was wrong and the fit restarts.
+
+This file has no Arduino dependencies so that the host tools can use it.
+****************************************************************************/
+
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pairs in the fit, one per second. With fewer than TIME_SYNC_SLOPE_POINTS
+// only the offset is fitted and the drift kept from before.
+#define TIME_SYNC_POINTS 32
+#define TIME_SYNC_SLOPE_POINTS 8
+
+// Largest distance from the line for a pair to be used, in microseconds
+#define TIME_SYNC_TOLERANCE 50000
+
+// PPS given up after this long without a regular pulse, in microseconds
+#define TIME_SYNC_PPS_TIMEOUT 3000000
+
+#define TIME_SYNC_DAY_MILLIS 86400000ul
+
+class TimeSync {
+ public:
+  struct Stats {
+    uint32_t pulses;
+    uint32_t points;      // pairs used
+    uint32_t rejected;    // pairs too far from the line
+    uint32_t restarts;
+  };
+
+  TimeSync();
+
+  /** Forget every pair, e.g. when the receiver is reset. */
+  void reset();
+
+  /** A rising edge on the PPS pin, local micros() taken in the ISR. */
+  void pulse(uint32_t local);
+
+  /**
+   * A navigation solution for the epoch at utc, in ms into the UTC day,
+   * received and parsed at local micros().
+   */
+  void solution(uint32_t utc, uint32_t received);
+
+  /** True once there is a pair to go by. */
+  bool synced() const { return count_ > 0; }
+
+  /** True while the pairs come from PPS. */
+  bool pps() const { return pps_; }
+
+  /**
+   * UTC at a local micros(), in ms into the day, and optionally the
+   * microseconds past that ms.
+   */
+  uint32_t utc(uint32_t local, uint16_t *micros = 0) const;
+
+  /** Local micros() at a UTC time, in ms into the day. */
+  uint32_t local(uint32_t utc) const;
+
+  /** How fast the local clock runs against UTC, in ppm. */
+  float drift() const { return -rate_ * 1e6f; }
+
+  /** RMS distance of the pairs from the line, in microseconds. */
+  uint32_t residual() const { return residual_; }
+
+  const Stats &stats() const { return stats_; }
+
+ private:
+  struct Point {
+    uint32_t local;       // micros()
+    uint32_t utc;         // ms into the day
+  };
+
+  void restart();
+  void add(uint32_t local, uint32_t utc);
+  void fit();
+  int64_t offset(uint32_t local, uint32_t utc) const;
+
+  Point points_[TIME_SYNC_POINTS];
+  uint8_t head_;
+  uint8_t count_;
+  uint8_t rejected_run_;
+
+  // The line: UTC at anchor_local_ is anchor_utc_ ms plus anchor_micros_,
+  // and moves on by 1 + rate_ us per local us
+  uint32_t anchor_local_;
+  uint32_t anchor_utc_;
+  int32_t anchor_micros_;
+  float rate_;            // UTC over local time, less one
+  uint32_t residual_;
+
+  bool pps_;
+  uint32_t pulse_;        // last pulse
+  uint32_t used_pulse_;   // last pulse paired with a second
+  bool pulse_regular_;    // a second after the one before
+  bool have_pulse_;
+
+  // Earliest arrival seen for the current second, without PPS
+  bool have_candidate_;
+  uint32_t candidate_local_;
+  uint32_t candidate_utc_;
+
+  Stats stats_;
+};
+
+#endif
@@ -0,0 +1,311 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include <string.h>
+
+#include "UbxGps.h"
+
+#define SYNC_1 0xB5
+#define SYNC_2 0x62
+
+#define DAY_MILLIS 86400000ul
+#define WEEK_MILLIS (7 * DAY_MILLIS)
+
+enum {
+  STATE_SYNC_1,
+  STATE_SYNC_2,
+  STATE_CLASS,
+  STATE_ID,
+  STATE_LENGTH_1,
+  STATE_LENGTH_2,
+  STATE_PAYLOAD,
+  STATE_CK_A,
+  STATE_CK_B
+};
+
+static uint16_t u2(const uint8_t *p) {
+  return p[0] | (uint16_t)p[1] << 8;
+}
+
+static uint32_t u4(const uint8_t *p) {
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static int32_t i4(const uint8_t *p) {
+  return (int32_t)u4(p);
+}
+
+static void putU2(uint8_t *p, uint16_t value) {
+  p[0] = value;
+  p[1] = value >> 8;
+}
+
+static void putU4(uint8_t *p, uint32_t value) {
+  putU2(p, value);
+  putU2(p + 2, value >> 16);
+}
+
+UbxGps::UbxGps()
+  : state_(STATE_SYNC_1)
+  , class_(0)
+  , id_(0)
+  , length_(0)
+  , offset_(0)
+  , ck_a_(0)
+  , ck_b_(0)
+  , updated_(0)
+  , ack_class_(0)
+  , ack_id_(0)
+  , ack_(UBX_ACK_PENDING) {
+  memset(&position_, 0, sizeof(position_));
+  memset(&velocity_, 0, sizeof(velocity_));
+  memset(&solution_, 0, sizeof(solution_));
+  memset(&time_, 0, sizeof(time_));
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+int UbxGps::encode(const uint8_t *data, size_t length) {
+  const uint8_t *p = data;
+  const uint8_t *end = data + length;
+  int messages = 0;
+
+  while (p < end) {
+    if (state_ == STATE_PAYLOAD) {
+      // Run through the payload without going back through the switch,
+      // keeping what fits
+      size_t n = length_ - offset_;
+      if (n > (size_t)(end - p)) n = end - p;
+      uint8_t a = ck_a_;
+      uint8_t b = ck_b_;
+      for (size_t i = 0; i < n; i++) {
+        if (offset_ < UBX_PAYLOAD_MAX) payload_[offset_] = p[i];
+        offset_++;
+        a += p[i];
+        b += a;
+      }
+      ck_a_ = a;
+      ck_b_ = b;
+      p += n;
+      if (offset_ == length_) state_ = STATE_CK_A;
+      continue;
+    }
+
+    const uint8_t c = *p++;
+    switch (state_) {
+      case STATE_SYNC_1:
+        if (c == SYNC_1) state_ = STATE_SYNC_2;
+        break;
+      case STATE_SYNC_2:
+        state_ = c == SYNC_2 ? STATE_CLASS : c == SYNC_1 ? STATE_SYNC_2 : STATE_SYNC_1;
+        break;
+      case STATE_CLASS:
+        class_ = c;
+        ck_a_ = ck_b_ = c;
+        state_ = STATE_ID;
+        break;
+      case STATE_ID:
+        id_ = c;
+        ck_a_ += c;
+        ck_b_ += ck_a_;
+        state_ = STATE_LENGTH_1;
+        break;
+      case STATE_LENGTH_1:
+        length_ = c;
+        ck_a_ += c;
+        ck_b_ += ck_a_;
+        state_ = STATE_LENGTH_2;
+        break;
+      case STATE_LENGTH_2:
+        length_ |= (uint16_t)c << 8;
+        ck_a_ += c;
+        ck_b_ += ck_a_;
+        offset_ = 0;
+        state_ = length_ ? STATE_PAYLOAD : STATE_CK_A;
+        if (length_ > UBX_LENGTH_MAX) {
+          stats_.badLength++;
+          state_ = c == SYNC_1 ? STATE_SYNC_2 : STATE_SYNC_1;
+        }
+        break;
+      case STATE_CK_A:
+        state_ = STATE_CK_B;
+        if (c != ck_a_) {
+          stats_.failedChecksum++;
+          state_ = c == SYNC_1 ? STATE_SYNC_2 : STATE_SYNC_1;
+        }
+        break;
+      case STATE_CK_B:
+        state_ = STATE_SYNC_1;
+        if (c != ck_b_) {
+          stats_.failedChecksum++;
+          if (c == SYNC_1) state_ = STATE_SYNC_2;
+          break;
+        }
+        stats_.messages++;
+        messages++;
+        complete();
+        break;
+    }
+  }
+  return messages;
+}
+
+uint8_t UbxGps::updated() {
+  const uint8_t updated = updated_;
+  updated_ = 0;
+  return updated;
+}
+
+bool UbxGps::hasFix() const {
+  return (solution_.flags & 0x01) &&
+         (solution_.fix == UBX_FIX_2D || solution_.fix == UBX_FIX_3D ||
+          solution_.fix == UBX_FIX_GPS_DEAD_RECKONING);
+}
+
+bool UbxGps::utc(uint32_t tow, uint32_t *millis) const {
+  if (!(time_.valid & UBX_TIME_VALID_UTC)) return false;
+
+  // Nanoseconds rounded to the ms, then moved to the time of week asked
+  // for, the short way round the week
+  int32_t nano_millis = time_.nano / 1000000;
+  const int32_t nano_rest = time_.nano % 1000000;
+  if (nano_rest >= 500000) nano_millis++;
+  else if (nano_rest <= -500000) nano_millis--;
+  int32_t since = (int32_t)(tow - time_.tow);
+  if (since > (int32_t)(WEEK_MILLIS / 2)) since -= WEEK_MILLIS;
+  else if (since < -(int32_t)(WEEK_MILLIS / 2)) since += WEEK_MILLIS;
+
+  int32_t ms = (int32_t)(time_.hour * 3600000ul + time_.minute * 60000ul +
+                         time_.second * 1000ul) + nano_millis + since;
+  ms %= (int32_t)DAY_MILLIS;
+  if (ms < 0) ms += DAY_MILLIS;
+  *millis = (uint32_t)ms;
+  return true;
+}
+
+void UbxGps::expectAck(uint8_t cls, uint8_t id) {
+  ack_class_ = cls;
+  ack_id_ = id;
+  ack_ = UBX_ACK_PENDING;
+}
+
+// A message has passed its checksum
+void UbxGps::complete() {
+  const uint8_t *p = payload_;
+
+  if (class_ == UBX_NAV && id_ == UBX_NAV_POSLLH && length_ == 28) {
+    position_.tow = u4(p);
+    position_.longitude = i4(p + 4);
+    position_.latitude = i4(p + 8);
+    position_.height = i4(p + 12);
+    position_.heightMsl = i4(p + 16);
+    position_.horizontalAccuracy = u4(p + 20);
+    position_.verticalAccuracy = u4(p + 24);
+    updated_ |= UBX_UPDATED_POSITION;
+  } else if (class_ == UBX_NAV && id_ == UBX_NAV_VELNED && length_ == 36) {
+    velocity_.tow = u4(p);
+    velocity_.north = i4(p + 4);
+    velocity_.east = i4(p + 8);
+    velocity_.down = i4(p + 12);
+    velocity_.speed = u4(p + 16);
+    velocity_.groundSpeed = u4(p + 20);
+    velocity_.course = i4(p + 24);
+    velocity_.speedAccuracy = u4(p + 28);
+    velocity_.courseAccuracy = u4(p + 32);
+    updated_ |= UBX_UPDATED_VELOCITY;
+  } else if (class_ == UBX_NAV && id_ == UBX_NAV_SOL && length_ == 52) {
+    solution_.tow = u4(p);
+    solution_.week = (int16_t)u2(p + 8);
+    solution_.fix = p[10];
+    solution_.flags = p[11];
+    solution_.positionAccuracy = u4(p + 24);
+    solution_.pdop = u2(p + 44);
+    solution_.satellites = p[47];
+    updated_ |= UBX_UPDATED_SOLUTION;
+  } else if (class_ == UBX_NAV && id_ == UBX_NAV_TIMEUTC && length_ == 20) {
+    time_.tow = u4(p);
+    time_.accuracy = u4(p + 4);
+    time_.nano = i4(p + 8);
+    time_.year = u2(p + 12);
+    time_.month = p[14];
+    time_.day = p[15];
+    time_.hour = p[16];
+    time_.minute = p[17];
+    time_.second = p[18];
+    time_.valid = p[19];
+    updated_ |= UBX_UPDATED_TIME;
+  } else if (class_ == UBX_ACK && length_ == 2) {
+    if (id_ == UBX_ACK_ACK) stats_.acks++;
+    if (id_ == UBX_ACK_NAK) stats_.naks++;
+    if (p[0] == ack_class_ && p[1] == ack_id_) {
+      ack_ = id_ == UBX_ACK_ACK ? UBX_ACK_ACKED : UBX_ACK_NAKED;
+    }
+  }
+}
+
+size_t UbxGps::frame(uint8_t *out, uint8_t cls, uint8_t id,
+                     const uint8_t *payload, uint16_t length) {
+  uint8_t a = 0;
+  uint8_t b = 0;
+
+  out[0] = SYNC_1;
+  out[1] = SYNC_2;
+  out[2] = cls;
+  out[3] = id;
+  putU2(out + 4, length);
+  memcpy(out + 6, payload, length);
+  for (size_t i = 2; i < 6u + length; i++) {
+    a += out[i];
+    b += a;
+  }
+  out[6 + length] = a;
+  out[7 + length] = b;
+  return length + UBX_OVERHEAD;
+}
+
+size_t UbxGps::configurePort(uint8_t *out, uint32_t baud,
+                             uint16_t inProtocols, uint16_t outProtocols) {
+  uint8_t payload[20];
+
+  memset(payload, 0, sizeof(payload));
+  payload[0] = 1;                     // UART 1
+  putU4(payload + 4, 0x000008D0);     // 8 data bits, no parity, 1 stop bit
+  putU4(payload + 8, baud);
+  putU2(payload + 12, inProtocols);
+  putU2(payload + 14, outProtocols);
+  return frame(out, UBX_CFG, UBX_CFG_PRT, payload, sizeof(payload));
+}
+
+size_t UbxGps::configureMessage(uint8_t *out, uint8_t cls, uint8_t id, uint8_t rate) {
+  const uint8_t payload[3] = { cls, id, rate };
+  return frame(out, UBX_CFG, UBX_CFG_MSG, payload, sizeof(payload));
+}
+
+size_t UbxGps::configureRate(uint8_t *out, uint16_t period) {
+  uint8_t payload[6];
+
+  putU2(payload, period);
+  putU2(payload + 2, 1);              // every measurement is a solution
+  putU2(payload + 4, 1);              // aligned to GPS time
+  return frame(out, UBX_CFG, UBX_CFG_RATE, payload, sizeof(payload));
+}
@@ -0,0 +1,266 @@
+/****************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 LTU Aero Design
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*****************************************************************************
+
+u-blox UBX protocol
+
+Binary messages from the NEO-6M, as described in the u-blox 6 Receiver
+Description (Datasheets/u-blox6_ReceiverDescriptionProtocolSpec.pdf). Each
+message is framed as
+
+  0xB5 0x62  class  id  length (2 bytes)  payload  CK_A CK_B
+
+with multi-byte values little endian and an 8-bit Fletcher checksum over
+class, id, length and payload. The parser hunts for the sync bytes, so it
+can share the port with NMEA while the receiver is being switched over.
+
+Of the navigation messages it decodes the four the aircraft needs, all
+already integers in the units below, nothing to convert from ASCII:
+
+  NAV-POSLLH   28 bytes  position, 1e-7 degrees; height and accuracy, mm
+  NAV-VELNED   36 bytes  NED velocity and ground speed, cm/s; course, 1e-5 degrees
+  NAV-SOL      52 bytes  fix type and flags, position DOP, satellites
+  NAV-TIMEUTC  20 bytes  UTC date and time at a time of week
+
+u-blox 6 firmware has no NAV-PVT; the four together carry the same data.
+The others are stamped with GPS time of week, which runs ahead of UTC by
+the leap seconds; NAV-TIMEUTC relates the two, so it need only come now
+and then.
+ACK-ACK and ACK-NAK answer configuration messages. Anything else is
+checksummed and skipped.
+
+The static functions build the configuration messages that switch the
+receiver over: CFG-PRT for the port's baud rate and protocols, CFG-MSG for
+which messages go out every how many solutions and CFG-RATE for the
+measurement period.
+
+This file has no Arduino dependencies so that the host tools can use it.
+****************************************************************************/
+
+#ifndef UBX_GPS_H
+#define UBX_GPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest payload decoded, NAV-SOL
+#define UBX_PAYLOAD_MAX 52
+
+// Longest payload taken as genuine. NAV-SVINFO, the longest message the
+// NEO-6M sends, is 200 bytes for 16 channels; a longer length comes from a
+// false sync or a corrupted byte, and the parser goes back to hunting for
+// sync rather than swallow up to 64 KB as payload
+#define UBX_LENGTH_MAX 512
+
+// Sync, header and checksum around the payload
+#define UBX_OVERHEAD 8
+
+// Largest configuration message the builders write
+#define UBX_CONFIG_MAX (20 + UBX_OVERHEAD)
+
+enum UbxClass {
+  UBX_NAV = 0x01,
+  UBX_ACK = 0x05,
+  UBX_CFG = 0x06,
+  UBX_NMEA = 0xF0
+};
+
+enum UbxId {
+  UBX_NAV_POSLLH = 0x02,
+  UBX_NAV_SOL = 0x06,
+  UBX_NAV_VELNED = 0x12,
+  UBX_NAV_TIMEUTC = 0x21,
+  UBX_ACK_NAK = 0x00,
+  UBX_ACK_ACK = 0x01,
+  UBX_CFG_PRT = 0x00,
+  UBX_CFG_MSG = 0x01,
+  UBX_CFG_RATE = 0x08,
+  UBX_NMEA_GGA = 0x00,
+  UBX_NMEA_GLL = 0x01,
+  UBX_NMEA_GSA = 0x02,
+  UBX_NMEA_GSV = 0x03,
+  UBX_NMEA_RMC = 0x04,
+  UBX_NMEA_VTG = 0x05
+};
+
+// Protocol masks for CFG-PRT
+#define UBX_PROTOCOL_UBX 0x0001
+#define UBX_PROTOCOL_NMEA 0x0002
+
+// NAV-SOL fix types
+enum UbxFix {
+  UBX_FIX_NONE = 0,
+  UBX_FIX_DEAD_RECKONING = 1,
+  UBX_FIX_2D = 2,
+  UBX_FIX_3D = 3,
+  UBX_FIX_GPS_DEAD_RECKONING = 4,
+  UBX_FIX_TIME = 5
+};
+
+// Bits of updated()
+#define UBX_UPDATED_POSITION 0x01
+#define UBX_UPDATED_VELOCITY 0x02
+#define UBX_UPDATED_SOLUTION 0x04
+#define UBX_UPDATED_TIME 0x08
+
+// NAV-TIMEUTC validity bits
+#define UBX_TIME_VALID_TOW 0x01
+#define UBX_TIME_VALID_WEEK 0x02
+#define UBX_TIME_VALID_UTC 0x04
+
+// Answer to the configuration message last expected
+enum UbxAck {
+  UBX_ACK_PENDING,
+  UBX_ACK_ACKED,
+  UBX_ACK_NAKED
+};
+
+class UbxGps {
+ public:
+  struct Position {
+    uint32_t tow;                 // ms into the GPS week
+    int32_t longitude;            // 1e-7 degrees
+    int32_t latitude;             // 1e-7 degrees
+    int32_t height;               // mm above the ellipsoid
+    int32_t heightMsl;            // mm above mean sea level
+    uint32_t horizontalAccuracy;  // mm
+    uint32_t verticalAccuracy;    // mm
+  };
+
+  struct Velocity {
+    uint32_t tow;                 // ms into the GPS week
+    int32_t north;                // cm/s
+    int32_t east;                 // cm/s
+    int32_t down;                 // cm/s
+    uint32_t speed;               // cm/s, 3D
+    uint32_t groundSpeed;         // cm/s
+    int32_t course;               // 1e-5 degrees
+    uint32_t speedAccuracy;       // cm/s
+    uint32_t courseAccuracy;      // 1e-5 degrees
+  };
+
+  struct Solution {
+    uint32_t tow;                 // ms into the GPS week
+    int16_t week;                 // GPS week number
+    uint8_t fix;                  // UbxFix
+    uint8_t flags;                // bit 0 set when the fix is valid
+    uint32_t positionAccuracy;    // cm, 3D
+    uint16_t pdop;                // 0.01
+    uint8_t satellites;           // used in the solution
+  };
+
+  struct Time {
+    uint32_t tow;                 // ms into the GPS week
+    uint32_t accuracy;            // ns
+    int32_t nano;                 // ns to add to the second, -1e9 to 1e9
+    uint16_t year;                // UTC
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t valid;                // UBX_TIME_VALID_* bits
+  };
+
+  struct Stats {
+    uint32_t messages;            // good checksum
+    uint32_t failedChecksum;
+    uint32_t badLength;           // over UBX_LENGTH_MAX
+    uint32_t acks;
+    uint32_t naks;
+  };
+
+  UbxGps();
+
+  /**
+   * Parse bytes received from the GPS.
+   * @return messages completed with a good checksum
+   */
+  int encode(const uint8_t *data, size_t length);
+
+  /** UBX_UPDATED_* bits for what arrived since the last call. */
+  uint8_t updated();
+
+  const Position &position() const { return position_; }
+  const Velocity &velocity() const { return velocity_; }
+  const Solution &solution() const { return solution_; }
+  const Time &time() const { return time_; }
+
+  /** True if the last NAV-SOL reported a valid 2D or 3D fix. */
+  bool hasFix() const;
+
+  /**
+   * UTC at a GPS time of week, in ms into the day, going by the last
+   * NAV-TIMEUTC with a valid UTC time.
+   * @return false if there has not been one
+   */
+  bool utc(uint32_t tow, uint32_t *millis) const;
+
+  /** Watch for the answer to a configuration message about to be sent. */
+  void expectAck(uint8_t cls, uint8_t id);
+  UbxAck ack() const { return ack_; }
+
+  const Stats &stats() const { return stats_; }
+
+  /**
+   * Frame a message into out, which must hold length + UBX_OVERHEAD bytes.
+   * @return bytes written
+   */
+  static size_t frame(uint8_t *out, uint8_t cls, uint8_t id,
+                      const uint8_t *payload, uint16_t length);
+
+  /** CFG-PRT for UART 1, 8N1 at the given baud rate. */
+  static size_t configurePort(uint8_t *out, uint32_t baud,
+                              uint16_t inProtocols, uint16_t outProtocols);
+
+  /** CFG-MSG, send a message once every rate solutions, 0 for never. */
+  static size_t configureMessage(uint8_t *out, uint8_t cls, uint8_t id, uint8_t rate);
+
+  /** CFG-RATE, one measurement every period milliseconds. */
+  static size_t configureRate(uint8_t *out, uint16_t period);
+
+ private:
+  void complete();
+
+  uint8_t state_;
+  uint8_t class_;
+  uint8_t id_;
+  uint16_t length_;
+  uint16_t offset_;
+  uint8_t ck_a_;
+  uint8_t ck_b_;
+  uint8_t payload_[UBX_PAYLOAD_MAX];
+
+  uint8_t updated_;
+  uint8_t ack_class_;
+  uint8_t ack_id_;
+  UbxAck ack_;
+
+  Position position_;
+  Velocity velocity_;
+  Solution solution_;
+  Time time_;
+  Stats stats_;
+};
+
+#endif
@@ -29,13 +29,16 @@ THE SOFTWARE.
 ===============================================
 */
 
-// Arduino Wire library is required if I2Cdev I2CDEV_ARDUINO_WIRE implementation
-// is used in I2Cdev.h
-#include "Wire.h"
-
 // I2Cdev and MPU6050 must be installed as libraries, or else the .cpp/.h files
 // for both classes must be in the include path of your project
 #include "I2Cdev.h"
+
+// Arduino Wire library is required if I2Cdev I2CDEV_ARDUINO_WIRE implementation
+// is used in I2Cdev.h
+#if I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE
+    #include "Wire.h"
+#endif
+
 #include "MPU6050.h"
 
 // class default I2C address is 0x68
@@ -52,8 +55,11 @@ int16_t mx, my, mz;
 bool blinkState = false;
 
 void setup() {
-    // join I2C bus (I2Cdev library doesn't do this automatically)
-    Wire.begin();
+    // join I2C bus (I2Cdev library doesn't do this automatically, the
+    // I2CDEV_ASYNC_QUEUE implementation sets the bus up itself)
+    #if I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE
+        Wire.begin();
+    #endif
 
     // initialize serial communication
     // (38400 chosen because it works as well at 8MHz as it does at 16MHz, but
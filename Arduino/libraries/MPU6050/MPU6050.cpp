@@ -67,6 +67,55 @@ void MPU6050::initialize() {
     setSleepEnabled(false); // thanks to Jack Elston for pointing this one out!
 }
 
+/** Have the auxiliary I2C master poll the MPU-9150's AK8975 magnetometer.
+ * Slave 0 reads the magnetometer status and data into EXT_SENS_DATA_00 onward
+ * (swapped to big endian), then slave 2 triggers the next single measurement,
+ * both every (1 + delay) samples. After this getMotion9() reads all nine axes
+ * in one burst, with no bypass switching or waiting for the conversion. This
+ * is the same arrangement the MotionApps 4.1 DMP firmware expects.
+ * @param delay Samples skipped between polls, must cover the 9ms conversion
+ * @see getMotion9()
+ * @see MPU9150_MAG_EXT_SENS_XOUT
+ */
+void MPU6050::initializeMagnetometer(uint8_t delay) {
+    I2Cdev::writeByte(devAddr, MPU6050_RA_I2C_SLV0_ADDR, 0x80 | MPU9150_RA_MAG_ADDRESS);
+    I2Cdev::writeByte(devAddr, MPU6050_RA_I2C_SLV0_REG, MPU9150_RA_MAG_INFO);
+    I2Cdev::writeByte(devAddr, MPU6050_RA_I2C_SLV0_CTRL, 0xD0 | MPU9150_MAG_EXT_SENS_LENGTH); // enable, swap odd/even pairs
+    I2Cdev::writeByte(devAddr, MPU6050_RA_I2C_SLV2_ADDR, MPU9150_RA_MAG_ADDRESS);
+    I2Cdev::writeByte(devAddr, MPU6050_RA_I2C_SLV2_REG, MPU9150_RA_MAG_CNTL);
+    I2Cdev::writeByte(devAddr, MPU6050_RA_I2C_SLV2_CTRL, 0x81); // enable, 1 byte
+    I2Cdev::writeByte(devAddr, MPU6050_RA_I2C_SLV2_DO, MPU9150_MAG_SINGLE_MEASUREMENT);
+    I2Cdev::writeByte(devAddr, MPU6050_RA_I2C_SLV4_CTRL, delay & 0x1F);
+    I2Cdev::writeByte(devAddr, MPU6050_RA_I2C_MST_DELAY_CTRL, 0x05); // slaves 0 and 2 wait for the delay
+    setI2CBypassEnabled(false);
+    setI2CMasterModeEnabled(true);
+}
+
+/** Have I2Cdev shadow the configuration registers, so that the set* calls on
+ * them take a single write instead of a read and a write, and the get* calls
+ * no bus traffic at all once the value is known. Only registers the device
+ * never changes by itself are included; the reset bits in USER_CTRL and
+ * PWR_MGMT_1 clear themselves and are never kept as set. reset() forgets
+ * the shadowed values.
+ * @see I2Cdev::shadowRegister()
+ */
+void MPU6050::shadowConfigRegisters() {
+    static const uint8_t registers[] = {
+        MPU6050_RA_XG_OFFS_TC, MPU6050_RA_YG_OFFS_TC, MPU6050_RA_ZG_OFFS_TC,
+        MPU6050_RA_SMPLRT_DIV, MPU6050_RA_CONFIG, MPU6050_RA_GYRO_CONFIG, MPU6050_RA_ACCEL_CONFIG,
+        MPU6050_RA_FF_THR, MPU6050_RA_FF_DUR, MPU6050_RA_MOT_THR, MPU6050_RA_MOT_DUR,
+        MPU6050_RA_ZRMOT_THR, MPU6050_RA_ZRMOT_DUR, MPU6050_RA_FIFO_EN, MPU6050_RA_I2C_MST_CTRL,
+        MPU6050_RA_I2C_SLV0_CTRL, MPU6050_RA_I2C_SLV1_CTRL, MPU6050_RA_I2C_SLV2_CTRL, MPU6050_RA_I2C_SLV3_CTRL,
+        MPU6050_RA_INT_PIN_CFG, MPU6050_RA_INT_ENABLE, MPU6050_RA_I2C_MST_DELAY_CTRL,
+        MPU6050_RA_MOT_DETECT_CTRL, MPU6050_RA_PWR_MGMT_2, MPU6050_RA_DMP_CFG_1, MPU6050_RA_DMP_CFG_2
+    };
+    for (uint8_t i = 0; i < sizeof(registers); i++) I2Cdev::shadowRegister(devAddr, registers[i]);
+    I2Cdev::shadowRegister(devAddr, MPU6050_RA_USER_CTRL,
+        (1 << MPU6050_USERCTRL_DMP_RESET_BIT) | (1 << MPU6050_USERCTRL_FIFO_RESET_BIT) |
+        (1 << MPU6050_USERCTRL_I2C_MST_RESET_BIT) | (1 << MPU6050_USERCTRL_SIG_COND_RESET_BIT));
+    I2Cdev::shadowRegister(devAddr, MPU6050_RA_PWR_MGMT_1, 1 << MPU6050_PWR1_DEVICE_RESET_BIT);
+}
+
 /** Verify the I2C connection.
  * Make sure the device is connected and responds as expected.
  * @return True if connection is valid, false otherwise
@@ -1700,7 +1749,10 @@ bool MPU6050::getIntDataReadyStatus() {
 // ACCEL_*OUT_* registers
 
 /** Get raw 9-axis motion sensor readings (accel/gyro/compass).
- * FUNCTION NOT FULLY IMPLEMENTED YET.
+ * Reads the accelerometer, gyroscope and the magnetometer data last polled by
+ * the auxiliary I2C master in a single burst. The magnetometer values are only
+ * valid once initializeMagnetometer() (or dmpInitialize() with the 9-axis DMP)
+ * has set up the master, and change at the polling rate.
  * @param ax 16-bit signed integer container for accelerometer X-axis value
  * @param ay 16-bit signed integer container for accelerometer Y-axis value
  * @param az 16-bit signed integer container for accelerometer Z-axis value
@@ -1711,24 +1763,23 @@ bool MPU6050::getIntDataReadyStatus() {
  * @param my 16-bit signed integer container for magnetometer Y-axis value
  * @param mz 16-bit signed integer container for magnetometer Z-axis value
  * @see getMotion6()
- * @see getAcceleration()
- * @see getRotation()
+ * @see initializeMagnetometer()
  * @see MPU6050_RA_ACCEL_XOUT_H
  */
 void MPU6050::getMotion9(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz, int16_t* mx, int16_t* my, int16_t* mz) {
-    
-	//get accel and gyro
-	getMotion6(ax, ay, az, gx, gy, gz);
-	
-	//read mag
-	I2Cdev::writeByte(devAddr, MPU6050_RA_INT_PIN_CFG, 0x02); //set i2c bypass enable pin to true to access magnetometer
-	delay(10);
-	I2Cdev::writeByte(MPU9150_RA_MAG_ADDRESS, 0x0A, 0x01); //enable the magnetometer
-	delay(10);
-	I2Cdev::readBytes(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_XOUT_L, 6, buffer);
-	*mx = (((int16_t)buffer[0]) << 8) | buffer[1];
-    *my = (((int16_t)buffer[2]) << 8) | buffer[3];
-    *mz = (((int16_t)buffer[4]) << 8) | buffer[5];		
+    // ACCEL_XOUT_H through the magnetometer Z axis in EXT_SENS_DATA
+    uint8_t data[MPU6050_RA_EXT_SENS_DATA_00 - MPU6050_RA_ACCEL_XOUT_H + MPU9150_MAG_EXT_SENS_XOUT + 6];
+    const uint8_t *mag = data + MPU6050_RA_EXT_SENS_DATA_00 - MPU6050_RA_ACCEL_XOUT_H + MPU9150_MAG_EXT_SENS_XOUT;
+    I2Cdev::readBytes(devAddr, MPU6050_RA_ACCEL_XOUT_H, sizeof(data), data);
+    *ax = (((int16_t)data[0]) << 8) | data[1];
+    *ay = (((int16_t)data[2]) << 8) | data[3];
+    *az = (((int16_t)data[4]) << 8) | data[5];
+    *gx = (((int16_t)data[8]) << 8) | data[9];
+    *gy = (((int16_t)data[10]) << 8) | data[11];
+    *gz = (((int16_t)data[12]) << 8) | data[13];
+    *mx = (((int16_t)mag[0]) << 8) | mag[1];
+    *my = (((int16_t)mag[2]) << 8) | mag[3];
+    *mz = (((int16_t)mag[4]) << 8) | mag[5];
 }
 /** Get raw 6-axis motion sensor readings (accel/gyro).
  * Retrieves all currently available motion sensor values.
@@ -2369,6 +2420,7 @@ void MPU6050::resetSensors() {
  */
 void MPU6050::reset() {
     I2Cdev::writeBit(devAddr, MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_DEVICE_RESET_BIT, true);
+    I2Cdev::shadowInvalidate(devAddr); // back to power-on values
 }
 /** Get sleep mode status.
  * Setting the SLEEP bit in the register puts the device into very low power
@@ -2653,6 +2705,21 @@ uint16_t MPU6050::getFIFOCount() {
     I2Cdev::readBytes(devAddr, MPU6050_RA_FIFO_COUNTH, 2, buffer);
     return (((uint16_t)buffer[0]) << 8) | buffer[1];
 }
+#if I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE
+/** Start reading the FIFO buffer size without waiting for it.
+ * @param transfer Descriptor to queue, left alone until it has finished
+ * @param data Two bytes to read FIFO_COUNT_H and FIFO_COUNT_L into
+ * @param callback Called from the I2C interrupt when done, or 0
+ * @return False if the transfer queue is full
+ * @see getFIFOCount()
+ * @see I2Cqueue::submit()
+ */
+bool MPU6050::startFIFOCount(I2Ctransfer *transfer, uint8_t *data, I2CtransferCallback callback) {
+    transfer->setRead(devAddr, MPU6050_RA_FIFO_COUNTH, 2, data);
+    transfer->callback = callback;
+    return I2Cqueue::submit(transfer);
+}
+#endif
 
 // FIFO_R_W register
 
@@ -2688,6 +2755,34 @@ uint8_t MPU6050::getFIFOByte() {
 void MPU6050::getFIFOBytes(uint8_t *data, uint8_t length) {
     I2Cdev::readBytes(devAddr, MPU6050_RA_FIFO_R_W, length, data);
 }
+/** Get a long run of bytes from the FIFO buffer in as few bus transactions
+ * as the Wire buffer allows.
+ * @param data Buffer to store the FIFO bytes in
+ * @param length Number of bytes to read, should not exceed FIFO_COUNT
+ * @return Number of bytes read (-1 indicates failure)
+ * @see getFIFOBytes()
+ * @see I2Cdev::readStream()
+ */
+int16_t MPU6050::getFIFOStream(uint8_t *data, uint16_t length) {
+    return I2Cdev::readStream(devAddr, MPU6050_RA_FIFO_R_W, length, data);
+}
+#if I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE
+/** Start reading a run of bytes from the FIFO buffer without waiting for it,
+ * in a single bus read.
+ * @param transfer Descriptor to queue, left alone until it has finished
+ * @param data Buffer to store the FIFO bytes in
+ * @param length Number of bytes to read, should not exceed FIFO_COUNT
+ * @param callback Called from the I2C interrupt when done, or 0
+ * @return False if the transfer queue is full
+ * @see getFIFOStream()
+ * @see I2Cqueue::submit()
+ */
+bool MPU6050::startFIFOStream(I2Ctransfer *transfer, uint8_t *data, uint16_t length, I2CtransferCallback callback) {
+    transfer->setRead(devAddr, MPU6050_RA_FIFO_R_W, length, data);
+    transfer->callback = callback;
+    return I2Cqueue::submit(transfer);
+}
+#endif
 /** Write byte to FIFO buffer.
  * @see getFIFOByte()
  * @see MPU6050_RA_FIFO_R_W
@@ -2946,7 +3041,7 @@ void MPU6050::writeMemoryByte(uint8_t data) {
 void MPU6050::readMemoryBlock(uint8_t *data, uint16_t dataSize, uint8_t bank, uint8_t address) {
     setMemoryBank(bank);
     setMemoryStartAddress(address);
-    uint8_t chunkSize;
+    uint16_t chunkSize;
     for (uint16_t i = 0; i < dataSize;) {
         // determine correct chunk size according to bank position and data size
         chunkSize = MPU6050_DMP_MEMORY_CHUNK_SIZE;
@@ -2958,7 +3053,7 @@ void MPU6050::readMemoryBlock(uint8_t *data, uint16_t dataSize, uint8_t bank, ui
         if (chunkSize > 256 - address) chunkSize = 256 - address;
 
         // read the chunk of data as specified
-        I2Cdev::readBytes(devAddr, MPU6050_RA_MEM_R_W, chunkSize, data + i);
+        I2Cdev::readStream(devAddr, MPU6050_RA_MEM_R_W, chunkSize, data + i);
         
         // increase byte index by [chunkSize]
         i += chunkSize;
@@ -2974,16 +3069,39 @@ void MPU6050::readMemoryBlock(uint8_t *data, uint16_t dataSize, uint8_t bank, ui
         }
     }
 }
+
+// CRC-16/CCITT-FALSE, carried on from crc over length more bytes
+static uint16_t memoryCRC(uint16_t crc, const uint8_t *data, uint16_t length) {
+    while (length--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/** Write a block of DMP memory, in chunks of up to MPU6050_DMP_MEMORY_CHUNK_SIZE
+ * bytes that never cross a bank. Data in program memory is copied through a
+ * static buffer, nothing is allocated. To verify, the whole block is read back
+ * once it has all been written and its CRC compared with that of the data.
+ * @param data Data to write
+ * @param dataSize Number of bytes to write
+ * @param bank First memory bank to write to
+ * @param address Start address within the bank
+ * @param verify Read the block back and compare CRCs
+ * @param useProgMem Data is in program memory (PROGMEM)
+ * @return True if written (and verified)
+ */
 bool MPU6050::writeMemoryBlock(const uint8_t *data, uint16_t dataSize, uint8_t bank, uint8_t address, bool verify, bool useProgMem) {
+    static uint8_t chunkBuffer[MPU6050_DMP_MEMORY_CHUNK_SIZE];
+    const uint8_t firstBank = bank, firstAddress = address;
+    uint16_t crc = 0xFFFF;
+    uint16_t chunkSize;
+    uint16_t i;
+
     setMemoryBank(bank);
     setMemoryStartAddress(address);
-    uint8_t chunkSize;
-    uint8_t *verifyBuffer;
-    uint8_t *progBuffer;
-    uint16_t i;
-    uint8_t j;
-    if (verify) verifyBuffer = (uint8_t *)malloc(MPU6050_DMP_MEMORY_CHUNK_SIZE);
-    if (useProgMem) progBuffer = (uint8_t *)malloc(MPU6050_DMP_MEMORY_CHUNK_SIZE);
     for (i = 0; i < dataSize;) {
         // determine correct chunk size according to bank position and data size
         chunkSize = MPU6050_DMP_MEMORY_CHUNK_SIZE;
@@ -2993,45 +3111,14 @@ bool MPU6050::writeMemoryBlock(const uint8_t *data, uint16_t dataSize, uint8_t b
 
         // make sure this chunk doesn't go past the bank boundary (256 bytes)
         if (chunkSize > 256 - address) chunkSize = 256 - address;
-        
-        if (useProgMem) {
-            // write the chunk of data as specified
-            for (j = 0; j < chunkSize; j++) progBuffer[j] = pgm_read_byte(data + i + j);
-        } else {
-            // write the chunk of data as specified
-            progBuffer = (uint8_t *)data + i;
-        }
-
-        I2Cdev::writeBytes(devAddr, MPU6050_RA_MEM_R_W, chunkSize, progBuffer);
 
-        // verify data if needed
-        if (verify && verifyBuffer) {
-            setMemoryBank(bank);
-            setMemoryStartAddress(address);
-            I2Cdev::readBytes(devAddr, MPU6050_RA_MEM_R_W, chunkSize, verifyBuffer);
-            if (memcmp(progBuffer, verifyBuffer, chunkSize) != 0) {
-                /*Serial.print("Block write verification error, bank ");
-                Serial.print(bank, DEC);
-                Serial.print(", address ");
-                Serial.print(address, DEC);
-                Serial.print("!\nExpected:");
-                for (j = 0; j < chunkSize; j++) {
-                    Serial.print(" 0x");
-                    if (progBuffer[j] < 16) Serial.print("0");
-                    Serial.print(progBuffer[j], HEX);
-                }
-                Serial.print("\nReceived:");
-                for (uint8_t j = 0; j < chunkSize; j++) {
-                    Serial.print(" 0x");
-                    if (verifyBuffer[i + j] < 16) Serial.print("0");
-                    Serial.print(verifyBuffer[i + j], HEX);
-                }
-                Serial.print("\n");*/
-                free(verifyBuffer);
-                if (useProgMem) free(progBuffer);
-                return false; // uh oh.
-            }
+        uint8_t *chunk = (uint8_t *)data + i;
+        if (useProgMem) {
+            memcpy_P(chunkBuffer, data + i, chunkSize);
+            chunk = chunkBuffer;
         }
+        if (!I2Cdev::writeStream(devAddr, MPU6050_RA_MEM_R_W, chunkSize, chunk)) return false;
+        if (verify) crc = memoryCRC(crc, chunk, chunkSize);
 
         // increase byte index by [chunkSize]
         i += chunkSize;
@@ -3046,19 +3133,31 @@ bool MPU6050::writeMemoryBlock(const uint8_t *data, uint16_t dataSize, uint8_t b
             setMemoryStartAddress(address);
         }
     }
-    if (verify) free(verifyBuffer);
-    if (useProgMem) free(progBuffer);
-    return true;
+    if (!verify) return true;
+
+    // one pass back over the whole block
+    uint16_t readCRC = 0xFFFF;
+    bank = firstBank;
+    address = firstAddress;
+    for (i = 0; i < dataSize; i += chunkSize) {
+        chunkSize = MPU6050_DMP_MEMORY_CHUNK_SIZE;
+        if (i + chunkSize > dataSize) chunkSize = dataSize - i;
+        if (chunkSize > 256 - address) chunkSize = 256 - address;
+
+        readMemoryBlock(chunkBuffer, chunkSize, bank, address);
+        readCRC = memoryCRC(readCRC, chunkBuffer, chunkSize);
+
+        address += chunkSize;
+        if (address == 0) bank++;
+    }
+    return readCRC == crc; // uh oh, if not
 }
 bool MPU6050::writeProgMemoryBlock(const uint8_t *data, uint16_t dataSize, uint8_t bank, uint8_t address, bool verify) {
     return writeMemoryBlock(data, dataSize, bank, address, verify, true);
 }
-bool MPU6050::writeDMPConfigurationSet(const uint8_t *data, uint16_t dataSize, bool useProgMem) {
-    uint8_t *progBuffer, success, special;
-    uint16_t i, j;
-    if (useProgMem) {
-        progBuffer = (uint8_t *)malloc(8); // assume 8-byte blocks, realloc later if necessary
-    }
+bool MPU6050::writeDMPConfigurationSet(const uint8_t *data, uint16_t dataSize, bool useProgMem, bool verify) {
+    uint8_t success, special;
+    uint16_t i;
 
     // config set data is a long string of blocks with the following structure:
     // [bank] [offset] [length] [byte[0], byte[1], ..., byte[length]]
@@ -3083,13 +3182,7 @@ bool MPU6050::writeDMPConfigurationSet(const uint8_t *data, uint16_t dataSize, b
             Serial.print(offset);
             Serial.print(", length=");
             Serial.println(length);*/
-            if (useProgMem) {
-                if (sizeof(progBuffer) < length) progBuffer = (uint8_t *)realloc(progBuffer, length);
-                for (j = 0; j < length; j++) progBuffer[j] = pgm_read_byte(data + i + j);
-            } else {
-                progBuffer = (uint8_t *)data + i;
-            }
-            success = writeMemoryBlock(progBuffer, length, bank, offset, true);
+            success = writeMemoryBlock(data + i, length, bank, offset, verify, useProgMem);
             i += length;
         } else {
             // special instruction
@@ -3120,16 +3213,12 @@ bool MPU6050::writeDMPConfigurationSet(const uint8_t *data, uint16_t dataSize, b
             }
         }
         
-        if (!success) {
-            if (useProgMem) free(progBuffer);
-            return false; // uh oh
-        }
+        if (!success) return false; // uh oh
     }
-    if (useProgMem) free(progBuffer);
     return true;
 }
-bool MPU6050::writeProgDMPConfigurationSet(const uint8_t *data, uint16_t dataSize) {
-    return writeDMPConfigurationSet(data, dataSize, true);
+bool MPU6050::writeProgDMPConfigurationSet(const uint8_t *data, uint16_t dataSize, bool verify) {
+    return writeDMPConfigurationSet(data, dataSize, true, verify);
 }
 
 // DMP_CFG_1 register
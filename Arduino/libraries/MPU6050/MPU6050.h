@@ -48,6 +48,19 @@ THE SOFTWARE.
 #define MPU9150_RA_MAG_YOUT_H		0x06
 #define MPU9150_RA_MAG_ZOUT_L		0x07
 #define MPU9150_RA_MAG_ZOUT_H		0x08
+#define MPU9150_RA_MAG_INFO		0x01
+#define MPU9150_RA_MAG_CNTL		0x0A
+
+#define MPU9150_MAG_SINGLE_MEASUREMENT	0x01
+
+// The auxiliary I2C master polls the magnetometer (see initializeMagnetometer())
+// into EXT_SENS_DATA_00: two status bytes, then X, Y and Z swapped to big endian
+#define MPU9150_MAG_EXT_SENS_LENGTH	10
+#define MPU9150_MAG_EXT_SENS_XOUT	2
+
+// Samples skipped between magnetometer polls; at the DMP's 200Hz sample
+// rate 24 gives 8Hz, longer than the 9ms AK8975 conversion
+#define MPU9150_MAG_DEFAULT_DELAY	24
 
 #define MPU6050_ADDRESS_AD0_LOW     0x68 // address pin low (GND), default for InvenSense evaluation board
 #define MPU6050_ADDRESS_AD0_HIGH    0x69 // address pin high (VCC)
@@ -401,16 +414,49 @@ THE SOFTWARE.
 
 #define MPU6050_DMP_MEMORY_BANKS        8
 #define MPU6050_DMP_MEMORY_BANK_SIZE    256
-#define MPU6050_DMP_MEMORY_CHUNK_SIZE   16
+#if I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE
+    #define MPU6050_DMP_MEMORY_CHUNK_SIZE   256 // a bank per transfer, no buffer in the way
+#else
+    #define MPU6050_DMP_MEMORY_CHUNK_SIZE   16
+#endif
+
+// dmpInitialize() reads the firmware back once loaded and compares CRCs;
+// define this as false before including the MotionApps header to skip that
+#ifndef MPU6050_DMP_VERIFY
+    #define MPU6050_DMP_VERIFY              true
+#endif
 
 // note: DMP code memory blocks defined at end of header file
 
+#ifdef MPU6050_INCLUDE_DMP_MOTIONAPPS41
+    // bytes in one DMP FIFO packet, and packets read from the FIFO per
+    // burst by dmpGetFIFOSamples()
+    #define MPU6050_DMP_PACKET_SIZE     48
+    #define MPU6050_DMP_BATCH_PACKETS   4
+
+    // one DMP FIFO packet, parsed
+    struct MPU6050_DMPSample {
+        Quaternion q;
+        VectorInt16 gyro;
+        VectorInt16 accel;
+        uint32_t timestamp;  // micros() of its INT pulse, set by the caller
+    };
+#endif
+
 class MPU6050 {
+    private:
+        // ahead of the MotionApps members, so that MPU6050.cpp (built
+        // without them) and the sketch agree on where these live
+        uint8_t devAddr;
+        uint8_t buffer[14];
+
     public:
         MPU6050();
         MPU6050(uint8_t address);
 
         void initialize();
+        void initializeMagnetometer(uint8_t delay=MPU9150_MAG_DEFAULT_DELAY);
+        void shadowConfigRegisters();
         bool testConnection();
 
         // AUX_VDDIO register
@@ -674,11 +720,18 @@ class MPU6050 {
 
         // FIFO_COUNT_* registers
         uint16_t getFIFOCount();
+        #if I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE
+            bool startFIFOCount(I2Ctransfer *transfer, uint8_t *data, I2CtransferCallback callback=0);
+        #endif
 
         // FIFO_R_W register
         uint8_t getFIFOByte();
         void setFIFOByte(uint8_t data);
         void getFIFOBytes(uint8_t *data, uint8_t length);
+        int16_t getFIFOStream(uint8_t *data, uint16_t length);
+        #if I2CDEV_IMPLEMENTATION == I2CDEV_ASYNC_QUEUE
+            bool startFIFOStream(I2Ctransfer *transfer, uint8_t *data, uint16_t length, I2CtransferCallback callback=0);
+        #endif
 
         // WHO_AM_I register
         uint8_t getDeviceID();
@@ -772,8 +825,8 @@ class MPU6050 {
         bool writeMemoryBlock(const uint8_t *data, uint16_t dataSize, uint8_t bank=0, uint8_t address=0, bool verify=true, bool useProgMem=false);
         bool writeProgMemoryBlock(const uint8_t *data, uint16_t dataSize, uint8_t bank=0, uint8_t address=0, bool verify=true);
 
-        bool writeDMPConfigurationSet(const uint8_t *data, uint16_t dataSize, bool useProgMem=false);
-        bool writeProgDMPConfigurationSet(const uint8_t *data, uint16_t dataSize);
+        bool writeDMPConfigurationSet(const uint8_t *data, uint16_t dataSize, bool useProgMem=false, bool verify=true);
+        bool writeProgDMPConfigurationSet(const uint8_t *data, uint16_t dataSize, bool verify=true);
 
         // DMP_CFG_1 register
         uint8_t getDMPConfig1();
@@ -890,6 +943,7 @@ class MPU6050 {
             uint16_t dmpPacketSize;
 
             uint8_t dmpInitialize();
+            bool dmpResume();
             bool dmpPacketAvailable();
 
             uint8_t dmpSetFIFORate(uint8_t fifoRate);
@@ -973,6 +1027,8 @@ class MPU6050 {
 
             uint8_t dmpProcessFIFOPacket(const unsigned char *dmpData);
             uint8_t dmpReadAndProcessFIFOPacket(uint8_t numPackets, uint8_t *processed=NULL);
+            uint8_t dmpGetFIFOSamples(MPU6050_DMPSample *samples, uint8_t numPackets);
+            void dmpParseFIFOSamples(MPU6050_DMPSample *samples, const uint8_t *data, uint8_t numPackets);
 
             uint8_t dmpSetFIFOProcessedCallback(void (*func) (void));
 
@@ -985,10 +1041,6 @@ class MPU6050 {
             void dmpOverrideQuaternion(long *q);
             uint16_t dmpGetFIFOPacketSize();
         #endif
-
-    private:
-        uint8_t devAddr;
-        uint8_t buffer[14];
 };
 
 #endif /* _MPU6050_H_ */
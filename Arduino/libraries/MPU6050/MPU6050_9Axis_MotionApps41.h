@@ -63,6 +63,13 @@ THE SOFTWARE.
 #define MPU6050_DMP_CODE_SIZE       1962    // dmpMemory[]
 #define MPU6050_DMP_CONFIG_SIZE     232     // dmpConfig[]
 #define MPU6050_DMP_UPDATES_SIZE    140     // dmpUpdates[]
+#define MPU6050_DMP_RUNNING_SIZE    42      // dmpRunning[]
+
+// dmpResume() compares this much of the start of each firmware bank from
+// MPU6050_DMP_SIGNATURE_BANK on with dmpMemory[]. The DMP keeps its data in
+// the banks below, and dmpConfig[] and dmpUpdates[] patch the code further in
+#define MPU6050_DMP_SIGNATURE_BANK  3
+#define MPU6050_DMP_SIGNATURE_SIZE  32
 
 /* ================================================================================================ *
  | Default MotionApps v4.1 48-byte FIFO packet structure:                                           |
@@ -290,6 +297,19 @@ const prog_uchar dmpUpdates[MPU6050_DMP_UPDATES_SIZE] PROGMEM = {
     0x00,   0x60,   0x04,   0x00, 0x40, 0x00, 0x00
 };
 
+// the config registers as dmpInitialize() and setDMPEnabled(true) leave them,
+// as register, length, values
+const prog_uchar dmpRunning[MPU6050_DMP_RUNNING_SIZE] PROGMEM = {
+    0x19,   0x04,   0x04, 0x0B, 0x18, 0x00,             // 200 Hz, DLPF 42 Hz + TEMP_OUT_L sync, 2000 deg/s, 2 g
+    0x24,   0x0A,   0x00, 0x8C, 0x01, 0xDA, 0x00, 0x00, 0x00, 0x0C, 0x0A, 0x81, // I2C master, magnetometer on SLV0 and SLV2
+    0x34,   0x01,   0x18,                               // I2C_SLV4_CTRL
+    0x37,   0x02,   0x00, 0x12,                         // INT_PIN_CFG, DMP and FIFO_OFLOW interrupts
+    0x65,   0x03,   0x01, 0x00, 0x05,                   // I2C_SLV2_DO, I2C_MST_DELAY_CTRL
+    0x6A,   0x03,   0xE0, 0x03, 0x00,                   // DMP, FIFO and I2C master on, Z gyro clock, awake
+    0x70,   0x02,   0x03, 0x00,                         // DMP_CFG_1, DMP_CFG_2
+    0x75,   0x01,   0x68                                // WHO_AM_I
+};
+
 uint8_t MPU6050::dmpInitialize() {
     // reset device
     DEBUG_PRINTLN(F("\n\nResetting MPU6050..."));
@@ -347,16 +367,16 @@ uint8_t MPU6050::dmpInitialize() {
 
     DEBUG_PRINTLN(F("Setting magnetometer mode to power-down..."));
     //mag -> setMode(0);
-    I2Cdev::writeByte(0x0E, 0x0A, 0x00);
+    I2Cdev::writeByte(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_CNTL, 0x00);
 
     DEBUG_PRINTLN(F("Setting magnetometer mode to fuse access..."));
     //mag -> setMode(0x0F);
-    I2Cdev::writeByte(0x0E, 0x0A, 0x0F);
+    I2Cdev::writeByte(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_CNTL, 0x0F);
 
     DEBUG_PRINTLN(F("Reading mag magnetometer factory calibration..."));
     int8_t asax, asay, asaz;
     //mag -> getAdjustment(&asax, &asay, &asaz);
-    I2Cdev::readBytes(0x0E, 0x10, 3, buffer);
+    I2Cdev::readBytes(MPU9150_RA_MAG_ADDRESS, 0x10, 3, buffer);
     asax = (int8_t)buffer[0];
     asay = (int8_t)buffer[1];
     asaz = (int8_t)buffer[2];
@@ -369,13 +389,13 @@ uint8_t MPU6050::dmpInitialize() {
 
     DEBUG_PRINTLN(F("Setting magnetometer mode to power-down..."));
     //mag -> setMode(0);
-    I2Cdev::writeByte(0x0E, 0x0A, 0x00);
+    I2Cdev::writeByte(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_CNTL, 0x00);
 
     // load DMP code into memory banks
     DEBUG_PRINT(F("Writing DMP code to MPU memory banks ("));
     DEBUG_PRINT(MPU6050_DMP_CODE_SIZE);
     DEBUG_PRINTLN(F(" bytes)"));
-    if (writeProgMemoryBlock(dmpMemory, MPU6050_DMP_CODE_SIZE)) {
+    if (writeProgMemoryBlock(dmpMemory, MPU6050_DMP_CODE_SIZE, 0, 0, MPU6050_DMP_VERIFY)) {
         DEBUG_PRINTLN(F("Success! DMP code written and verified."));
 
         DEBUG_PRINTLN(F("Configuring DMP and related settings..."));
@@ -384,7 +404,7 @@ uint8_t MPU6050::dmpInitialize() {
         DEBUG_PRINT(F("Writing DMP configuration to MPU memory banks ("));
         DEBUG_PRINT(MPU6050_DMP_CONFIG_SIZE);
         DEBUG_PRINTLN(F(" bytes in config def)"));
-        if (writeProgDMPConfigurationSet(dmpConfig, MPU6050_DMP_CONFIG_SIZE)) {
+        if (writeProgDMPConfigurationSet(dmpConfig, MPU6050_DMP_CONFIG_SIZE, MPU6050_DMP_VERIFY)) {
             DEBUG_PRINTLN(F("Success! DMP configuration written and verified."));
 
             DEBUG_PRINTLN(F("Setting DMP and FIFO_OFLOW interrupts enabled..."));
@@ -471,25 +491,13 @@ uint8_t MPU6050::dmpInitialize() {
 
             DEBUG_PRINTLN(F("Setting AK8975 to single measurement mode..."));
             //mag -> setMode(1);
-            I2Cdev::writeByte(0x0E, 0x0A, 0x01);
-
-            // setup AK8975 (0x0E) as Slave 0 in read mode
-            DEBUG_PRINTLN(F("Setting up AK8975 read slave 0..."));
-            I2Cdev::writeByte(0x68, MPU6050_RA_I2C_SLV0_ADDR, 0x8E);
-            I2Cdev::writeByte(0x68, MPU6050_RA_I2C_SLV0_REG,  0x01);
-            I2Cdev::writeByte(0x68, MPU6050_RA_I2C_SLV0_CTRL, 0xDA);
-
-            // setup AK8975 (0x0E) as Slave 2 in write mode
-            DEBUG_PRINTLN(F("Setting up AK8975 write slave 2..."));
-            I2Cdev::writeByte(0x68, MPU6050_RA_I2C_SLV2_ADDR, 0x0E);
-            I2Cdev::writeByte(0x68, MPU6050_RA_I2C_SLV2_REG,  0x0A);
-            I2Cdev::writeByte(0x68, MPU6050_RA_I2C_SLV2_CTRL, 0x81);
-            I2Cdev::writeByte(0x68, MPU6050_RA_I2C_SLV2_DO,   0x01);
-
-            // setup I2C timing/delay control
-            DEBUG_PRINTLN(F("Setting up slave access delay..."));
-            I2Cdev::writeByte(0x68, MPU6050_RA_I2C_SLV4_CTRL, 0x18);
-            I2Cdev::writeByte(0x68, MPU6050_RA_I2C_MST_DELAY_CTRL, 0x05);
+            I2Cdev::writeByte(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_CNTL, MPU9150_MAG_SINGLE_MEASUREMENT);
+
+            // setup AK8975 (0x0C on the MPU-9150, 0x0E on the InvenSense
+            // evaluation board this came from) as read slave 0 and write
+            // slave 2, polled every 25 samples
+            DEBUG_PRINTLN(F("Setting up AK8975 slaves and access delay..."));
+            initializeMagnetometer(MPU9150_MAG_DEFAULT_DELAY);
 
             // enable interrupts
             DEBUG_PRINTLN(F("Enabling default interrupt behavior/no bypass..."));
@@ -587,7 +595,7 @@ uint8_t MPU6050::dmpInitialize() {
             setDMPEnabled(false);
 
             DEBUG_PRINTLN(F("Setting up internal 48-byte (default) DMP packet buffer..."));
-            dmpPacketSize = 48;
+            dmpPacketSize = MPU6050_DMP_PACKET_SIZE;
             /*if ((dmpPacketBuffer = (uint8_t *)malloc(42)) == 0) {
                 return 3; // TODO: proper error code for no memory
             }*/
@@ -606,6 +614,52 @@ uint8_t MPU6050::dmpInitialize() {
     return 0; // success
 }
 
+/** Take over a DMP that is already running, as after a reset of the MCU alone
+ * (brownout, watchdog) with the MPU still powered. Reads back the config
+ * registers and the start of each firmware bank and compares them with what
+ * dmpInitialize() and setDMPEnabled(true) leave; if they all match, resets
+ * the FIFO so reading starts on a packet boundary and leaves the DMP running.
+ * A few ms on the bus, where initialize() and dmpInitialize() take over half
+ * a second.
+ * @return True if the DMP has been taken over, false if it has to be set up
+ * again from initialize()
+ */
+bool MPU6050::dmpResume() {
+    uint8_t data[MPU6050_DMP_SIGNATURE_SIZE], expected[MPU6050_DMP_SIGNATURE_SIZE];
+    uint16_t i, j, length;
+
+    DEBUG_PRINTLN(F("Checking config registers..."));
+    for (i = 0; i < MPU6050_DMP_RUNNING_SIZE; i += length + 2) {
+        uint8_t regAddr = pgm_read_byte(&dmpRunning[i]);
+        length = pgm_read_byte(&dmpRunning[i + 1]);
+        for (j = 0; j < length; j++) expected[j] = pgm_read_byte(&dmpRunning[i + 2 + j]);
+        if (I2Cdev::readBytes(devAddr, regAddr, length, data) != (int8_t)length) return false;
+        if (memcmp(data, expected, length) != 0) {
+            DEBUG_PRINT(F("Register 0x"));
+            DEBUG_PRINTF(regAddr, HEX);
+            DEBUG_PRINTLN(F(" differs, DMP not running as set up"));
+            return false;
+        }
+    }
+
+    DEBUG_PRINTLN(F("Checking DMP code signature..."));
+    for (i = MPU6050_DMP_SIGNATURE_BANK * MPU6050_DMP_MEMORY_BANK_SIZE; i < MPU6050_DMP_CODE_SIZE; i += MPU6050_DMP_MEMORY_BANK_SIZE) {
+        length = min(MPU6050_DMP_SIGNATURE_SIZE, MPU6050_DMP_CODE_SIZE - i);
+        for (j = 0; j < length; j++) expected[j] = pgm_read_byte(&dmpMemory[i + j]);
+        readMemoryBlock(data, length, i / MPU6050_DMP_MEMORY_BANK_SIZE, 0);
+        if (memcmp(data, expected, length) != 0) {
+            DEBUG_PRINTLN(F("Code differs, DMP not loaded"));
+            return false;
+        }
+    }
+
+    DEBUG_PRINTLN(F("DMP running, resetting FIFO..."));
+    dmpPacketSize = MPU6050_DMP_PACKET_SIZE;
+    resetFIFO();
+    getIntStatus();
+    return true;
+}
+
 bool MPU6050::dmpPacketAvailable() {
     return getFIFOCount() >= dmpGetFIFOPacketSize();
 }
@@ -706,6 +760,14 @@ uint8_t MPU6050::dmpGetGyro(int16_t *data, const uint8_t* packet) {
     data[2] = (packet[24] << 8) + packet[25];
     return 0;
 }
+uint8_t MPU6050::dmpGetGyro(VectorInt16 *v, const uint8_t* packet) {
+    // TODO: accommodate different arrangements of sent data (ONLY default supported now)
+    if (packet == 0) packet = dmpPacketBuffer;
+    v -> x = (packet[16] << 8) + packet[17];
+    v -> y = (packet[20] << 8) + packet[21];
+    v -> z = (packet[24] << 8) + packet[25];
+    return 0;
+}
 uint8_t MPU6050::dmpGetMag(int16_t *data, const uint8_t* packet) {
     // TODO: accommodate different arrangements of sent data (ONLY default supported now)
     if (packet == 0) packet = dmpPacketBuffer;
@@ -792,6 +854,37 @@ uint8_t MPU6050::dmpReadAndProcessFIFOPacket(uint8_t numPackets, uint8_t *proces
     return 0;
 }
 
+// Reads numPackets packets, which the caller has checked are in the FIFO,
+// MPU6050_DMP_BATCH_PACKETS at a time, and parses them into samples.
+// Returns the number of samples filled in.
+uint8_t MPU6050::dmpGetFIFOSamples(MPU6050_DMPSample *samples, uint8_t numPackets) {
+    uint8_t buf[MPU6050_DMP_BATCH_PACKETS * MPU6050_DMP_PACKET_SIZE];
+    uint8_t done = 0;
+
+    // dmpPacketSize is only ever set to MPU6050_DMP_PACKET_SIZE; anything
+    // bigger would overrun buf
+    if (dmpPacketSize > MPU6050_DMP_PACKET_SIZE) return 0;
+    while (done < numPackets) {
+        uint8_t n = min(numPackets - done, MPU6050_DMP_BATCH_PACKETS);
+        if (getFIFOStream(buf, n * dmpPacketSize) != n * dmpPacketSize) break;
+
+        dmpParseFIFOSamples(samples + done, buf, n);
+        done += n;
+    }
+    return done;
+}
+
+// Parses numPackets packets read from the FIFO some other way, e.g. with
+// startFIFOStream(), into samples.
+void MPU6050::dmpParseFIFOSamples(MPU6050_DMPSample *samples, const uint8_t *data, uint8_t numPackets) {
+    for (uint8_t i = 0; i < numPackets; i++) {
+        const uint8_t *packet = data + i * dmpPacketSize;
+        dmpGetQuaternion(&samples[i].q, packet);
+        dmpGetGyro(&samples[i].gyro, packet);
+        dmpGetAccel(&samples[i].accel, packet);
+    }
+}
+
 // uint8_t MPU6050::dmpSetFIFOProcessedCallback(void (*func) (void));
 
 // uint8_t MPU6050::dmpInitFIFOParam();
@@ -23,8 +23,42 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "TinyGPS.h"
 
-#define _GPRMC_TERM   "GPRMC"
-#define _GPGGA_TERM   "GPGGA"
+// sentence identifiers after the two letter talker, in the order of the
+// _GPS_SENTENCE_ types
+static const char *_sentence_ids[] = {"RMC", "GGA", "VTG", "GSA", "GST"};
+#define _GPS_SENTENCES (sizeof(_sentence_ids) / sizeof(_sentence_ids[0]))
+
+// what each term of a sentence holds
+enum {
+  _GPS_FIELD_NONE, _GPS_FIELD_TIME, _GPS_FIELD_RMC_STATUS, _GPS_FIELD_LATITUDE,
+  _GPS_FIELD_NS, _GPS_FIELD_LONGITUDE, _GPS_FIELD_EW, _GPS_FIELD_SPEED,
+  _GPS_FIELD_COURSE, _GPS_FIELD_DATE, _GPS_FIELD_GGA_QUALITY, _GPS_FIELD_SATELLITES,
+  _GPS_FIELD_HDOP, _GPS_FIELD_ALTITUDE, _GPS_FIELD_VTG_MODE, _GPS_FIELD_FIX_TYPE,
+  _GPS_FIELD_PDOP, _GPS_FIELD_VDOP, _GPS_FIELD_LAT_ERROR, _GPS_FIELD_LON_ERROR,
+  _GPS_FIELD_ALT_ERROR
+};
+
+// field of each term by sentence type and term number, so a term costs one
+// lookup whichever sentence it is in; terms past the end hold nothing used
+#define _GPS_TERMS 18
+static const byte _fields[_GPS_SENTENCES][_GPS_TERMS] = {
+  // RMC: time, status, lat, N/S, lon, E/W, knots, course, date
+  {0, _GPS_FIELD_TIME, _GPS_FIELD_RMC_STATUS, _GPS_FIELD_LATITUDE, _GPS_FIELD_NS,
+   _GPS_FIELD_LONGITUDE, _GPS_FIELD_EW, _GPS_FIELD_SPEED, _GPS_FIELD_COURSE,
+   _GPS_FIELD_DATE},
+  // GGA: time, lat, N/S, lon, E/W, quality, satellites, HDOP, altitude
+  {0, _GPS_FIELD_TIME, _GPS_FIELD_LATITUDE, _GPS_FIELD_NS, _GPS_FIELD_LONGITUDE,
+   _GPS_FIELD_EW, _GPS_FIELD_GGA_QUALITY, _GPS_FIELD_SATELLITES, _GPS_FIELD_HDOP,
+   _GPS_FIELD_ALTITUDE},
+  // VTG: true course, T, magnetic course, M, knots, N, km/h, K, mode
+  {0, _GPS_FIELD_COURSE, 0, 0, 0, _GPS_FIELD_SPEED, 0, 0, 0, _GPS_FIELD_VTG_MODE},
+  // GSA: mode, fix type, 12 satellites, PDOP, HDOP, VDOP
+  {0, 0, _GPS_FIELD_FIX_TYPE, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+   _GPS_FIELD_PDOP, _GPS_FIELD_HDOP, _GPS_FIELD_VDOP},
+  // GST: time, RMS, ellipse major, minor, orientation, lat, lon, alt error
+  {0, _GPS_FIELD_TIME, 0, 0, 0, 0, _GPS_FIELD_LAT_ERROR, _GPS_FIELD_LON_ERROR,
+   _GPS_FIELD_ALT_ERROR}
+};
 
 TinyGPS::TinyGPS()
   :  _time(GPS_INVALID_TIME)
@@ -36,6 +70,12 @@ TinyGPS::TinyGPS()
   ,  _course(GPS_INVALID_ANGLE)
   ,  _hdop(GPS_INVALID_HDOP)
   ,  _numsats(GPS_INVALID_SATELLITES)
+  ,  _pdop(GPS_INVALID_DOP)
+  ,  _vdop(GPS_INVALID_DOP)
+  ,  _fix_type(GPS_INVALID_FIX_TYPE)
+  ,  _lat_error(GPS_INVALID_ERROR)
+  ,  _lon_error(GPS_INVALID_ERROR)
+  ,  _alt_error(GPS_INVALID_ERROR)
   ,  _last_time_fix(GPS_INVALID_FIX_TIME)
   ,  _last_position_fix(GPS_INVALID_FIX_TIME)
   ,  _parity(0)
@@ -67,26 +107,13 @@ bool TinyGPS::encode(char c)
   switch(c)
   {
   case ',': // term terminators
-    _parity ^= c;
   case '\r':
   case '\n':
   case '*':
-    if (_term_offset < sizeof(_term))
-    {
-      _term[_term_offset] = 0;
-      valid_sentence = term_complete();
-    }
-    ++_term_number;
-    _term_offset = 0;
-    _is_checksum_term = c == '*';
-    return valid_sentence;
+    return end_term(c);
 
   case '$': // sentence begin
-    _term_number = _term_offset = 0;
-    _parity = 0;
-    _sentence_type = _GPS_SENTENCE_OTHER;
-    _is_checksum_term = false;
-    _gps_data_good = false;
+    begin_sentence();
     return valid_sentence;
   }
 
@@ -99,6 +126,49 @@ bool TinyGPS::encode(char c)
   return valid_sentence;
 }
 
+// Same as calling encode(char) for each character, but the ordinary
+// characters between two delimiters are copied and XORed in a loop of
+// their own, and the statistics are counted once per buffer
+int TinyGPS::encode(const char *data, size_t length)
+{
+  const char *p = data;
+  const char *end = data + length;
+  int sentences = 0;
+
+#ifndef _GPS_NO_STATS
+  _encoded_characters += length;
+#endif
+  while (p < end)
+  {
+    // run of ordinary characters; every delimiter sorts at or below ','
+    byte parity = _parity;
+    byte offset = _term_offset;
+    char c = 0;
+    while (p < end)
+    {
+      c = *p;
+      if (c <= ',' && (c == ',' || c == '*' || c == '$' || c == '\r' || c == '\n'))
+        break;
+      if (offset < sizeof(_term) - 1)
+        _term[offset++] = c;
+      parity ^= c;
+      ++p;
+    }
+    _term_offset = offset;
+    if (!_is_checksum_term)
+      _parity = parity;
+    if (p == end)
+      break;
+    ++p;
+
+    if (c == '$')
+      begin_sentence();
+    else if (end_term(c))
+      ++sentences;
+  }
+  return sentences;
+}
+
 #ifndef _GPS_NO_STATS
 void TinyGPS::stats(unsigned long *chars, unsigned short *sentences, unsigned short *failed_cs)
 {
@@ -111,6 +181,34 @@ void TinyGPS::stats(unsigned long *chars, unsigned short *sentences, unsigned sh
 //
 // internal utilities
 //
+void TinyGPS::begin_sentence()
+{
+  _term_number = _term_offset = 0;
+  _parity = 0;
+  _sentence_type = _GPS_SENTENCE_OTHER;
+  _is_checksum_term = false;
+  _gps_data_good = false;
+}
+
+// Processes a term terminator: ',', '*', '\r' or '\n'
+// Returns true if it completed a valid sentence
+bool TinyGPS::end_term(char c)
+{
+  bool valid_sentence = false;
+
+  if (c == ',')
+    _parity ^= c;
+  if (_term_offset < sizeof(_term))
+  {
+    _term[_term_offset] = 0;
+    valid_sentence = term_complete();
+  }
+  ++_term_number;
+  _term_offset = 0;
+  _is_checksum_term = c == '*';
+  return valid_sentence;
+}
+
 int TinyGPS::from_hex(char a) 
 {
   if (a >= 'A' && a <= 'F')
@@ -159,8 +257,6 @@ unsigned long TinyGPS::parse_degrees()
   return (left_of_decimal / 100) * 1000000 + (hundred1000ths_of_minute + 3) / 6;
 }
 
-#define COMBINE(sentence_type, term_number) (((unsigned)(sentence_type) << 5) | term_number)
-
 // Processes a just-completed term
 // Returns true if new sentence has just passed checksum test and is validated
 bool TinyGPS::term_complete()
@@ -180,7 +276,7 @@ bool TinyGPS::term_complete()
 
         switch(_sentence_type)
         {
-        case _GPS_SENTENCE_GPRMC:
+        case _GPS_SENTENCE_RMC:
           _time      = _new_time;
           _date      = _new_date;
           _latitude  = _new_latitude;
@@ -188,7 +284,7 @@ bool TinyGPS::term_complete()
           _speed     = _new_speed;
           _course    = _new_course;
           break;
-        case _GPS_SENTENCE_GPGGA:
+        case _GPS_SENTENCE_GGA:
           _altitude  = _new_altitude;
           _time      = _new_time;
           _latitude  = _new_latitude;
@@ -196,6 +292,22 @@ bool TinyGPS::term_complete()
           _numsats   = _new_numsats;
           _hdop      = _new_hdop;
           break;
+        case _GPS_SENTENCE_VTG:
+          _speed     = _new_speed;
+          _course    = _new_course;
+          break;
+        case _GPS_SENTENCE_GSA:
+          _fix_type  = _new_fix_type;
+          _pdop      = _new_pdop;
+          _hdop      = _new_hdop;
+          _vdop      = _new_vdop;
+          break;
+        case _GPS_SENTENCE_GST:
+          _time      = _new_time;
+          _lat_error = _new_lat_error;
+          _lon_error = _new_lon_error;
+          _alt_error = _new_alt_error;
+          break;
         }
 
         return true;
@@ -209,69 +321,92 @@ bool TinyGPS::term_complete()
     return false;
   }
 
-  // the first term determines the sentence type
+  // the first term determines the sentence type: a two letter talker,
+  // which any receiver may use, then the sentence identifier
   if (_term_number == 0)
   {
-    if (!gpsstrcmp(_term, _GPRMC_TERM))
-      _sentence_type = _GPS_SENTENCE_GPRMC;
-    else if (!gpsstrcmp(_term, _GPGGA_TERM))
-      _sentence_type = _GPS_SENTENCE_GPGGA;
-    else
-      _sentence_type = _GPS_SENTENCE_OTHER;
+    _sentence_type = _GPS_SENTENCE_OTHER;
+    if (_term_offset == 5 && _term[0] != 'P') // not proprietary
+      for (byte i = 0; i < _GPS_SENTENCES; ++i)
+        if (!gpsstrcmp(_term + 2, _sentence_ids[i]))
+          _sentence_type = i;
     return false;
   }
 
-  if (_sentence_type != _GPS_SENTENCE_OTHER && _term[0])
-    switch(COMBINE(_sentence_type, _term_number))
+  if (_sentence_type == _GPS_SENTENCE_OTHER || !_term[0] || _term_number >= _GPS_TERMS)
+    return false;
+
+  switch(_fields[_sentence_type][_term_number])
   {
-    case COMBINE(_GPS_SENTENCE_GPRMC, 1): // Time in both sentences
-    case COMBINE(_GPS_SENTENCE_GPGGA, 1):
+    case _GPS_FIELD_TIME:
       _new_time = parse_decimal();
       _new_time_fix = millis();
       break;
-    case COMBINE(_GPS_SENTENCE_GPRMC, 2): // GPRMC validity
+    case _GPS_FIELD_RMC_STATUS:
       _gps_data_good = _term[0] == 'A';
       break;
-    case COMBINE(_GPS_SENTENCE_GPRMC, 3): // Latitude
-    case COMBINE(_GPS_SENTENCE_GPGGA, 2):
+    case _GPS_FIELD_LATITUDE:
       _new_latitude = parse_degrees();
       _new_position_fix = millis();
       break;
-    case COMBINE(_GPS_SENTENCE_GPRMC, 4): // N/S
-    case COMBINE(_GPS_SENTENCE_GPGGA, 3):
+    case _GPS_FIELD_NS:
       if (_term[0] == 'S')
         _new_latitude = -_new_latitude;
       break;
-    case COMBINE(_GPS_SENTENCE_GPRMC, 5): // Longitude
-    case COMBINE(_GPS_SENTENCE_GPGGA, 4):
+    case _GPS_FIELD_LONGITUDE:
       _new_longitude = parse_degrees();
       break;
-    case COMBINE(_GPS_SENTENCE_GPRMC, 6): // E/W
-    case COMBINE(_GPS_SENTENCE_GPGGA, 5):
+    case _GPS_FIELD_EW:
       if (_term[0] == 'W')
         _new_longitude = -_new_longitude;
       break;
-    case COMBINE(_GPS_SENTENCE_GPRMC, 7): // Speed (GPRMC)
+    case _GPS_FIELD_SPEED:
       _new_speed = parse_decimal();
+      if (_sentence_type == _GPS_SENTENCE_VTG)
+        _gps_data_good = true;
       break;
-    case COMBINE(_GPS_SENTENCE_GPRMC, 8): // Course (GPRMC)
+    case _GPS_FIELD_COURSE:
       _new_course = parse_decimal();
       break;
-    case COMBINE(_GPS_SENTENCE_GPRMC, 9): // Date (GPRMC)
+    case _GPS_FIELD_DATE:
       _new_date = gpsatol(_term);
       break;
-    case COMBINE(_GPS_SENTENCE_GPGGA, 6): // Fix data (GPGGA)
+    case _GPS_FIELD_GGA_QUALITY:
       _gps_data_good = _term[0] > '0';
       break;
-    case COMBINE(_GPS_SENTENCE_GPGGA, 7): // Satellites used (GPGGA)
+    case _GPS_FIELD_SATELLITES:
       _new_numsats = (unsigned char)atoi(_term);
       break;
-    case COMBINE(_GPS_SENTENCE_GPGGA, 8): // HDOP
+    case _GPS_FIELD_HDOP:
       _new_hdop = parse_decimal();
       break;
-    case COMBINE(_GPS_SENTENCE_GPGGA, 9): // Altitude (GPGGA)
+    case _GPS_FIELD_ALTITUDE:
       _new_altitude = parse_decimal();
       break;
+    case _GPS_FIELD_VTG_MODE: // NMEA 2.3 and later; N is not valid
+      if (_term[0] == 'N')
+        _gps_data_good = false;
+      break;
+    case _GPS_FIELD_FIX_TYPE:
+      _new_fix_type = _term[0] - '0';
+      _gps_data_good = _new_fix_type >= GPS_FIX_NONE && _new_fix_type <= GPS_FIX_3D;
+      break;
+    case _GPS_FIELD_PDOP:
+      _new_pdop = parse_decimal();
+      break;
+    case _GPS_FIELD_VDOP:
+      _new_vdop = parse_decimal();
+      break;
+    case _GPS_FIELD_LAT_ERROR:
+      _new_lat_error = parse_decimal();
+      _gps_data_good = true;
+      break;
+    case _GPS_FIELD_LON_ERROR:
+      _new_lon_error = parse_decimal();
+      break;
+    case _GPS_FIELD_ALT_ERROR:
+      _new_alt_error = parse_decimal();
+      break;
   }
 
   return false;
@@ -48,13 +48,20 @@ public:
     GPS_INVALID_ALTITUDE = 999999999,  GPS_INVALID_DATE = 0,
     GPS_INVALID_TIME = 0xFFFFFFFF,		 GPS_INVALID_SPEED = 999999999, 
     GPS_INVALID_FIX_TIME = 0xFFFFFFFF, GPS_INVALID_SATELLITES = 0xFF,
-    GPS_INVALID_HDOP = 0xFFFFFFFF
+    GPS_INVALID_HDOP = 0xFFFFFFFF,     GPS_INVALID_DOP = 0xFFFFFFFF,
+    GPS_INVALID_ERROR = 0xFFFFFFFF,    GPS_INVALID_FIX_TYPE = 0
   };
 
+  // fix types reported by GPGSA
+  enum {GPS_FIX_NONE = 1, GPS_FIX_2D = 2, GPS_FIX_3D = 3};
+
   static const float GPS_INVALID_F_ANGLE, GPS_INVALID_F_ALTITUDE, GPS_INVALID_F_SPEED;
 
   TinyGPS();
   bool encode(char c); // process one character received from GPS
+  // process a buffer of characters received from GPS; returns the number of
+  // sentences completed with a good checksum and valid data
+  int encode(const char *data, size_t length);
   TinyGPS &operator << (char c) {encode(c); return *this;}
 
   // lat/long in MILLIONTHs of a degree and age of fix in milliseconds
@@ -67,18 +74,31 @@ public:
   // signed altitude in centimeters (from GPGGA sentence)
   inline long altitude() { return _altitude; }
 
-  // course in last full GPRMC sentence in 100th of a degree
+  // course in last full RMC or VTG sentence in 100th of a degree
   inline unsigned long course() { return _course; }
 
-  // speed in last full GPRMC sentence in 100ths of a knot
+  // speed in last full RMC or VTG sentence in 100ths of a knot
   inline unsigned long speed() { return _speed; }
 
   // satellites used in last full GPGGA sentence
   inline unsigned short satellites() { return _numsats; }
 
-  // horizontal dilution of precision in 100ths
+  // horizontal dilution of precision in 100ths (GGA or GSA)
   inline unsigned long hdop() { return _hdop; }
 
+  // position and vertical dilution of precision in 100ths (GSA)
+  inline unsigned long pdop() { return _pdop; }
+  inline unsigned long vdop() { return _vdop; }
+
+  // GPS_FIX_NONE, GPS_FIX_2D or GPS_FIX_3D (GSA)
+  inline byte fix_type() { return _fix_type; }
+
+  // standard deviation of latitude, longitude and altitude error in
+  // centimeters (GST)
+  inline unsigned long lat_error() { return _lat_error; }
+  inline unsigned long lon_error() { return _lon_error; }
+  inline unsigned long alt_error() { return _alt_error; }
+
   void f_get_position(float *latitude, float *longitude, unsigned long *fix_age = 0);
   void crack_datetime(int *year, byte *month, byte *day, 
     byte *hour, byte *minute, byte *second, byte *hundredths = 0, unsigned long *fix_age = 0);
@@ -100,7 +120,12 @@ public:
 #endif
 
 private:
-  enum {_GPS_SENTENCE_GPGGA, _GPS_SENTENCE_GPRMC, _GPS_SENTENCE_OTHER};
+  // sentence types, whatever the talker (GP, GN, GL...); the order is
+  // that of the field table in TinyGPS.cpp
+  enum {
+    _GPS_SENTENCE_RMC, _GPS_SENTENCE_GGA, _GPS_SENTENCE_VTG,
+    _GPS_SENTENCE_GSA, _GPS_SENTENCE_GST, _GPS_SENTENCE_OTHER
+  };
 
   // properties
   unsigned long _time, _new_time;
@@ -112,6 +137,12 @@ private:
   unsigned long  _course, _new_course;
   unsigned long  _hdop, _new_hdop;
   unsigned short _numsats, _new_numsats;
+  unsigned long  _pdop, _new_pdop;
+  unsigned long  _vdop, _new_vdop;
+  byte           _fix_type, _new_fix_type;
+  unsigned long  _lat_error, _new_lat_error;
+  unsigned long  _lon_error, _new_lon_error;
+  unsigned long  _alt_error, _new_alt_error;
 
   unsigned long _last_time_fix, _new_time_fix;
   unsigned long _last_position_fix, _new_position_fix;
@@ -134,6 +165,8 @@ private:
 #endif
 
   // internal utilities
+  void begin_sentence();
+  bool end_term(char c);
   int from_hex(char a);
   unsigned long parse_decimal();
   unsigned long parse_degrees();
@@ -0,0 +1,186 @@
+#include <string.h>
+
+#include "TelemetryDecoder.h"
+
+namespace gs {
+
+namespace {
+
+const double POWERS_OF_TEN[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+  1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+};
+
+// Digits that fit in the int64 mantissa without overflow
+const int MAX_DIGITS = 18;
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+}
+
+TelemetryDecoder::TelemetryDecoder() {
+  reset();
+}
+
+void TelemetryDecoder::reset() {
+  length_ = 0;
+  line_start_ = 0;
+  junk_counted_ = false;
+  discard_ = false;
+  have_sequence_ = false;
+  next_sequence_ = 0;
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+size_t TelemetryDecoder::decode(const uint8_t *data, size_t length,
+                                std::vector<Sample> &out) {
+  const size_t before = out.size();
+  const uint8_t *p = data;
+  const uint8_t *const end = data + length;
+  stats_.bytes += length;
+
+  while (p < end) {
+    // Everything up to the next possible delimiter is copied in one go
+    const uint8_t *stop = p;
+    while (stop < end && *stop != '\n' && *stop != 0) stop++;
+
+    const size_t n = stop - p;
+    if (!discard_ && length_ + n < PENDING_SIZE) {
+      memcpy(pending_ + length_, p, n);
+      length_ += n;
+    } else if (!discard_) {
+      // No message is this long; skip to the next delimiter
+      stats_.overruns++;
+      discard_ = true;
+    }
+    if (stop == end) break;
+
+    if (discard_) {
+      discard_ = false;
+      length_ = 0;
+      line_start_ = 0;
+      junk_counted_ = false;
+    } else if (*stop == '\n') {
+      endLine(out);
+    } else {
+      endFrame(out);
+    }
+    p = stop + 1;
+  }
+
+  return out.size() - before;
+}
+
+void TelemetryDecoder::endLine(std::vector<Sample> &out) {
+  Sample sample;
+  if (parseLine((const char *)pending_ + line_start_, length_ - line_start_, sample)) {
+    // Whatever came before it on the same stretch was junk
+    if (line_start_ > 0 && !junk_counted_) stats_.badLines++;
+    out.push_back(sample);
+    stats_.lines++;
+    stats_.samples++;
+    length_ = 0;
+    line_start_ = 0;
+    junk_counted_ = false;
+    return;
+  }
+
+  if (length_ > line_start_ && pending_[line_start_] == '$') {
+    stats_.badLines++;
+    junk_counted_ = true;
+  }
+
+  // Might be a binary frame that happens to contain 0x0A
+  pending_[length_++] = '\n';
+  line_start_ = length_;
+}
+
+void TelemetryDecoder::endFrame(std::vector<Sample> &out) {
+  const size_t length = length_;
+  length_ = 0;
+  line_start_ = 0;
+  junk_counted_ = false;
+  if (length == 0) return;
+
+  if (!frame_.decode(pending_, length)) {
+    stats_.badFrames++;
+    return;
+  }
+
+  stats_.frames++;
+  if (have_sequence_) stats_.lostFrames += (uint8_t)(frame_.sequence() - next_sequence_);
+  have_sequence_ = true;
+  next_sequence_ = frame_.sequence() + 1;
+
+  for (uint8_t channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+    if (!frame_.has(channel)) continue;
+    Sample sample;
+    sample.timestamp = frame_.timestamp();
+    sample.channel = channel;
+    sample.value = frame_.raw(channel) / (double)TelemetryFrame::scale(channel);
+    out.push_back(sample);
+    stats_.samples++;
+  }
+}
+
+/**
+ * $XXXvalueTtime with an optional CR. The value is what Print::print(float)
+ * produces: an optional minus sign, digits and an optional fraction.
+ */
+bool TelemetryDecoder::parseLine(const char *line, size_t length, Sample &sample) const {
+  if (length > 0 && line[length - 1] == '\r') length--;
+  if (length < 7 || line[0] != '$') return false;
+
+  const int ch = channel(line + 1);
+  if (ch < 0) return false;
+
+  const char *p = line + 4;
+  const char *const end = line + length;
+
+  bool negative = false;
+  if (*p == '-') {
+    negative = true;
+    p++;
+  }
+
+  int64_t mantissa = 0;
+  int digits = 0;
+  int fraction = 0;
+  // A longer run of noise digits would overflow the mantissa
+  for (; p < end && isDigit(*p); p++, digits++) {
+    if (digits == MAX_DIGITS) return false;
+    mantissa = mantissa * 10 + (*p - '0');
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && isDigit(*p); p++, digits++, fraction++) {
+      if (digits == MAX_DIGITS) return false;
+      mantissa = mantissa * 10 + (*p - '0');
+    }
+  }
+  if (digits == 0 || p == end || *p != 'T') return false;
+
+  uint64_t timestamp = 0;
+  const char *const time_start = ++p;
+  for (; p < end && isDigit(*p); p++) {
+    timestamp = timestamp * 10 + (*p - '0');
+    if (timestamp > 0xFFFFFFFFull) return false;
+  }
+  if (p != end || p == time_start) return false;
+
+  const double value = mantissa / POWERS_OF_TEN[fraction];
+  sample.timestamp = (uint32_t)timestamp;
+  sample.channel = (uint8_t)ch;
+  sample.value = negative ? -value : value;
+  return true;
+}
+
+int TelemetryDecoder::channel(const char *code) {
+  for (uint8_t ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    if (memcmp(code, TelemetryFrame::code(ch), 3) == 0) return ch;
+  }
+  return -1;
+}
+
+}
@@ -0,0 +1,85 @@
+/****************************************************************************
+Ground station side of the radio link.
+
+Turns the byte stream received from the aircraft into timestamped samples.
+Both formats the sketch can send are understood, and may even be mixed in
+one capture:
+
+  text    $XXXvalueTtime lines, ending in LF or CRLF
+  binary  COBS encoded TelemetryFrame blocks, each ending in a zero byte
+
+The decoder is fed arbitrary chunks, so a frame or a line split across two
+reads is fine. Anything that does not parse (noise on the link, a frame
+with a bad CRC, a capture that starts mid-line) is counted and skipped, and
+decoding picks up again at the next line end or frame delimiter.
+****************************************************************************/
+
+#ifndef GS_TELEMETRY_DECODER_H
+#define GS_TELEMETRY_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "TelemetryFrame.h"
+
+namespace gs {
+
+struct Sample {
+  uint32_t timestamp;  // ms, the aircraft's millis()
+  uint8_t channel;     // TelemetryChannel
+  double value;        // SI units
+};
+
+class TelemetryDecoder {
+ public:
+  struct Stats {
+    uint64_t bytes;
+    uint64_t samples;
+    uint64_t lines;         // good text messages
+    uint64_t frames;        // good binary frames
+    uint64_t badLines;      // unknown code or malformed number
+    uint64_t badFrames;     // COBS, CRC or layout errors
+    uint64_t lostFrames;    // gaps in the frame sequence numbers
+    uint64_t overruns;      // junk longer than any message, dropped
+  };
+
+  TelemetryDecoder();
+
+  /** Forget any partial message and start counting from scratch. */
+  void reset();
+
+  /**
+   * Decode the next chunk of the stream.
+   * @return number of samples appended to out
+   */
+  size_t decode(const uint8_t *data, size_t length, std::vector<Sample> &out);
+
+  const Stats &stats() const { return stats_; }
+
+  /** Channel for a three letter type code, or -1 if there is none. */
+  static int channel(const char *code);
+
+ private:
+  // Longer than any text line or encoded frame
+  static const size_t PENDING_SIZE = 128;
+
+  void endLine(std::vector<Sample> &out);
+  void endFrame(std::vector<Sample> &out);
+  bool parseLine(const char *line, size_t length, Sample &sample) const;
+
+  uint8_t pending_[PENDING_SIZE];
+  size_t length_;
+  size_t line_start_;
+  bool junk_counted_;
+  bool discard_;
+  bool have_sequence_;
+  uint8_t next_sequence_;
+  TelemetryFrame frame_;
+  Stats stats_;
+};
+
+}
+
+#endif
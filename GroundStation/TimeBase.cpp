@@ -0,0 +1,41 @@
+#include "TimeBase.h"
+
+namespace gs {
+
+namespace {
+
+const double DAY_SECONDS = 86400.0;
+
+}
+
+TimeBase::TimeBase() {
+  reset();
+}
+
+void TimeBase::reset() {
+  valid_ = false;
+  local_ = 0;
+  utc_ = 0.0;
+  drift_ = 0.0;
+}
+
+void TimeBase::update(const Sample &sample) {
+  if (sample.channel == TELEMETRY_UTC) {
+    valid_ = true;
+    local_ = sample.timestamp;
+    utc_ = sample.value;
+  } else if (sample.channel == TELEMETRY_DRF) {
+    drift_ = sample.value;
+  }
+}
+
+double TimeBase::utc(uint32_t timestamp) const {
+  // Signed, so samples just before the record and a millis() wrap both work
+  const int32_t elapsed = (int32_t)(timestamp - local_);
+  double t = utc_ + elapsed / 1000.0 * (1.0 - drift_ * 1e-6);
+  if (t < 0.0) t += DAY_SECONDS;
+  if (t >= DAY_SECONDS) t -= DAY_SECONDS;
+  return t;
+}
+
+}
@@ -0,0 +1,47 @@
+/****************************************************************************
+Aircraft time to UTC.
+
+Every sample carries the aircraft's millis(). Once it has a GPS time
+solution the aircraft also sends a time sync record once a second: UTC at
+one of those timestamps, and how many ppm its clock runs fast or slow
+against UTC. Fed the decoded samples, TimeBase keeps the latest record and
+maps any timestamp to seconds into the UTC day from it, which lines the
+channels up to within a millisecond of each other and of other GPS timed
+data.
+****************************************************************************/
+
+#ifndef GS_TIME_BASE_H
+#define GS_TIME_BASE_H
+
+#include <stdint.h>
+
+#include "TelemetryDecoder.h"
+
+namespace gs {
+
+class TimeBase {
+ public:
+  TimeBase();
+
+  /** Forget the sync record, e.g. at the start of another capture. */
+  void reset();
+
+  /** Take the sync record from a sample; anything else is ignored. */
+  void update(const Sample &sample);
+
+  /** True once a UTC record has been seen. */
+  bool valid() const { return valid_; }
+
+  /** Seconds into the UTC day at the aircraft timestamp, in ms. */
+  double utc(uint32_t timestamp) const;
+
+ private:
+  bool valid_;
+  uint32_t local_;  // timestamp of the last UTC record, ms
+  double utc_;      // its UTC, seconds into the day
+  double drift_;    // ppm the aircraft clock runs fast
+};
+
+}
+
+#endif
@@ -0,0 +1,243 @@
+/****************************************************************************
+Converts a telemetry capture, or the live stream from the radio, to CSV.
+
+Reads a capture file, a serial device (set to raw mode at the given baud
+rate) or standard input, in either radio format, and writes one row per
+sample:
+
+  time_ms,channel,value
+  5861,AQW,-0.707214
+
+With -u each row also gets the sample's time in seconds into the UTC day,
+from the aircraft's time sync records. It stays empty until the first
+record, which the aircraft sends once it has a GPS time solution:
+
+  time_ms,utc_s,channel,value
+  65861,50437.1285,AQW,-0.707214
+
+Usage: telemetry-csv [-b baud] [-o out.csv] [-s] [-u] [input]
+****************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "TelemetryDecoder.h"
+#include "TimeBase.h"
+
+static const size_t READ_SIZE = 1 << 16;
+
+// Longest row formatRow() writes
+static const size_t ROW_MAX = 64;
+
+/**
+ * One CSV row. Hand formatted because printf() is most of the run time on
+ * large captures: six decimals (seven for positions, which is what a
+ * binary frame resolves), trailing zeros dropped.
+ */
+static size_t formatRow(char *row, const gs::Sample &s, const gs::TimeBase *time_base) {
+  char *p = row;
+  char digits[24];
+  int n;
+
+  // Timestamp
+  uint32_t t = s.timestamp;
+  n = 0;
+  do {
+    digits[n++] = '0' + t % 10;
+    t /= 10;
+  } while (t);
+  while (n) *p++ = digits[--n];
+  *p++ = ',';
+
+  // UTC, to 0.1 ms like the sync record
+  if (time_base) {
+    if (time_base->valid()) {
+      uint32_t u = (uint32_t)(time_base->utc(s.timestamp) * 1e4 + 0.5);
+      n = 0;
+      for (int i = 0; i < 4; i++) {
+        digits[n++] = '0' + u % 10;
+        u /= 10;
+      }
+      digits[n++] = '.';
+      do {
+        digits[n++] = '0' + u % 10;
+        u /= 10;
+      } while (u);
+      while (n) *p++ = digits[--n];
+    }
+    *p++ = ',';
+  }
+
+  memcpy(p, TelemetryFrame::code(s.channel), 3);
+  p += 3;
+  *p++ = ',';
+
+  // Value in fixed point; anything too large for that goes through printf
+  const int decimals = s.channel == TELEMETRY_LAT || s.channel == TELEMETRY_LON ? 7 : 6;
+  const double scaled = s.value * (decimals == 7 ? 1e7 : 1e6);
+  if (!(scaled > -9e15 && scaled < 9e15)) {
+    p += snprintf(p, ROW_MAX - (p - row) - 1, "%g", s.value);
+    *p++ = '\n';
+    return p - row;
+  }
+
+  int64_t v = (int64_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+  if (v < 0) {
+    *p++ = '-';
+    v = -v;
+  }
+  n = 0;
+  for (int i = 0; i < decimals; i++) {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  }
+  int keep = 0;
+  while (keep < decimals && digits[keep] == '0') keep++;
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (n > decimals) *p++ = digits[--n];
+  if (keep < decimals) {
+    *p++ = '.';
+    while (n > keep) *p++ = digits[--n];
+  }
+  *p++ = '\n';
+  return p - row;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s [-b baud] [-o out.csv] [-s] [-u] [input]\n", name);
+  exit(2);
+}
+
+static speed_t baudConstant(long baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default: return 0;
+  }
+}
+
+static bool setRaw(int fd, long baud) {
+  const speed_t speed = baudConstant(baud);
+  struct termios tio;
+  if (!speed || tcgetattr(fd, &tio) != 0) return false;
+  cfmakeraw(&tio);
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+static double seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  long baud = 38400;
+  const char *output_path = 0;
+  bool show_stats = false;
+  bool show_utc = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "b:o:suh")) != -1) {
+    switch (opt) {
+      case 'b': baud = atol(optarg); break;
+      case 'o': output_path = optarg; break;
+      case 's': show_stats = true; break;
+      case 'u': show_utc = true; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (argc - optind > 1) usage(argv[0]);
+
+  int fd = STDIN_FILENO;
+  if (optind < argc && strcmp(argv[optind], "-") != 0) {
+    fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+      perror(argv[optind]);
+      return 1;
+    }
+  }
+
+  const bool live = isatty(fd);
+  if (live && !setRaw(fd, baud)) {
+    fprintf(stderr, "cannot set %ld baud raw mode on the input\n", baud);
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (output_path && strcmp(output_path, "-") != 0) {
+    out = fopen(output_path, "w");
+    if (!out) {
+      perror(output_path);
+      return 1;
+    }
+  }
+
+  gs::TelemetryDecoder decoder;
+  gs::TimeBase time_base;
+  std::vector<gs::Sample> samples;
+  std::vector<uint8_t> buffer(READ_SIZE);
+  std::vector<char> text;
+  double decoding = 0.0;
+  const double start = seconds();
+
+  fprintf(out, show_utc ? "time_ms,utc_s,channel,value\n" : "time_ms,channel,value\n");
+  for (;;) {
+    const ssize_t n = read(fd, &buffer[0], buffer.size());
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      perror("read");
+      return 1;
+    }
+    if (n == 0) break;
+
+    const double before = seconds();
+    samples.clear();
+    decoder.decode(&buffer[0], n, samples);
+    decoding += seconds() - before;
+
+    text.resize(samples.size() * ROW_MAX);
+    size_t length = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+      if (show_utc) time_base.update(samples[i]);
+      length += formatRow(&text[length], samples[i], show_utc ? &time_base : 0);
+    }
+    if (length) fwrite(&text[0], 1, length, out);
+    if (live) fflush(out);
+  }
+
+  if (out != stdout) fclose(out);
+
+  if (show_stats) {
+    const gs::TelemetryDecoder::Stats &st = decoder.stats();
+    const double elapsed = seconds() - start;
+    fprintf(stderr, "Bytes                %llu, %.1f MB/s decoding, %.1f MB/s overall\n",
+            (unsigned long long)st.bytes, st.bytes / 1e6 / decoding,
+            st.bytes / 1e6 / elapsed);
+    fprintf(stderr, "Samples              %llu\n", (unsigned long long)st.samples);
+    fprintf(stderr, "Text messages        %llu good, %llu bad\n",
+            (unsigned long long)st.lines, (unsigned long long)st.badLines);
+    fprintf(stderr, "Binary frames        %llu good, %llu bad, %llu lost\n",
+            (unsigned long long)st.frames, (unsigned long long)st.badFrames,
+            (unsigned long long)st.lostFrames);
+    fprintf(stderr, "Overruns             %llu\n", (unsigned long long)st.overruns);
+  }
+
+  return 0;
+}
@@ -0,0 +1,238 @@
+/****************************************************************************
+Altitude filter check.
+
+Replays the reference flight as the sketch sees it: DMP packets at 50 Hz,
+their acceleration and quaternion run through the same MotionApps calls to
+get the vertical acceleration, and BMP085 pressure conversions back to
+back, each handed over at the end of the conversion but stamped with its
+middle. Sensor noise is that of the device models, plus some airframe
+vibration on the accelerometer.
+
+The climb rate from AltitudeFilter is compared with the truth, and so are
+the two ways of getting it from the barometer alone: differencing
+successive altitudes, and the same through a one second low-pass filter.
+For each the RMS error and the delay that best lines it up with the truth
+are reported. A second run adds a bias to the accelerometer, which the
+filter has to learn.
+
+Usage: altitude-filter-bench
+****************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "Adafruit_BMP085.h"
+#include "AltitudeFilter.h"
+#include "MPU6050_9Axis_MotionApps41.h"
+#include "SimFlight.h"
+
+using namespace sim;
+
+// Replayed span; the first SETTLE_MICROS after takeoff are not scored
+static const uint64_t START_MICROS = 20000000ull;
+static const uint64_t RUN_MICROS = 240000000ull;
+static const uint64_t SETTLE_MICROS = 10000000ull;
+
+static const uint64_t DMP_PERIOD = 20000;
+static const uint64_t CONVERSION_MICROS = 26000;  // ultra high resolution
+static const uint64_t CONVERSION_GAP = 1500;      // loop latency to the next start
+static const double ACCEL_LSB = 4096.0;           // DMP packet, per g
+static const double PRESSURE_NOISE = 3.0;         // Pa, as the BMP085 model
+static const double VIBRATION = 0.05;             // g, on every axis
+static const double LOW_PASS_TAU = 1.0;           // s
+
+// Largest delay searched for, in DMP periods
+static const int MAX_SHIFT = 100;
+
+struct Series {
+  const char *name;
+  std::vector<double> climb;
+};
+
+struct Run {
+  Series filter, difference, lowPass;
+  std::vector<double> truth;
+  double altitudeRms;      // filter
+  double baroRms;          // barometer alone
+  double bias;             // as learnt
+  double trueBias;         // vertical part of the one added
+};
+
+// Specific force in g, body frame, as the MPU-9150 model has it
+static void specificForce(const FlightState &s, double body[3]) {
+  const double psi = s.course * M_PI / 180.0;
+  const double turn = s.groundSpeed * s.yawRate;
+  double world[3];
+  world[0] = -turn * sin(psi);
+  world[1] = -turn * cos(psi);
+  world[2] = s.verticalAccel + GRAVITY;
+  toBody(s, world, body);
+  for (int i = 0; i < 3; i++) body[i] /= GRAVITY;
+}
+
+/**
+ * Vertical acceleration in m/s^2 from one DMP packet's worth of data, the
+ * way the sketch gets it
+ */
+static float verticalAccel(MPU6050 &mpu, const FlightState &s, uint64_t n, double bias) {
+  double force[3];
+  specificForce(s, force);
+  force[2] += bias / GRAVITY;
+
+  VectorInt16 accel;
+  accel.x = (int16_t)lround((force[0] + VIBRATION * noise(40, n)) * ACCEL_LSB);
+  accel.y = (int16_t)lround((force[1] + VIBRATION * noise(41, n)) * ACCEL_LSB);
+  accel.z = (int16_t)lround((force[2] + VIBRATION * noise(42, n)) * ACCEL_LSB);
+  Quaternion q((float)(s.qw + 0.0005 * noise(20, n)), (float)(s.qx + 0.0005 * noise(21, n)),
+               (float)(s.qy + 0.0005 * noise(22, n)), (float)(s.qz + 0.0005 * noise(23, n)));
+  q.normalize();
+
+  VectorFloat gravity;
+  VectorInt16 linear, world;
+  mpu.dmpGetGravity(&gravity, &q);
+  mpu.dmpGetLinearAccel(&linear, &accel, &gravity);
+  mpu.dmpGetLinearAccelInWorld(&world, &linear, &q);
+  return world.z * (float)(GRAVITY / ACCEL_LSB);
+}
+
+static Run replay(double bias) {
+  MPU6050 mpu;
+  AltitudeFilter filter;
+  Run run;
+  run.filter.name = "Kalman filter";
+  run.difference.name = "Difference";
+  run.lowPass.name = "Low-pass";
+
+  const float ground = (float)flight(0).pressure;
+  uint64_t next_packet = START_MICROS;
+  uint64_t conversion_start = START_MICROS;
+  uint64_t packets = 0, conversions = 0;
+  double previous_altitude = 0.0, previous_time = 0.0;
+  double difference = 0.0, low_pass = 0.0;
+  double altitude_error = 0.0, baro_error = 0.0;
+  uint32_t scored = 0, baro_scored = 0;
+
+  while (next_packet < START_MICROS + RUN_MICROS) {
+    const uint64_t conversion_end = conversion_start + CONVERSION_MICROS;
+
+    // Whichever comes first, as the loop would see them
+    if (conversion_end < next_packet) {
+      const uint64_t middle = conversion_start + CONVERSION_MICROS / 2;
+      const FlightState s = flight(middle);
+      const int32_t pressure = (int32_t)lround(s.pressure + PRESSURE_NOISE * noise(2, conversions));
+      const float altitude = Adafruit_BMP085::pressureToAltitude(pressure, ground);
+      filter.addAltitude(altitude, (uint32_t)middle);
+      if (middle >= START_MICROS + SETTLE_MICROS) {
+        baro_error += (altitude - s.altitude) * (altitude - s.altitude);
+        baro_scored++;
+      }
+
+      const double t = middle / 1e6;
+      if (conversions > 0) {
+        difference = (altitude - previous_altitude) / (t - previous_time);
+        low_pass += (difference - low_pass) * (1.0 - exp(-(t - previous_time) / LOW_PASS_TAU));
+      }
+      previous_altitude = altitude;
+      previous_time = t;
+      conversions++;
+      conversion_start = conversion_end + CONVERSION_GAP;
+      continue;
+    }
+
+    const FlightState s = flight(next_packet);
+    filter.addAccel(verticalAccel(mpu, s, packets, bias), (uint32_t)next_packet);
+    if (next_packet >= START_MICROS + SETTLE_MICROS && filter.started()) {
+      run.truth.push_back(s.climb);
+      run.filter.climb.push_back(filter.climb());
+      run.difference.climb.push_back(difference);
+      run.lowPass.climb.push_back(low_pass);
+      altitude_error += (filter.altitude() - s.altitude) * (filter.altitude() - s.altitude);
+      scored++;
+    }
+    packets++;
+    next_packet += DMP_PERIOD;
+  }
+
+  // The bias as seen vertically, at the end of the run
+  const FlightState end = flight(next_packet);
+  double world[3] = { 0.0, 0.0, 1.0 }, body[3];
+  toBody(end, world, body);
+  run.altitudeRms = sqrt(altitude_error / scored);
+  run.baroRms = sqrt(baro_error / baro_scored);
+  run.bias = filter.accelBias();
+  run.trueBias = bias * body[2];
+  return run;
+}
+
+/**
+ * RMS error against the truth at the delay that makes it smallest.
+ * @return the RMS error at that delay
+ */
+static double bestDelay(const Series &series, const std::vector<double> &truth, int *shift) {
+  double best = 1e9;
+  *shift = 0;
+  for (int k = 0; k <= MAX_SHIFT; k++) {
+    double sum = 0.0;
+    size_t n = 0;
+    for (size_t i = k; i < truth.size(); i++) {
+      const double e = series.climb[i] - truth[i - k];
+      sum += e * e;
+      n++;
+    }
+    const double rms = sqrt(sum / n);
+    if (rms < best) {
+      best = rms;
+      *shift = k;
+    }
+  }
+  return best;
+}
+
+static double rms(const Series &series, const std::vector<double> &truth) {
+  double sum = 0.0;
+  for (size_t i = 0; i < truth.size(); i++) {
+    const double e = series.climb[i] - truth[i];
+    sum += e * e;
+  }
+  return sqrt(sum / truth.size());
+}
+
+static void print(const Series &series, const std::vector<double> &truth, double *error,
+                  int *shift) {
+  *error = rms(series, truth);
+  const double aligned = bestDelay(series, truth, shift);
+  printf("  %-18s climb %.3f m/s RMS, delay %d ms (%.3f m/s RMS aligned)\n",
+         series.name, *error, *shift * (int)(DMP_PERIOD / 1000), aligned);
+}
+
+static bool check(const char *name, double bias) {
+  const Run run = replay(bias);
+  double filter_error, difference_error, low_pass_error;
+  int filter_shift, difference_shift, low_pass_shift;
+
+  printf("%s\n", name);
+  print(run.filter, run.truth, &filter_error, &filter_shift);
+  print(run.difference, run.truth, &difference_error, &difference_shift);
+  print(run.lowPass, run.truth, &low_pass_error, &low_pass_shift);
+
+  // Better than either, with no more than a sample of delay, no worse on
+  // altitude than the barometer, and the bias learnt to a few hundredths
+  // of a m/s^2
+  const bool ok = filter_error < 0.25 && filter_error < low_pass_error &&
+                  filter_error < difference_error && filter_shift <= 1 &&
+                  run.altitudeRms <= run.baroRms && fabs(run.bias - run.trueBias) < 0.05;
+  printf("  %-18s altitude %.3f m RMS (barometer %.3f), bias %.3f m/s^2 (%.3f)%s\n",
+         "", run.altitudeRms, run.baroRms, run.bias, run.trueBias, ok ? "" : "  FAILED");
+  return ok;
+}
+
+int main() {
+  int failures = 0;
+
+  if (!check("Reference flight", 0.0)) failures++;
+  if (!check("Accelerometer bias", 0.3)) failures++;
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+/****************************************************************************
+DMP warm restart check.
+
+Sets up the simulated MPU-9150 from scratch the way the sketch does, then
+takes it over with dmpResume() as the sketch does after a reset of the
+Teensy alone, with the MPU still running: the DMP has to be taken over in a
+few ms instead of reloaded, and packets have to keep coming in whole from
+the reset FIFO. Also checks that dmpResume() refuses an MPU that has just
+powered up, one with a config register changed, one with different DMP
+code and one that has been reset.
+
+Usage: dmp-resume-bench
+****************************************************************************/
+
+#include <stdio.h>
+
+#include "SimAk8975.h"
+#include "SimMpu9150.h"
+#include "MPU6050_9Axis_MotionApps41.h"
+
+using namespace sim;
+
+// Time from power on to the first access, as in the sketch
+static const uint64_t STARTUP_MICROS = 100000;
+
+// Bus time and transactions of one step
+struct Cost {
+  uint64_t start;
+  uint32_t transactions;
+
+  void begin() {
+    start = now();
+    transactions = i2c.stats().transactions;
+  }
+  double millis() const { return (now() - start) / 1e3; }
+  uint32_t count() const { return i2c.stats().transactions - transactions; }
+};
+
+static bool report(const char *name, bool ok, const char *detail) {
+  printf("%-20s %s%s\n", name, detail, ok ? "" : "  FAILED");
+  return ok;
+}
+
+static bool checkRefused(const char *name, const char *detail) {
+  MPU6050 mpu;
+  return report(name, !mpu.dmpResume(), detail);
+}
+
+int main() {
+  Mpu9150 device;
+  Ak8975 mag(device);
+  int failures = 0;
+  char detail[96];
+
+  advance(STARTUP_MICROS);
+  if (!checkRefused("Power on", "refused, not set up")) failures++;
+
+  // The full setup
+  MPU6050 cold;
+  Cost coldCost;
+  coldCost.begin();
+  cold.initialize();
+  bool ok = cold.dmpInitialize() == 0;
+  cold.setDMPEnabled(true);
+  const double coldMillis = coldCost.millis();
+  const uint32_t coldTransactions = coldCost.count();
+  snprintf(detail, sizeof(detail), "loaded in %.1f ms, %u transactions",
+           coldMillis, coldTransactions);
+  if (!report("Cold start", ok, detail)) failures++;
+
+  // The DMP runs on while the MCU resets and comes back with a new object
+  advance(100000);
+  MPU6050 warm;
+  Cost warmCost;
+  warmCost.begin();
+  ok = warm.dmpResume() && warm.dmpGetFIFOPacketSize() == Mpu9150::DMP_PACKET_SIZE;
+  const double warmMillis = warmCost.millis();
+  const uint32_t warmTransactions = warmCost.count();
+  snprintf(detail, sizeof(detail), "resumed in %.1f ms, %u transactions (%.0fx faster)",
+           warmMillis, warmTransactions, coldMillis / warmMillis);
+  if (!report("Warm restart", ok, detail)) failures++;
+
+  // Whole packets from the top of the FIFO on
+  const uint32_t packets = device.dmpPackets;
+  advance(100000);
+  const uint16_t count = warm.getFIFOCount();
+  ok = device.dmpPackets > packets && count > 0 && count % Mpu9150::DMP_PACKET_SIZE == 0;
+  snprintf(detail, sizeof(detail), "%u packets in the next 100 ms, %u bytes in the FIFO",
+           device.dmpPackets - packets, count);
+  if (!report("FIFO after resume", ok, detail)) failures++;
+
+  // A config register differs
+  I2Cdev::writeByte(Mpu9150::ADDRESS, MPU6050_RA_SMPLRT_DIV, 9);
+  if (!checkRefused("Config changed", "refused, sample rate divider 9")) failures++;
+  I2Cdev::writeByte(Mpu9150::ADDRESS, MPU6050_RA_SMPLRT_DIV, 4);
+
+  // Different firmware, one byte out in a signature window
+  uint8_t code, other;
+  warm.readMemoryBlock(&code, 1, 5, 7);
+  other = (uint8_t)~code;
+  warm.writeMemoryBlock(&other, 1, 5, 7, false);
+  if (!checkRefused("Other firmware", "refused, bank 5 byte 7 differs")) failures++;
+  warm.writeMemoryBlock(&code, 1, 5, 7, false);
+
+  // Put back as it was, it is taken over again
+  MPU6050 again;
+  if (!report("Restored", again.dmpResume(), "resumed")) failures++;
+
+  // Device reset, as after a power cycle
+  warm.reset();
+  advance(STARTUP_MICROS);
+  if (!checkRefused("Device reset", "refused, DMP lost")) failures++;
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+/****************************************************************************
+TelemetryFormat benchmark.
+
+Checks formatFloat() against Print::print(float, digits), the code it
+replaces in the text telemetry path, and against the exactly rounded
+value, then checks formatFixed() against long double printf(). Finally
+times the three ways of writing a telemetry field.
+
+Where formatFloat() and Print disagree it is in the last digit of values
+within rounding error of a tie; the report counts how often each of them
+is the correctly rounded one. Timings are host timings and only show the
+relative cost; on the Teensy 3.0 printFloat()'s double arithmetic runs in
+software and the gap is wider.
+
+Usage: format-bench
+****************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Print.h"
+#include "TelemetryFormat.h"
+
+// Collects what Print writes
+class BufferPrint : public Print {
+ public:
+  BufferPrint() : length_(0) { text_[0] = '\0'; }
+
+  size_t write(uint8_t c) {
+    if (length_ + 1 < sizeof(text_)) {
+      text_[length_++] = c;
+      text_[length_] = '\0';
+    }
+    return 1;
+  }
+
+  void clear() {
+    length_ = 0;
+    text_[0] = '\0';
+  }
+  const char *text() const { return text_; }
+
+ private:
+  char text_[64];
+  size_t length_;
+};
+
+// Fields as the sketch sends them: value range and decimals
+struct Field {
+  const char *name;
+  float min;
+  float max;
+  uint8_t digits;
+};
+
+static const Field FIELDS[] = {
+  { "quaternion", -1.0f, 1.0f, 6 },
+  { "altitude", -50.0f, 3000.0f, 6 },
+  { "speed", 0.0f, 60.0f, 6 },
+  { "position", -180.0f, 180.0f, 6 },
+  { "power", 0.0f, 100.0f, 3 },
+  { "heading", 0.0f, 360.0f, 2 },
+  { "temperature", -40.0f, 85.0f, 4 },
+  { "wide", -1e6f, 1e6f, 2 }
+};
+static const int FIELD_COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+static double seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift32, so runs are repeatable
+static uint32_t state = 2463534242u;
+static uint32_t random32() {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static float randomFloat(float min, float max) {
+  return min + (max - min) * (random32() / 4294967296.0f);
+}
+
+/**
+ * True if text is value rounded to nearest at digits decimals. Ties, which
+ * a float can only be exactly at a few digits, may go either way.
+ */
+static bool correctlyRounded(const char *text, float value, uint8_t digits) {
+  const long double scale = powl(10.0L, digits);
+  const long double exact = fabsl((long double)value) * scale;
+  const long double printed = fabsl(strtold(text, 0)) * scale;
+  return fabsl(printed - exact) <= 0.5L + 1e-9L * scale;
+}
+
+// Keeps the timed loops from being optimised away
+static volatile uint32_t sink;
+
+int main() {
+  int failures = 0;
+  BufferPrint print;
+  char fast[TELEMETRY_NUMBER_MAX];
+
+  // Special values
+  const float specials[] = { NAN, INFINITY, -INFINITY, 5e9f, -5e9f, -0.0f, -1e-9f,
+                             0.0f, 0.5f, 1.999f, 4294967040.0f };
+  uint32_t special_mismatches = 0;
+  for (size_t i = 0; i < sizeof(specials) / sizeof(specials[0]); i++) {
+    for (uint8_t digits = 0; digits <= 4; digits += 2) {
+      print.clear();
+      print.print(specials[i], digits);
+      TelemetryFormat::formatFloat(fast, specials[i], digits);
+      if (strcmp(fast, print.text()) != 0 && special_mismatches++ < 5) {
+        printf("  %g, %u digits: \"%s\", Print \"%s\"\n",
+               specials[i], digits, fast, print.text());
+      }
+    }
+  }
+  printf("Special values       %u mismatches\n", special_mismatches);
+  if (special_mismatches) failures++;
+
+  // Random values in each field's range
+  const int CASES = 200000;
+  uint32_t total = 0, differ = 0, fast_wrong = 0, print_wrong = 0;
+  for (int f = 0; f < FIELD_COUNT; f++) {
+    const Field &field = FIELDS[f];
+    uint32_t field_differ = 0;
+    for (int i = 0; i < CASES; i++) {
+      const float value = randomFloat(field.min, field.max);
+      print.clear();
+      print.print(value, field.digits);
+      const uint8_t n = TelemetryFormat::formatFloat(fast, value, field.digits);
+      total++;
+
+      if (n != strlen(fast)) fast_wrong++;
+      if (!correctlyRounded(fast, value, field.digits)) {
+        if (fast_wrong++ < 5)
+          printf("  %.9g, %u digits: \"%s\" is not rounded to nearest\n",
+                 value, field.digits, fast);
+      }
+      if (strcmp(fast, print.text()) != 0) {
+        differ++;
+        field_differ++;
+        if (!correctlyRounded(print.text(), value, field.digits)) print_wrong++;
+      }
+    }
+    printf("  %-12s %d values, %u digits, %u differ from Print\n",
+           field.name, CASES, field.digits, field_differ);
+  }
+  printf("formatFloat          %u values, %u differ from Print, %u of them "
+         "misrounded by Print, %u by formatFloat\n",
+         total, differ, print_wrong, fast_wrong);
+  if (fast_wrong) failures++;
+
+  // Fixed point against long double
+  uint32_t fixed_cases = 0, fixed_wrong = 0;
+  char expected[64];
+  for (int i = 0; i < 1000000; i++) {
+    const int32_t value = i < 16 ? (i & 1 ? INT32_MIN : INT32_MAX) - (i >> 1)
+                                 : (int32_t)random32() >> (random32() % 31);
+    const uint8_t decimals = i % (TELEMETRY_DECIMALS_MAX + 1);
+    TelemetryFormat::formatFixed(fast, value, decimals);
+    snprintf(expected, sizeof(expected), "%.*Lf",
+             decimals, (long double)value / powl(10.0L, decimals));
+    fixed_cases++;
+    if (strcmp(fast, expected) != 0 && fixed_wrong++ < 5) {
+      printf("  %d, %u decimals: \"%s\", expected \"%s\"\n", value, decimals, fast, expected);
+    }
+  }
+  printf("formatFixed          %u values, %u mismatches\n", fixed_cases, fixed_wrong);
+  if (fixed_wrong) failures++;
+
+  // Timing, on a position field with six decimals
+  const int ROUNDS = 2000000;
+  double t0 = seconds();
+  for (int i = 0; i < ROUNDS; i++) {
+    print.clear();
+    print.print(-83.249560f + i * 1e-6f, 6);
+    sink = print.text()[3];
+  }
+  double t1 = seconds();
+  for (int i = 0; i < ROUNDS; i++) {
+    TelemetryFormat::formatFloat(fast, -83.249560f + i * 1e-6f, 6);
+    sink = fast[3];
+  }
+  double t2 = seconds();
+  for (int i = 0; i < ROUNDS; i++) {
+    TelemetryFormat::formatFixed(fast, -83249560 + i, 6);
+    sink = fast[3];
+  }
+  double t3 = seconds();
+  printf("Position field       Print %.1f ns, formatFloat %.1f ns, formatFixed %.1f ns\n",
+         (t1 - t0) / ROUNDS * 1e9, (t2 - t1) / ROUNDS * 1e9, (t3 - t2) / ROUNDS * 1e9);
+
+  return failures ? 1 : 0;
+}
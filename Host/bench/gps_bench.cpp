@@ -0,0 +1,308 @@
+/****************************************************************************
+TinyGPS bulk encode benchmark.
+
+Feeds one NEO-6M log through encode(char), a character at a time as the
+sketch used to, and through encode(const char *, size_t) in buffers of
+random size, and checks that both end up with the same sentence counts,
+statistics and fix. A second pass does the same with line noise mixed in,
+so failed checksums, truncated terms and stray '$'s are covered. Finally
+times both on the clean log.
+
+Then checks the sentence table: the log rewritten with the GN talker of a
+multi-constellation receiver has to decode to the same fix, and a few VTG,
+GSA and GST sentences to the values they carry. And that a UBX message
+with a corrupted length is dropped as soon as the length is in, so the
+message after it still decodes.
+
+The log is recorded from the simulated receiver flying the reference
+flight, or read from the file given, e.g. a capture of a real NEO-6M taken
+with any serial terminal. Timings are host timings and only show the
+relative cost.
+
+Usage: gps-bench [nmea.log]
+****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+
+#include "SimGps.h"
+#include "SimUart.h"
+#include "TinyGPS.h"
+#include "UbxGps.h"
+
+// Simulated receiver output to record, about 500 bytes per second
+static const uint64_t RECORD_MICROS = 600000000ull;
+
+static double seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift32, so runs are repeatable
+static uint32_t state = 2463534242u;
+static uint32_t random32() {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// The models stay registered with the clock, which TinyGPS still moves on
+// through millis(), so they live as long as the program
+static std::string recordLog() {
+  static sim::Uart port("GPS", 0, 1 << 24);
+  static sim::NeoGps gps(port);
+  port.begin(9600);
+  sim::advance(RECORD_MICROS);
+  port.end();
+
+  std::string log;
+  while (port.available()) log += (char)port.read();
+  return log;
+}
+
+static bool readLog(const char *path, std::string &log) {
+  FILE *in = fopen(path, "rb");
+  if (!in) {
+    perror(path);
+    return false;
+  }
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) log.append(buffer, n);
+  fclose(in);
+  return true;
+}
+
+struct Result {
+  int sentences;
+  unsigned long chars;
+  unsigned short good;
+  unsigned short failed;
+  long latitude, longitude, altitude;
+  unsigned long speed, course, date, time;
+};
+
+static Result result(TinyGPS &gps, int sentences) {
+  Result r;
+  r.sentences = sentences;
+  gps.stats(&r.chars, &r.good, &r.failed);
+  gps.get_position(&r.latitude, &r.longitude);
+  gps.get_datetime(&r.date, &r.time);
+  r.altitude = gps.altitude();
+  r.speed = gps.speed();
+  r.course = gps.course();
+  return r;
+}
+
+static bool operator==(const Result &a, const Result &b) {
+  return a.sentences == b.sentences && a.chars == b.chars && a.good == b.good &&
+         a.failed == b.failed && a.latitude == b.latitude &&
+         a.longitude == b.longitude && a.altitude == b.altitude &&
+         a.speed == b.speed && a.course == b.course && a.date == b.date &&
+         a.time == b.time;
+}
+
+static void print(const char *name, const Result &r) {
+  printf("  %-6s %d sentences, %lu chars, %u good, %u failed, %ld %ld %ld, "
+         "%lu %lu, %06lu %08lu\n",
+         name, r.sentences, r.chars, r.good, r.failed, r.latitude, r.longitude,
+         r.altitude, r.speed, r.course, r.date, r.time);
+}
+
+/**
+ * Runs the log through both entry points and compares. Bulk sentence
+ * counts are also checked buffer by buffer.
+ */
+static bool compare(const char *name, const std::string &log) {
+  TinyGPS single, bulk;
+  int single_sentences = 0, bulk_sentences = 0, chunk_mismatches = 0;
+
+  size_t i = 0;
+  while (i < log.size()) {
+    size_t n = 1 + random32() % 64;
+    if (n > log.size() - i) n = log.size() - i;
+
+    int expected = 0;
+    for (size_t j = i; j < i + n; j++) {
+      if (single.encode(log[j])) expected++;
+    }
+    const int got = bulk.encode(log.data() + i, n);
+    if (got != expected) chunk_mismatches++;
+    single_sentences += expected;
+    bulk_sentences += got;
+    i += n;
+  }
+
+  const Result a = result(single, single_sentences);
+  const Result b = result(bulk, bulk_sentences);
+  const bool same = a == b && chunk_mismatches == 0;
+  printf("%-20s %zu bytes, %d sentences, %u failed checksums, %s\n",
+         name, log.size(), a.sentences, a.failed, same ? "match" : "MISMATCH");
+  if (!same) {
+    printf("  %d buffers disagree\n", chunk_mismatches);
+    print("char", a);
+    print("bulk", b);
+  }
+  return same;
+}
+
+// Body wrapped in $ and *checksum
+static std::string sentence(const std::string &body) {
+  uint8_t checksum = 0;
+  char tail[8];
+  for (size_t i = 0; i < body.size(); i++) checksum ^= (uint8_t)body[i];
+  snprintf(tail, sizeof(tail), "*%02X\r\n", checksum);
+  return "$" + body + tail;
+}
+
+// Every sentence of a log again, from another talker
+static std::string retalk(const std::string &log, const char *talker) {
+  std::string out;
+  size_t i = 0;
+  while ((i = log.find('$', i)) != std::string::npos) {
+    const size_t star = log.find('*', i);
+    if (star == std::string::npos) break;
+    out += sentence(talker + log.substr(i + 3, star - i - 3));
+    i = star;
+  }
+  return out;
+}
+
+static bool expect(const char *name, unsigned long got, unsigned long expected) {
+  if (got == expected) return true;
+  printf("  %s %lu, expected %lu\n", name, got, expected);
+  return false;
+}
+
+static bool checkSentences() {
+  TinyGPS gps;
+  std::string text = sentence("GNVTG,81.20,T,,M,41.234,N,76.365,K,A") +
+                     sentence("GNGSA,A,3,04,05,09,12,24,25,29,31,,,,,1.85,1.01,1.55") +
+                     sentence("GPGST,143005.00,2.3,1.6,1.1,45.0,1.2,1.4,2.9") +
+                     sentence("GPVTG,,,,,,,,,N") +
+                     sentence("PUBX,00,143005.00");
+  const int sentences = gps.encode(text.data(), text.size());
+  bool ok = expect("sentences", sentences, 3);
+  ok = expect("speed", gps.speed(), 4123) && ok;
+  ok = expect("course", gps.course(), 8120) && ok;
+  ok = expect("fix type", gps.fix_type(), TinyGPS::GPS_FIX_3D) && ok;
+  ok = expect("PDOP", gps.pdop(), 185) && ok;
+  ok = expect("HDOP", gps.hdop(), 101) && ok;
+  ok = expect("VDOP", gps.vdop(), 155) && ok;
+  ok = expect("latitude error", gps.lat_error(), 120) && ok;
+  ok = expect("longitude error", gps.lon_error(), 140) && ok;
+  ok = expect("altitude error", gps.alt_error(), 290) && ok;
+  printf("VTG, GSA, GST        %s\n", ok ? "match" : "MISMATCH");
+  return ok;
+}
+
+// NAV-POSLLH at a time of week, little endian
+static size_t positionMessage(uint8_t *out, uint32_t tow) {
+  const int32_t fields[7] = { (int32_t)tow, -833961230, 424859630, 250000, 215000, 2500, 3800 };
+  uint8_t payload[28];
+  for (int i = 0; i < 28; i++) payload[i] = (uint8_t)(fields[i / 4] >> (8 * (i % 4)));
+  return UbxGps::frame(out, UBX_NAV, UBX_NAV_POSLLH, payload, sizeof(payload));
+}
+
+static bool checkUbxLength() {
+  uint8_t stream[2 * (28 + UBX_OVERHEAD)];
+  size_t n = positionMessage(stream, 1000);
+  stream[5] = 0x40;  // length high byte, 16412 bytes
+  n += positionMessage(stream + n, 2000);
+
+  UbxGps ubx;
+  const int messages = ubx.encode(stream, n);
+  bool ok = expect("messages", messages, 1);
+  ok = expect("bad lengths", ubx.stats().badLength, 1) && ok;
+  ok = expect("failed checksums", ubx.stats().failedChecksum, 0) && ok;
+  ok = expect("time of week", ubx.position().tow, 2000) && ok;
+  ok = expect("latitude", ubx.position().latitude, 424859630) && ok;
+  printf("UBX bad length       %s\n", ok ? "resynced, next message decoded" : "MISMATCH");
+  return ok;
+}
+
+// Keeps the timed loops from being optimised away
+static volatile int sink;
+
+int main(int argc, char **argv) {
+  int failures = 0;
+  std::string log;
+
+  if (argc > 1) {
+    if (!readLog(argv[1], log)) return 1;
+  } else {
+    log = recordLog();
+  }
+  if (log.empty()) {
+    printf("empty log\n");
+    return 1;
+  }
+
+  if (!compare("Clean log", log)) failures++;
+
+  // About one byte in 500 replaced, so most sentences still get through
+  std::string noisy = log;
+  for (size_t i = 0; i < noisy.size(); i++) {
+    if (random32() % 500 == 0) noisy[i] = (char)random32();
+  }
+  if (!compare("Noisy log", noisy)) failures++;
+
+  // Talker independence
+  const std::string gn = retalk(log, "GN");
+  TinyGPS gp_gps, gn_gps;
+  const int gp_sentences = gp_gps.encode(log.data(), log.size());
+  const int gn_sentences = gn_gps.encode(gn.data(), gn.size());
+  Result gp_result = result(gp_gps, gp_sentences);
+  Result gn_result = result(gn_gps, gn_sentences);
+  gn_result.chars = gp_result.chars;
+  const bool talker_ok = gp_sentences > 0 && gp_result == gn_result;
+  printf("GN talker            %d sentences, %s\n", gn_sentences,
+         talker_ok ? "match" : "MISMATCH");
+  if (!talker_ok) {
+    print("GP", gp_result);
+    print("GN", gn_result);
+    failures++;
+  }
+  if (!checkSentences()) failures++;
+  if (!checkUbxLength()) failures++;
+
+  // Timing, with the log repeated to a few megabytes; best of a few runs
+  // so that other load on the host does not count
+  const int ROUNDS = (int)(4000000 / log.size()) + 1;
+  const int RUNS = 5;
+  const size_t BUFFER = 64;
+  TinyGPS single, bulk;
+  int sentences = 0;
+  double single_time = 1e9, bulk_time = 1e9;
+
+  for (int run = 0; run < RUNS; run++) {
+    double t0 = seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+      for (size_t i = 0; i < log.size(); i++) {
+        if (single.encode(log[i])) sentences++;
+      }
+    }
+    double t1 = seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+      for (size_t i = 0; i < log.size(); i += BUFFER) {
+        const size_t n = log.size() - i < BUFFER ? log.size() - i : BUFFER;
+        sentences += bulk.encode(log.data() + i, n);
+      }
+    }
+    double t2 = seconds();
+    if (t1 - t0 < single_time) single_time = t1 - t0;
+    if (t2 - t1 < bulk_time) bulk_time = t2 - t1;
+  }
+  sink = sentences;
+
+  const double bytes = (double)log.size() * ROUNDS;
+  printf("Throughput           encode(char) %.1f MB/s, encode(buffer) %.1f MB/s, %.2fx\n",
+         bytes / single_time / 1e6, bytes / bulk_time / 1e6, single_time / bulk_time);
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+/****************************************************************************
+GPS startup check.
+
+Runs GpsSetup against scripted receivers in the states it has to cope
+with, then against the NEO-6M model, and checks where each one ends up:
+the baud rate found, the final baud rate and measurement period, how many
+configuration messages were refused, and that the script was followed to
+the end. Then checks resume() after a reset of the MCU alone: the model
+set up above is picked up with one poll, a receiver still at the factory
+settings is not. Times are virtual, as the firmware would spend them.
+
+Usage: gps-setup-bench
+****************************************************************************/
+
+#include <stdio.h>
+
+#include "GpsSetup.h"
+#include "HardwareSerial.h"
+#include "SimGps.h"
+#include "SimGpsScript.h"
+#include "UbxGps.h"
+
+using namespace sim;
+
+static const uint32_t FINAL_BAUD = 115200;
+static const uint16_t PERIODS[] = { 100, 200 };
+static const uint8_t PERIOD_COUNT = sizeof(PERIODS) / sizeof(PERIODS[0]);
+static const uint8_t MESSAGES[] = {
+  UBX_NAV, UBX_NAV_POSLLH, 1,
+  UBX_NAV, UBX_NAV_VELNED, 1,
+  UBX_NAV, UBX_NAV_SOL, 1
+};
+static const uint8_t MESSAGE_COUNT = sizeof(MESSAGES) / 3;
+
+// The conversation with a receiver at the factory 9600 baud that takes
+// 10 Hz and the new baud rate
+static const ScriptStep FACTORY[] = {
+  { UBX_CFG, UBX_CFG_PRT, REPLY_ACK, 0 },        // probe
+  { UBX_CFG, UBX_CFG_PRT, REPLY_ACK, 0 },        // protocols
+  { UBX_CFG, UBX_CFG_MSG, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_MSG, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_MSG, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_RATE, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_PRT, REPLY_NONE, 115200 },  // baud rate, answer lost
+  { UBX_CFG, UBX_CFG_PRT, REPLY_ACK, 0 }         // check
+};
+
+// Left at 115200 by an earlier run, and a NEO-6M: 10 Hz is refused
+static const ScriptStep WARM[] = {
+  { UBX_CFG, UBX_CFG_PRT, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_PRT, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_MSG, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_MSG, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_MSG, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_RATE, REPLY_NAK, 0 },
+  { UBX_CFG, UBX_CFG_RATE, REPLY_ACK, 0 }
+};
+
+// At 38400, refuses the VELNED rate and the baud rate change
+static const ScriptStep STUBBORN[] = {
+  { UBX_CFG, UBX_CFG_PRT, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_PRT, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_MSG, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_MSG, REPLY_NAK, 0 },
+  { UBX_CFG, UBX_CFG_MSG, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_RATE, REPLY_ACK, 0 },
+  { UBX_CFG, UBX_CFG_PRT, REPLY_NAK, 0 },
+  { UBX_CFG, UBX_CFG_PRT, REPLY_ACK, 0 }         // found again by the probe
+};
+
+struct Expected {
+  uint32_t foundBaud;
+  uint32_t baud;
+  uint16_t period;
+  uint8_t rejected;
+};
+
+// Ports, stand-ins and models stay registered with the clock, so none of
+// them is ever freed
+static HardwareSerial *newPort() {
+  return new HardwareSerial(new Uart("GPS", 40, 64));
+}
+
+static bool check(const char *name, HardwareSerial &port, const Expected &expected,
+                  const GpsScript *script) {
+  UbxGps ubx;
+  GpsSetup setup(port, ubx);
+
+  const uint64_t start = now();
+  const GpsSetup::Result r =
+      setup.begin(FINAL_BAUD, PERIODS, PERIOD_COUNT, UBX_PROTOCOL_UBX, MESSAGES, MESSAGE_COUNT);
+  const double seconds = (now() - start) / 1e6;
+
+  bool ok = r.foundBaud == expected.foundBaud && r.baud == expected.baud &&
+            r.period == expected.period && r.rejected == expected.rejected;
+  if (script) ok = ok && script->finished() && script->unexpected == 0;
+
+  printf("%-20s found %u, now %u baud, %u ms, %u refused, %.2f s%s\n",
+         name, r.foundBaud, r.baud, r.period, r.rejected, seconds, ok ? "" : "  FAILED");
+  if (!ok) {
+    printf("  expected found %u, now %u baud, %u ms, %u refused\n",
+           expected.foundBaud, expected.baud, expected.period, expected.rejected);
+    if (script) printf("  script %s, %u unexpected messages\n",
+                       script->finished() ? "finished" : "not finished", script->unexpected);
+  }
+  return ok;
+}
+
+static bool checkResume(const char *name, HardwareSerial &port, bool expected) {
+  UbxGps ubx;
+  GpsSetup setup(port, ubx);
+
+  const uint64_t start = now();
+  const bool resumed = setup.resume(FINAL_BAUD);
+  const double millis = (now() - start) / 1e3;
+
+  const bool ok = resumed == expected;
+  printf("%-20s %s at %u baud, %.1f ms%s\n", name, resumed ? "answered" : "no answer",
+         FINAL_BAUD, millis, ok ? "" : "  FAILED");
+  return ok;
+}
+
+static bool runScript(const char *name, uint32_t baud, const ScriptStep *steps, size_t count,
+                      const Expected &expected) {
+  HardwareSerial *port = newPort();
+  GpsScript *script = new GpsScript(*port->uart(), baud, steps, count);
+  return check(name, *port, expected, script);
+}
+
+int main() {
+  int failures = 0;
+
+  const Expected factory = { 9600, 115200, 100, 0 };
+  if (!runScript("Factory settings", 9600, FACTORY, sizeof(FACTORY) / sizeof(FACTORY[0]),
+                 factory)) {
+    failures++;
+  }
+
+  const Expected warm = { 115200, 115200, 200, 1 };
+  if (!runScript("Warm, 5 Hz limit", 115200, WARM, sizeof(WARM) / sizeof(WARM[0]), warm)) {
+    failures++;
+  }
+
+  const Expected stubborn = { 38400, 38400, 100, 2 };
+  if (!runScript("Refuses baud rate", 38400, STUBBORN, sizeof(STUBBORN) / sizeof(STUBBORN[0]),
+                 stubborn)) {
+    failures++;
+  }
+
+  // Nothing connected: every baud rate is tried, then setup gives up
+  const Expected silent = { 0, 0, 0, 0 };
+  if (!check("No receiver", *newPort(), silent, 0)) failures++;
+
+  // The NEO-6M model, mid NMEA output at power-up
+  HardwareSerial *port = newPort();
+  NeoGps *gps = new NeoGps(*port->uart());
+  advance(1500000);
+  const Expected model = { 9600, 115200, 200, 1 };
+  if (!check("NEO-6M model", *port, model, 0)) failures++;
+  if (gps->baud() != 115200 || gps->period() != 200000) {
+    printf("  model is at %u baud, %u ms\n", gps->baud(), gps->period() / 1000);
+    failures++;
+  }
+
+  // The MCU resets, the receiver carries on as set up
+  if (!checkResume("Resume", *port, true)) failures++;
+
+  // Power cycled with the MCU, back at the factory settings
+  HardwareSerial *cold_port = newPort();
+  new NeoGps(*cold_port->uart());
+  advance(1500000);
+  if (!checkResume("Resume after power", *cold_port, false)) failures++;
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,333 @@
+/****************************************************************************
+I2C transfer queue check.
+
+Runs I2Cqueue against a scratch register device on the simulated bus and
+checks that queued transfers go out in order and back to back, each ending
+with the data and status it should; that callbacks come from the interrupt
+as each one finishes and can queue more; that a full queue refuses, a
+missing device NACKs without holding up the rest, and a cancelled transfer
+never reaches the bus; and that a register read is a single transaction,
+the read following the register address after a repeated START. Then
+checks the I2Cdev register shadow: a bit write to a shadowed register is a
+single write, reading it back takes no bus traffic, self-clearing bits are
+not kept, and invalidating or writing around it sends the next read to the
+bus. Finally reads a run of DMP sized packets through the blocking I2Cdev
+calls and through the queue: the bus time is the same, but queued, none of
+it is spent waiting.
+
+Usage: i2c-queue-bench
+****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "I2Cdev.h"
+#include "SimI2C.h"
+
+using namespace sim;
+
+static const uint8_t SCRATCH = 0x50;
+static const uint8_t ABSENT = 0x51;
+static const int PACKETS = 50;
+static const int PACKET_SIZE = 48;
+
+// 256 bytes of plain memory behind the usual register pointer
+class Scratch : public RegisterDevice {
+ public:
+  Scratch() { memset(memory, 0, sizeof(memory)); }
+  uint8_t memory[256];
+
+ protected:
+  uint8_t readRegister(uint8_t reg) { return memory[reg]; }
+  void writeRegister(uint8_t reg, uint8_t value) { memory[reg] = value; }
+};
+
+// What the callbacks saw, in the order they were called
+static I2Ctransfer *finished[32];
+static uint64_t finishedAt[32];
+static int finishedCount = 0;
+
+static void record(I2Ctransfer *transfer) {
+  finishedAt[finishedCount] = now();
+  finished[finishedCount++] = transfer;
+}
+
+// Queues a read of the same register once the first one is in
+static I2Ctransfer chained;
+static uint8_t chainedData[4];
+static void chain(I2Ctransfer *transfer) {
+  record(transfer);
+  chained.setRead(transfer->devAddr, transfer->regAddr, sizeof(chainedData), chainedData);
+  chained.callback = record;
+  I2Cqueue::submit(&chained);
+}
+
+static void reset() {
+  finishedCount = 0;
+}
+
+// Bus time of a register read (pointer write, repeated START, read) and of
+// a register write
+static uint64_t readMicros(uint8_t address, size_t length) {
+  return i2c.transferMicros(address, 1, false) + i2c.transferMicros(address, length, true);
+}
+
+static uint64_t writeMicros(uint8_t address, size_t length) {
+  return i2c.transferMicros(address, 1 + length, true);
+}
+
+static void waitAll() {
+  while (!I2Cqueue::idle()) advance(10);
+}
+
+static bool report(const char *name, bool ok, const char *detail) {
+  printf("%-20s %s%s\n", name, detail, ok ? "" : "  FAILED");
+  return ok;
+}
+
+static bool checkOrder(Scratch &scratch) {
+  uint8_t pattern[16], readBack[16], single[4];
+  for (int i = 0; i < 16; i++) pattern[i] = (uint8_t)(0xA0 + i);
+
+  I2Ctransfer write, read, bytes[4];
+  write.setWrite(SCRATCH, 0x10, sizeof(pattern), pattern);
+  read.setRead(SCRATCH, 0x10, sizeof(readBack), readBack);
+  write.callback = record;
+  read.callback = record;
+
+  reset();
+  const uint64_t start = now();
+  bool ok = I2Cqueue::submit(&write) && I2Cqueue::submit(&read);
+  for (int i = 0; i < 4; i++) {
+    bytes[i].setRead(SCRATCH, (uint8_t)(0x10 + 3 * i), 1, &single[i]);
+    bytes[i].callback = record;
+    ok = I2Cqueue::submit(&bytes[i]) && ok;
+  }
+  const uint64_t submitted = now() - start;
+  waitAll();
+
+  // Each one as soon as the one before it is off the bus
+  uint64_t expected = start + writeMicros(SCRATCH, sizeof(pattern));
+  ok = ok && finishedCount == 6 && finished[0] == &write && finishedAt[0] == expected;
+  expected += readMicros(SCRATCH, sizeof(readBack));
+  ok = ok && finished[1] == &read && finishedAt[1] == expected;
+  for (int i = 0; i < 4 && ok; i++) {
+    expected += readMicros(SCRATCH, 1);
+    ok = finished[2 + i] == &bytes[i] && finishedAt[2 + i] == expected &&
+         bytes[i].status == I2CQUEUE_DONE && single[i] == pattern[3 * i];
+  }
+  ok = ok && write.status == I2CQUEUE_DONE && read.status == I2CQUEUE_DONE &&
+       memcmp(readBack, pattern, sizeof(pattern)) == 0 &&
+       memcmp(&scratch.memory[0x10], pattern, sizeof(pattern)) == 0 && submitted == 0;
+
+  char detail[96];
+  snprintf(detail, sizeof(detail), "6 transfers queued in %llu us, done after %.3f ms",
+           (unsigned long long)submitted, (finishedAt[finishedCount - 1] - start) / 1e3);
+  return report("Order", ok, detail);
+}
+
+static bool checkChain() {
+  uint8_t first[4];
+  I2Ctransfer transfer;
+  transfer.setRead(SCRATCH, 0x10, sizeof(first), first);
+  transfer.callback = chain;
+
+  reset();
+  bool ok = I2Cqueue::submit(&transfer);
+  waitAll();
+  ok = ok && finishedCount == 2 && finished[0] == &transfer && finished[1] == &chained &&
+       chained.status == I2CQUEUE_DONE && memcmp(first, chainedData, sizeof(first)) == 0;
+  return report("Callback chain", ok, "second read queued from the first one's callback");
+}
+
+static bool checkFull() {
+  uint8_t data[I2CQUEUE_SIZE + 2][2];
+  I2Ctransfer transfers[I2CQUEUE_SIZE + 2];
+  int accepted = 0;
+
+  reset();
+  for (int i = 0; i < I2CQUEUE_SIZE + 2; i++) {
+    transfers[i].setRead(SCRATCH, 0, 2, data[i]);
+    if (I2Cqueue::submit(&transfers[i])) accepted++;
+  }
+  waitAll();
+
+  // One on the bus, the rest waiting
+  bool ok = accepted == I2CQUEUE_SIZE + 1;
+  for (int i = 0; i < accepted; i++) ok = ok && transfers[i].status == I2CQUEUE_DONE;
+  char detail[64];
+  snprintf(detail, sizeof(detail), "%d of %d accepted", accepted, I2CQUEUE_SIZE + 2);
+  return report("Full queue", ok, detail);
+}
+
+static bool checkNack() {
+  uint8_t a[2], b[2], c[2];
+  I2Ctransfer first, missing, last;
+  first.setRead(SCRATCH, 0, 2, a);
+  missing.setRead(ABSENT, 0, 2, b);
+  last.setRead(SCRATCH, 0, 2, c);
+  missing.callback = record;
+
+  reset();
+  const uint32_t nacks = i2c.stats().nacks;
+  I2Cqueue::submit(&first);
+  I2Cqueue::submit(&missing);
+  I2Cqueue::submit(&last);
+  waitAll();
+
+  const bool ok = first.status == I2CQUEUE_DONE && missing.status == I2CQUEUE_NACK &&
+                  last.status == I2CQUEUE_DONE && finishedCount == 1 &&
+                  i2c.stats().nacks == nacks + 1;
+  return report("Missing device", ok, "NACK reported, the next transfer still runs");
+}
+
+static bool checkCancel(Scratch &scratch) {
+  uint8_t a[2], c[2];
+  uint8_t value = 0x5A;
+  I2Ctransfer first, cancelled, last;
+  first.setRead(SCRATCH, 0, 2, a);
+  cancelled.setWrite(SCRATCH, 0x80, 1, &value);
+  last.setRead(SCRATCH, 0, 2, c);
+  first.callback = cancelled.callback = last.callback = record;
+
+  reset();
+  scratch.memory[0x80] = 0;
+  const uint32_t transactions = i2c.stats().transactions;
+  I2Cqueue::submit(&first);
+  I2Cqueue::submit(&cancelled);
+  I2Cqueue::submit(&last);
+  I2Cqueue::cancel(&cancelled);
+  waitAll();
+
+  const bool ok = first.status == I2CQUEUE_DONE && cancelled.status == I2CQUEUE_CANCELLED &&
+                  last.status == I2CQUEUE_DONE && finishedCount == 2 &&
+                  scratch.memory[0x80] == 0 && i2c.stats().transactions == transactions + 2;
+  return report("Cancel", ok, "taken out of the queue, never on the bus");
+}
+
+static bool checkRepeatedStart() {
+  uint8_t data[6];
+  I2Ctransfer read;
+  read.setRead(SCRATCH, 0x10, sizeof(data), data);
+
+  const I2CBus::Stats before = i2c.stats();
+  const uint64_t start = now();
+  I2Cqueue::submit(&read);
+  waitAll();
+  const I2CBus::Stats &after = i2c.stats();
+
+  // Two STARTs, one STOP
+  const bool ok = read.status == I2CQUEUE_DONE &&
+                  after.transactions == before.transactions + 1 &&
+                  after.starts == before.starts + 2 &&
+                  after.busyMicros - before.busyMicros == readMicros(SCRATCH, sizeof(data)) &&
+                  now() - start >= readMicros(SCRATCH, sizeof(data));
+  char detail[64];
+  snprintf(detail, sizeof(detail), "%u transaction, %u starts, %llu us",
+           after.transactions - before.transactions, after.starts - before.starts,
+           (unsigned long long)(after.busyMicros - before.busyMicros));
+  return report("Repeated start", ok, detail);
+}
+
+static bool checkShadow(Scratch &scratch) {
+  const uint8_t PLAIN = 0x90, SHADOWED = 0x91, TRIGGER = 0x92;
+  scratch.memory[PLAIN] = scratch.memory[SHADOWED] = 0x0F;
+  I2Cdev::shadowRegister(SCRATCH, SHADOWED);
+  I2Cdev::shadowRegister(SCRATCH, TRIGGER, 0x80);
+
+  // The same bit write, without and with the shadow (the first one there
+  // has to read it, after that it is known)
+  uint32_t transactions = i2c.stats().transactions;
+  uint64_t start = now();
+  I2Cdev::writeBits(SCRATCH, PLAIN, 7, 4, 0x5);
+  const uint64_t plainMicros = now() - start;
+  const uint32_t plainTransactions = i2c.stats().transactions - transactions;
+  I2Cdev::writeBits(SCRATCH, SHADOWED, 7, 4, 0xA);
+  transactions = i2c.stats().transactions;
+  start = now();
+  I2Cdev::writeBits(SCRATCH, SHADOWED, 7, 4, 0x5);
+  const uint64_t shadowedMicros = now() - start;
+  const uint32_t shadowedTransactions = i2c.stats().transactions - transactions;
+
+  uint8_t value = 0;
+  transactions = i2c.stats().transactions;
+  bool ok = plainTransactions == 2 && shadowedTransactions == 1 &&
+            scratch.memory[PLAIN] == 0x5F && scratch.memory[SHADOWED] == 0x5F &&
+            I2Cdev::readByte(SCRATCH, SHADOWED, &value) == 1 && value == 0x5F &&
+            i2c.stats().transactions == transactions;
+
+  // A reset trigger is gone once written (the scratch register keeps it,
+  // so a bus read would show it)
+  I2Cdev::writeByte(SCRATCH, TRIGGER, 0x81);
+  ok = ok && I2Cdev::readByte(SCRATCH, TRIGGER, &value) == 1 && value == 0x01;
+
+  // Changed behind the shadow's back: only seen once it is invalidated
+  scratch.memory[SHADOWED] = 0x33;
+  ok = ok && I2Cdev::readByte(SCRATCH, SHADOWED, &value) == 1 && value == 0x5F;
+  I2Cdev::shadowInvalidate(SCRATCH);
+  ok = ok && I2Cdev::readByte(SCRATCH, SHADOWED, &value) == 1 && value == 0x33;
+
+  // A burst from an unshadowed register runs over it and leaves it unknown
+  uint8_t burst[2] = { 0x11, 0x22 };
+  I2Cdev::writeBytes(SCRATCH, PLAIN, 2, burst);
+  transactions = i2c.stats().transactions;
+  ok = ok && I2Cdev::readByte(SCRATCH, SHADOWED, &value) == 1 && value == 0x22 &&
+       i2c.stats().transactions == transactions + 1;
+
+  char detail[96];
+  snprintf(detail, sizeof(detail), "bit write %u transaction, %llu us (%u, %llu us unshadowed)",
+           shadowedTransactions, (unsigned long long)shadowedMicros,
+           plainTransactions, (unsigned long long)plainMicros);
+  return report("Register shadow", ok, detail);
+}
+
+static bool checkOverlap() {
+  static uint8_t packets[PACKETS][PACKET_SIZE];
+  I2Ctransfer transfers[PACKETS];
+
+  // Blocking: the CPU waits out every transfer, and a little more for the
+  // timeout checks
+  uint64_t start = now();
+  for (int i = 0; i < PACKETS; i++) I2Cdev::readBytes(SCRATCH, 0, PACKET_SIZE, packets[i]);
+  const uint64_t blocking = now() - start;
+
+  // Queued, a few at a time as the sketch would; the CPU only comes back
+  // for finished ones
+  uint64_t waited = 0;
+  int next = 0, done = 0;
+  start = now();
+  while (done < PACKETS) {
+    while (next < PACKETS && next - done < 4) {
+      transfers[next].setRead(SCRATCH, 0, PACKET_SIZE, packets[next]);
+      const uint64_t before = now();
+      I2Cqueue::submit(&transfers[next++]);
+      waited += now() - before;
+    }
+    advance(100);  // other work
+    while (done < next && !transfers[done].pending()) done++;
+  }
+  const uint64_t bus = (uint64_t)PACKETS * readMicros(SCRATCH, PACKET_SIZE);
+
+  const bool ok = blocking >= bus && waited == 0;
+  char detail[128];
+  snprintf(detail, sizeof(detail), "%d x %d bytes, %.1f ms on the bus, blocking waits %.1f ms, "
+           "queued %.1f ms", PACKETS, PACKET_SIZE, bus / 1e3, blocking / 1e3, waited / 1e3);
+  return report("Overlap", ok, detail);
+}
+
+int main() {
+  static Scratch scratch;
+  i2c.attach(SCRATCH, &scratch);
+  int failures = 0;
+
+  if (!checkOrder(scratch)) failures++;
+  if (!checkChain()) failures++;
+  if (!checkFull()) failures++;
+  if (!checkNack()) failures++;
+  if (!checkCancel(scratch)) failures++;
+  if (!checkRepeatedStart()) failures++;
+  if (!checkShadow(scratch)) failures++;
+  if (!checkOverlap()) failures++;
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+/****************************************************************************
+Ground station decoder check.
+
+Feeds gs::TelemetryDecoder streams built with TelemetryFrame and the text
+format, and checks what comes out: frames and their samples; junk on the
+link and a corrupted frame skipped, with decoding picking up again at the
+next delimiter; a frame failing its CRC rejected and counted; text lines
+ending in LF and in CRLF; noise lines with digit runs too long for the
+mantissa refused; text and frames mixed in one stream, whole and fed in
+small random chunks. Finally maps a timestamp to UTC through
+gs::TimeBase from a UTC/DRF time sync record, as telemetry-csv -u does.
+
+Usage: telemetry-decoder-bench
+****************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "TelemetryDecoder.h"
+#include "TimeBase.h"
+
+using gs::Sample;
+using gs::TelemetryDecoder;
+
+static uint32_t random32() {
+  static uint32_t state = 0x2545F491;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static bool report(const char *name, bool ok, const char *detail) {
+  printf("%-20s %s%s\n", name, detail, ok ? "" : "  FAILED");
+  return ok;
+}
+
+// One frame as sent, delimiter included
+static std::string frame(TelemetryFrame &f, uint32_t timestamp, float altitude) {
+  uint8_t out[TELEMETRY_FRAME_MAX];
+  f.begin(timestamp);
+  f.set(TELEMETRY_AQW, 0.5f);
+  f.set(TELEMETRY_ALT, altitude);
+  f.setFixed(TELEMETRY_LAT, 424859630, 7);
+  return std::string((const char *)out, f.encode(out));
+}
+
+static std::vector<Sample> decode(TelemetryDecoder &decoder, const std::string &stream) {
+  std::vector<Sample> samples;
+  decoder.decode((const uint8_t *)stream.data(), stream.size(), samples);
+  return samples;
+}
+
+static bool sample(const std::vector<Sample> &samples, size_t i, uint32_t timestamp,
+                   uint8_t channel, double value) {
+  return i < samples.size() && samples[i].timestamp == timestamp &&
+         samples[i].channel == channel && fabs(samples[i].value - value) < 1e-9;
+}
+
+static bool checkFrames() {
+  TelemetryFrame f;
+  TelemetryDecoder decoder;
+  std::string stream = frame(f, 1000, 120.25f);
+  stream += frame(f, 1020, 120.5f);
+  const std::vector<Sample> samples = decode(decoder, stream);
+  const TelemetryDecoder::Stats &s = decoder.stats();
+  const bool ok = s.frames == 2 && s.badFrames == 0 && s.lostFrames == 0 &&
+                  samples.size() == 6 && sample(samples, 0, 1000, TELEMETRY_AQW, 0.5) &&
+                  sample(samples, 1, 1000, TELEMETRY_ALT, 120.25) &&
+                  sample(samples, 2, 1000, TELEMETRY_LAT, 42.485963) &&
+                  sample(samples, 4, 1020, TELEMETRY_ALT, 120.5);
+  char detail[96];
+  snprintf(detail, sizeof(detail), "%llu frames, %u samples",
+           (unsigned long long)s.frames, (unsigned)samples.size());
+  return report("Frames", ok, detail);
+}
+
+static bool checkResync() {
+  TelemetryFrame f;
+  TelemetryDecoder decoder;
+  std::string junk;
+  for (int i = 0; i < 20; i++) junk += (char)(1 + random32() % 255);
+
+  // Noise ending in a zero, a frame damaged in transit, noise running
+  // straight into the next frame
+  std::string stream = junk + '\0' + frame(f, 1000, 1.0f);
+  std::string corrupt = frame(f, 1020, 2.0f);
+  corrupt[3] = (char)(corrupt[3] == 0x55 ? 0x56 : 0x55);
+  stream += corrupt + junk.substr(0, 7) + '\0';
+  stream += frame(f, 1040, 3.0f);
+  const std::vector<Sample> samples = decode(decoder, stream);
+  const TelemetryDecoder::Stats &s = decoder.stats();
+  const bool ok = s.frames == 2 && s.badFrames == 3 && s.lostFrames == 1 &&
+                  samples.size() == 6 && sample(samples, 4, 1040, TELEMETRY_ALT, 3.0);
+  char detail[96];
+  snprintf(detail, sizeof(detail), "%llu frames decoded, %llu bad, %llu lost",
+           (unsigned long long)s.frames, (unsigned long long)s.badFrames,
+           (unsigned long long)s.lostFrames);
+  return report("COBS resync", ok, detail);
+}
+
+static bool checkCrc() {
+  TelemetryFrame f, check;
+  TelemetryDecoder decoder;
+  std::string bad = frame(f, 1000, 1.0f);
+
+  // The last CRC byte, or the code byte in front of it if it was zero;
+  // either way one bit off and no zero added
+  const size_t i = bad.size() - 2;
+  bad[i] = (char)(bad[i] ^ (bad[i] == 0x01 ? 0x02 : 0x01));
+  const bool rejected = !check.decode((const uint8_t *)bad.data(), bad.size() - 1);
+
+  bad += frame(f, 1020, 2.0f);
+  const std::vector<Sample> samples = decode(decoder, bad);
+  const TelemetryDecoder::Stats &s = decoder.stats();
+  const bool ok = rejected && s.frames == 1 && s.badFrames == 1 && samples.size() == 3 &&
+                  sample(samples, 1, 1020, TELEMETRY_ALT, 2.0);
+  return report("Bad CRC", ok, "frame rejected, the next one decoded");
+}
+
+static bool checkLines() {
+  TelemetryDecoder decoder;
+  const std::vector<Sample> samples =
+    decode(decoder, "$ALT120.25T1000\n$CLB-1.5T1020\r\n$XYZ1.0T1040\n$AQW0.5T1060\r\n");
+  const TelemetryDecoder::Stats &s = decoder.stats();
+  const bool ok = s.lines == 3 && s.badLines == 1 && samples.size() == 3 &&
+                  sample(samples, 0, 1000, TELEMETRY_ALT, 120.25) &&
+                  sample(samples, 1, 1020, TELEMETRY_CLB, -1.5) &&
+                  sample(samples, 2, 1060, TELEMETRY_AQW, 0.5);
+  return report("Text lines", ok, "LF and CRLF, unknown code skipped");
+}
+
+static bool checkLongNumbers() {
+  // Each on its own, as a refused line stays pending in case it is part of a
+  // binary frame
+  const std::string refused[] = { "$ALT" + std::string(100, '9') + "T1000\n",
+                                  "$ALT1." + std::string(30, '7') + "T1000\n",
+                                  "$ALT1234567890.123456789T1000\n" };
+  bool ok = true;
+  for (size_t i = 0; i < sizeof(refused) / sizeof(refused[0]); i++) {
+    TelemetryDecoder decoder;
+    ok = ok && decode(decoder, refused[i]).empty() && decoder.stats().badLines == 1;
+  }
+
+  TelemetryDecoder decoder;
+  const std::vector<Sample> samples = decode(decoder, "$ALT12345678901234.5678T1040\n");
+  ok = ok && decoder.stats().lines == 1 && samples.size() == 1 &&
+       sample(samples, 0, 1040, TELEMETRY_ALT, 12345678901234.5678);
+  return report("Long numbers", ok, "over 18 digits refused, 18 digits decoded");
+}
+
+static bool checkMixed() {
+  TelemetryFrame f;
+  std::string stream;
+  for (int i = 0; i < 50; i++) {
+    stream += frame(f, 1000 + 20 * i, i * 0.5f);
+    stream += i % 2 ? "$SPD12.34T" : "\r\n$SPD12.34T";
+    char time[16];
+    snprintf(time, sizeof(time), "%d\r\n", 1010 + 20 * i);
+    stream += time;
+  }
+
+  TelemetryDecoder whole, chunked;
+  const std::vector<Sample> expected = decode(whole, stream);
+  std::vector<Sample> samples;
+  for (size_t i = 0; i < stream.size();) {
+    const size_t n = std::min(stream.size() - i, (size_t)(1 + random32() % 7));
+    chunked.decode((const uint8_t *)stream.data() + i, n, samples);
+    i += n;
+  }
+
+  bool ok = whole.stats().frames == 50 && whole.stats().lines == 50 &&
+            whole.stats().badFrames == 0 && expected.size() == 200 &&
+            samples.size() == expected.size() &&
+            sample(expected, 3, 1010, TELEMETRY_SPD, 12.34);
+  for (size_t i = 0; ok && i < samples.size(); i++) {
+    ok = sample(samples, i, expected[i].timestamp, expected[i].channel, expected[i].value);
+  }
+  char detail[96];
+  snprintf(detail, sizeof(detail), "%llu frames, %llu lines, same in chunks of 1 to 7",
+           (unsigned long long)whole.stats().frames, (unsigned long long)whole.stats().lines);
+  return report("Mixed stream", ok, detail);
+}
+
+static bool checkUtc() {
+  TelemetryFrame f;
+  uint8_t out[TELEMETRY_FRAME_MAX];
+  f.begin(65000);
+  f.setFixed(TELEMETRY_UTC, 504371285, 4);  // 14:00:37.1285
+  f.setFixed(TELEMETRY_DRF, 2500, 2);       // 25 ppm fast
+  std::string stream((const char *)out, f.encode(out));
+  stream += "$AQW0.5T64000\n";
+  stream += frame(f, 66000, 1.0f);
+
+  TelemetryDecoder decoder;
+  gs::TimeBase time_base;
+  const std::vector<Sample> samples = decode(decoder, stream);
+  bool ok = samples.size() == 6 && !time_base.valid();
+  for (size_t i = 0; i < samples.size(); i++) time_base.update(samples[i]);
+
+  // A second of aircraft time is 25 us short of a UTC second, either side
+  // of the record
+  const double after = time_base.utc(66000);
+  const double before = time_base.utc(64000);
+  ok = ok && time_base.valid() && fabs(after - 50438.128475) < 1e-6 &&
+       fabs(before - 50436.128525) < 1e-6;
+  char detail[96];
+  snprintf(detail, sizeof(detail), "%.4f s and %.4f s a second either side of the record",
+           before, after);
+  return report("UTC column", ok, detail);
+}
+
+int main() {
+  int failures = 0;
+
+  if (!checkFrames()) failures++;
+  if (!checkResync()) failures++;
+  if (!checkCrc()) failures++;
+  if (!checkLines()) failures++;
+  if (!checkLongNumbers()) failures++;
+  if (!checkMixed()) failures++;
+  if (!checkUtc()) failures++;
+
+  return failures ? 1 : 0;
+}
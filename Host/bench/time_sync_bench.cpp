@@ -0,0 +1,186 @@
+/****************************************************************************
+Clock synchronization check.
+
+Runs TimeSync against the NEO-6M model, whose UTC runs 30 ppm slow against
+the virtual clock and starts partway into a second, with a main loop that
+now and then stalls for a few ms as the sketch's does. Once the fit has
+settled, UTC as TimeSync has it is compared with the model's at random
+moments, and the drift with the model's:
+
+  PPS        timepulse wired, every pulse taken in an ISR
+  Messages   no timepulse, pairs from when the solutions are parsed; the
+             receiver's output latency shows up as a constant offset, so
+             only its spread is held to the millisecond, and the drift is
+             only good to a few ppm
+
+A synthetic run across midnight UTC checks the day wrap.
+
+Usage: time-sync-bench
+****************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+
+#include "GpsSetup.h"
+#include "HardwareSerial.h"
+#include "SimGps.h"
+#include "TimeSync.h"
+#include "UbxGps.h"
+
+#include "Arduino.h"
+
+using namespace sim;
+
+static const uint8_t PPS_PIN = 7;
+static const uint16_t PERIODS[] = { 200 };
+static const uint8_t MESSAGES[] = {
+  UBX_NAV, UBX_NAV_POSLLH, 1,
+  UBX_NAV, UBX_NAV_SOL, 1,
+  UBX_NAV, UBX_NAV_TIMEUTC, 5
+};
+
+// Simulated run, and how long the fit is given to settle
+static const uint64_t RUN_MICROS = 120000000ull;
+static const uint64_t SETTLE_MICROS = 40000000ull;
+
+// xorshift32, so runs are repeatable
+static uint32_t state = 2463534242u;
+static uint32_t random32() {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static volatile bool pulse_pending = false;
+static volatile uint32_t pulse_micros;
+
+static void pulse() {
+  pulse_micros = (uint32_t)now();
+  pulse_pending = true;
+}
+
+struct Result {
+  uint32_t checks;
+  double minError;    // us, TimeSync less the model
+  double maxError;
+  double drift;       // ppm
+  bool pps;
+};
+
+/**
+ * Polls the port the way feed_gps() does, with a pass through the rest of
+ * the loop in between
+ */
+static Result run(bool wire_pps) {
+  HardwareSerial *port = new HardwareSerial(new Uart("GPS", 40, 64));
+  NeoGps *gps = new NeoGps(*port->uart());
+  UbxGps ubx;
+  TimeSync sync;
+  GpsSetup setup(*port, ubx);
+  Result r = { 0, 1e9, -1e9, 0.0, false };
+
+  if (wire_pps) {
+    gps->setPpsPin(PPS_PIN);
+    ::attachInterrupt(PPS_PIN, pulse, RISING);
+  }
+  setup.begin(115200, PERIODS, 1, UBX_PROTOCOL_UBX, MESSAGES, sizeof(MESSAGES) / 3);
+
+  const uint64_t start = now();
+  uint64_t next_check = start + SETTLE_MICROS;
+  uint32_t previous_utc = TIME_SYNC_DAY_MILLIS;
+  while (now() - start < RUN_MICROS) {
+    if (pulse_pending) {
+      pulse_pending = false;
+      sync.pulse(pulse_micros);
+    }
+
+    uint8_t buffer[64];
+    const uint32_t received = (uint32_t)now();
+    size_t n = 0;
+    while (n < sizeof(buffer) && port->available()) buffer[n++] = port->read();
+    ubx.encode(buffer, n);
+    uint32_t utc;
+    if ((ubx.updated() & UBX_UPDATED_POSITION) && ubx.utc(ubx.position().tow, &utc) &&
+        utc != previous_utc) {
+      previous_utc = utc;
+      sync.solution(utc, received);
+    }
+
+    if (now() >= next_check && sync.synced()) {
+      const uint64_t t = now();
+      uint16_t micros_past;
+      const double ours = sync.utc((uint32_t)t, &micros_past) * 1000.0 + micros_past;
+      const double error = ours - (double)NeoGps::utc(t);
+      if (error < r.minError) r.minError = error;
+      if (error > r.maxError) r.maxError = error;
+      r.checks++;
+      next_check = t + 50000 + random32() % 100000;
+    }
+
+    // Mostly a quick pass, sometimes a frame or a bus transfer
+    advance(random32() % 700 == 0 ? 1000 + random32() % 9000 : 5 + random32() % 20);
+  }
+
+  if (wire_pps) ::detachInterrupt(PPS_PIN);
+  port->end();
+  r.drift = sync.drift();
+  r.pps = sync.pps();
+  return r;
+}
+
+static bool report(const char *name, const Result &r, bool pps, double max_spread,
+                   double max_bias, double max_drift_error) {
+  const double drift_error = fabs(r.drift - NeoGps::clockDrift());
+  const bool ok = r.checks > 0 && r.pps == pps && r.maxError - r.minError <= max_spread &&
+                  fabs(r.minError) <= max_bias && fabs(r.maxError) <= max_bias &&
+                  drift_error <= max_drift_error;
+  printf("%-20s %u checks, error %.0f to %.0f us, drift %.3f ppm (%.3f off)%s\n",
+         name, r.checks, r.minError, r.maxError, r.drift, drift_error, ok ? "" : "  FAILED");
+  return ok;
+}
+
+/**
+ * Exact pairs across midnight, the local clock 50 ppm slow
+ */
+static bool acrossMidnight() {
+  TimeSync sync;
+  const double rate = 1.0 - 50e-6;
+  const uint32_t first_second = TIME_SYNC_DAY_MILLIS - 20000;
+  const uint32_t boot = 123456789;
+  double worst = 0.0;
+
+  for (uint32_t k = 0; k < 40; k++) {
+    const uint32_t local = boot + (uint32_t)floor(k * 1e6 * rate + 0.5);
+    const uint32_t utc = (first_second + k * 1000) % TIME_SYNC_DAY_MILLIS;
+    sync.pulse(local);
+    sync.solution(utc, local + 60000);
+
+    if (k >= TIME_SYNC_SLOPE_POINTS) {
+      uint16_t micros_past;
+      const uint32_t at = local + 500000;
+      const double ours = sync.utc(at, &micros_past) * 1000.0 + micros_past;
+      double truth = fmod(first_second * 1000.0 + k * 1e6 + 500000 / rate,
+                          TIME_SYNC_DAY_MILLIS * 1000.0);
+      const double error = fabs(ours - truth);
+      if (error > worst) worst = error;
+      const double back = fabs((double)(int32_t)(sync.local(utc) - local));
+      if (back > worst) worst = back;
+    }
+  }
+
+  const bool ok = worst <= 2.0 && fabs(sync.drift() + 50.0) <= 0.01;
+  printf("%-20s error %.1f us, drift %.3f ppm%s\n",
+         "Across midnight", worst, sync.drift(), ok ? "" : "  FAILED");
+  return ok;
+}
+
+int main() {
+  int failures = 0;
+
+  if (!report("PPS", run(true), true, 20.0, 20.0, 0.1)) failures++;
+  if (!report("Messages", run(false), false, 1000.0, 100000.0, 5.0)) failures++;
+  if (!acrossMidnight()) failures++;
+
+  return failures ? 1 : 0;
+}
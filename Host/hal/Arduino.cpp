@@ -0,0 +1,86 @@
+#include "Sim.h"
+
+#include "Arduino.h"
+
+// Reference voltage of the Teensy 3.0 ADC as calibrated on the bench
+static const double ADC_VREF = 3.284;
+
+// One conversion at the default Teensyduino ADC clock
+static const uint32_t ADC_CONVERSION_MICROS = 4;
+
+// Reading the clock takes about this long, which also keeps polling loops
+// that only watch millis() or micros() from spinning forever
+static const uint32_t CLOCK_READ_MICROS = 1;
+
+static unsigned int adc_resolution = 10;
+static unsigned int adc_averaging = 4;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  sim::setPinMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  sim::writePin(pin, val);
+}
+
+uint8_t digitalRead(uint8_t pin) {
+  return sim::readPin(pin);
+}
+
+void analogReadResolution(unsigned int bits) {
+  adc_resolution = bits;
+}
+
+void analogReadAveraging(unsigned int num) {
+  adc_averaging = num;
+}
+
+int analogRead(uint8_t pin) {
+  const int full_scale = (1 << adc_resolution) - 1;
+  const unsigned int samples = adc_averaging ? adc_averaging : 1;
+  double sum = 0.0;
+
+  for (unsigned int i = 0; i < samples; i++) {
+    sim::advance(ADC_CONVERSION_MICROS);
+    sum += sim::analogVoltage(pin);
+  }
+
+  int value = (int)(sum / samples / ADC_VREF * full_scale + 0.5);
+  return constrain(value, 0, full_scale);
+}
+
+uint32_t millis(void) {
+  uint32_t ms = (uint32_t)(sim::now() / 1000);
+  sim::advance(CLOCK_READ_MICROS);
+  return ms;
+}
+
+uint32_t micros(void) {
+  uint32_t us = (uint32_t)sim::now();
+  sim::advance(CLOCK_READ_MICROS);
+  return us;
+}
+
+void delay(uint32_t ms) {
+  sim::advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t usec) {
+  sim::advance(usec);
+}
+
+void attachInterrupt(uint8_t pin, void (*function)(void), int mode) {
+  sim::attachInterrupt(pin, function, mode);
+}
+
+void detachInterrupt(uint8_t pin) {
+  sim::detachInterrupt(pin);
+}
+
+void interrupts(void) {
+  sim::setInterruptsEnabled(true);
+}
+
+void noInterrupts(void) {
+  sim::setInterruptsEnabled(false);
+}
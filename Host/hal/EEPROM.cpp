@@ -0,0 +1,17 @@
+#include <string.h>
+
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
+
+EEPROMClass::EEPROMClass() {
+  memset(memory, 0xFF, sizeof(memory));
+}
+
+uint8_t EEPROMClass::read(int address) {
+  return address >= 0 && address <= E2END ? memory[address] : 0xFF;
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  if (address >= 0 && address <= E2END) memory[address] = value;
+}
@@ -0,0 +1,25 @@
+// Host stand-in for the Teensy 3 EEPROM library. The 2 KB start out erased
+// and keep what is written for the rest of the run, across setup() being
+// run again for a warm restart.
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <inttypes.h>
+
+#define E2END 0x7FF
+
+class EEPROMClass {
+ public:
+  EEPROMClass();
+
+  uint8_t read(int address);
+  void write(int address, uint8_t value);
+
+ private:
+  uint8_t memory[E2END + 1];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
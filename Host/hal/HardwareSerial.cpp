@@ -0,0 +1,47 @@
+#include "SimUart.h"
+
+#include "HardwareSerial.h"
+
+// Buffer sizes of the Teensyduino serial1.c, serial2.c and serial3.c
+static sim::Uart usb_uart("Serial", 0, 4096);
+static sim::Uart uart1("Serial1", 64, 64);
+static sim::Uart uart2("Serial2", 40, 64);
+static sim::Uart uart3("Serial3", 40, 64);
+
+HardwareSerial Serial(&usb_uart);
+HardwareSerial Serial1(&uart1);
+HardwareSerial Serial2(&uart2);
+HardwareSerial Serial3(&uart3);
+
+void HardwareSerial::begin(uint32_t baud) {
+  uart_->begin(baud);
+}
+
+void HardwareSerial::end() {
+  uart_->end();
+}
+
+int HardwareSerial::available() {
+  return uart_->available();
+}
+
+int HardwareSerial::peek() {
+  return uart_->peek();
+}
+
+int HardwareSerial::read() {
+  return uart_->read();
+}
+
+void HardwareSerial::flush() {
+  uart_->flush();
+}
+
+int HardwareSerial::availableForWrite() {
+  return (int)uart_->txFree();
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  uart_->transmit(c);
+  return 1;
+}
@@ -0,0 +1,43 @@
+// Host stand-in for the Teensy 3.0 serial ports. Each port is backed by a
+// sim::Uart model; see sim/SimUart.h.
+
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include "Stream.h"
+
+namespace sim {
+class Uart;
+}
+
+class HardwareSerial : public Stream {
+ public:
+  explicit HardwareSerial(sim::Uart *uart) : uart_(uart) {}
+
+  void begin(uint32_t baud);
+  void end();
+  int available();
+  int peek();
+  int read();
+  void flush();
+  size_t write(uint8_t c);
+  using Print::write;
+
+  /** Bytes that fit in the transmit buffer without blocking. */
+  int availableForWrite();
+  operator bool() { return true; }
+
+  /** Simulation model behind this port. */
+  sim::Uart *uart() { return uart_; }
+
+ private:
+  sim::Uart *uart_;
+};
+
+// USB virtual serial, hardware UART1, UART2 and UART3
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+
+#endif
@@ -0,0 +1,78 @@
+// Host port for the I2Cdev transfer queue, in place of the Teensy's I2C0
+// interrupt. Transfers run on the simulated controller in sim/SimI2C.h, a
+// whole addressed transfer per interrupt rather than a byte. The Makefile
+// defines I2CQUEUE_EXTERNAL_PORT, so I2Cqueue.cpp leaves its own out.
+
+#include "I2Cqueue.h"
+#include "SimI2C.h"
+
+namespace {
+
+enum State {
+  IDLE,
+  REGISTER,  // register pointer being written ahead of a read
+  DATA
+};
+
+sim::I2CController controller(sim::i2c, sim::IRQ_I2C0);
+I2Ctransfer *current = 0;
+State state = IDLE;
+
+void finish(int8_t status) {
+  state = IDLE;
+  current = 0;
+  I2Cqueue::finished(status);
+}
+
+void i2cInterrupt() {
+  I2Ctransfer *t = current;
+  if (!t || state == IDLE) return;
+
+  if (!controller.acked()) {
+    finish(I2CQUEUE_NACK);
+  } else if (state == REGISTER) {
+    // Repeated START, addressing the device again for reading
+    state = DATA;
+    controller.startRead(t->devAddr, t->data, t->length, true);
+  } else {
+    t->count = t->length;
+    finish(I2CQUEUE_DONE);
+  }
+}
+
+}
+
+void I2Cqueue::portBegin() {
+  sim::attachIrq(sim::IRQ_I2C0, i2cInterrupt);
+}
+
+void I2Cqueue::portStart(I2Ctransfer *transfer) {
+  const bool has_register = !(transfer->flags & I2CQUEUE_NO_REGISTER);
+  current = transfer;
+
+  if (!(transfer->flags & I2CQUEUE_READ)) {
+    state = DATA;
+    controller.startWrite(transfer->devAddr, &transfer->regAddr, has_register ? 1 : 0,
+                          transfer->data, transfer->length, true);
+  } else if (has_register) {
+    state = REGISTER;
+    controller.startWrite(transfer->devAddr, &transfer->regAddr, 1, 0, 0, false);
+  } else {
+    state = DATA;
+    controller.startRead(transfer->devAddr, transfer->data, transfer->length, true);
+  }
+}
+
+void I2Cqueue::portAbort() {
+  controller.abort();
+  state = IDLE;
+  current = 0;
+}
+
+void I2Cqueue::portWait() {
+  // Straight to the end of the transfer on the bus, or whatever else
+  // happens first; anything still pending after that needs the clock moved
+  const uint64_t next = controller.nextEvent();
+  const uint64_t now = sim::now();
+  sim::advance(next != sim::NEVER && next > now ? next - now : 1);
+}
@@ -0,0 +1,59 @@
+/****************************************************************************
+Host stand-in for the Arduino Print class.
+
+Number and float formatting follow the Arduino 1.0 core exactly so that the
+simulated radio stream is byte-for-byte what the Teensy would send.
+****************************************************************************/
+
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+class __FlashStringHelper;
+
+class Print {
+ public:
+  Print() : write_error(0) {}
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str);
+
+  int getWriteError() { return write_error; }
+  void clearWriteError() { write_error = 0; }
+
+  size_t print(const __FlashStringHelper *ifsh);
+  size_t print(const char str[]);
+  size_t print(char c);
+  size_t print(unsigned char n, int base = 10);
+  size_t print(int n, int base = 10);
+  size_t print(unsigned int n, int base = 10);
+  size_t print(long n, int base = 10);
+  size_t print(unsigned long n, int base = 10);
+  size_t print(double n, int digits = 2);
+
+  size_t println(const __FlashStringHelper *ifsh);
+  size_t println(const char str[]);
+  size_t println(char c);
+  size_t println(unsigned char n, int base = 10);
+  size_t println(int n, int base = 10);
+  size_t println(unsigned int n, int base = 10);
+  size_t println(long n, int base = 10);
+  size_t println(unsigned long n, int base = 10);
+  size_t println(double n, int digits = 2);
+  size_t println(void);
+
+  size_t printNumber(unsigned long n, uint8_t base);
+  size_t printFloat(double number, uint8_t digits);
+
+ protected:
+  void setWriteError(int err = 1) { write_error = err; }
+
+ private:
+  int write_error;
+};
+
+#endif
@@ -0,0 +1,2 @@
+// Pre-1.0 Arduino core header, kept for libraries that still include it.
+#include "Arduino.h"
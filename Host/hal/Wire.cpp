@@ -0,0 +1,107 @@
+#include "SimI2C.h"
+
+#include "Wire.h"
+
+TwoWire Wire;
+
+TwoWire::TwoWire()
+  : rxBufferIndex(0)
+  , rxBufferLength(0)
+  , txAddress(0)
+  , txBufferLength(0)
+  , transmitting(false) {
+}
+
+void TwoWire::begin() {
+  rxBufferIndex = rxBufferLength = 0;
+  txBufferLength = 0;
+}
+
+void TwoWire::begin(uint8_t address) {
+  // Slave mode is not simulated
+  (void)address;
+  begin();
+}
+
+void TwoWire::begin(int address) {
+  begin((uint8_t)address);
+}
+
+void TwoWire::setClock(uint32_t frequency) {
+  sim::i2c.setClock(frequency);
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  transmitting = true;
+  txAddress = address;
+  txBufferLength = 0;
+}
+
+void TwoWire::beginTransmission(int address) {
+  beginTransmission((uint8_t)address);
+}
+
+uint8_t TwoWire::endTransmission(void) {
+  return endTransmission((uint8_t)true);
+}
+
+uint8_t TwoWire::endTransmission(uint8_t sendStop) {
+  // Like the real library, an empty transmission still addresses the slave
+  uint8_t ret = sim::i2c.write(txAddress, txBuffer, txBufferLength, sendStop);
+  txBufferLength = 0;
+  transmitting = false;
+  return ret;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop) {
+  if (quantity > BUFFER_LENGTH) quantity = BUFFER_LENGTH;
+  uint8_t read = sim::i2c.read(address, rxBuffer, quantity, sendStop);
+  rxBufferIndex = 0;
+  rxBufferLength = read;
+  return read;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+  return requestFrom(address, quantity, (uint8_t)true);
+}
+
+uint8_t TwoWire::requestFrom(int address, int quantity) {
+  return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t)true);
+}
+
+uint8_t TwoWire::requestFrom(int address, int quantity, int sendStop) {
+  return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t)sendStop);
+}
+
+size_t TwoWire::write(uint8_t data) {
+  if (!transmitting || txBufferLength >= BUFFER_LENGTH) {
+    setWriteError();
+    return 0;
+  }
+  txBuffer[txBufferLength++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity) {
+  for (size_t i = 0; i < quantity; i++) {
+    if (!write(data[i])) return i;
+  }
+  return quantity;
+}
+
+int TwoWire::available(void) {
+  return rxBufferLength - rxBufferIndex;
+}
+
+int TwoWire::read(void) {
+  if (rxBufferIndex < rxBufferLength) return rxBuffer[rxBufferIndex++];
+  return -1;
+}
+
+int TwoWire::peek(void) {
+  if (rxBufferIndex < rxBufferLength) return rxBuffer[rxBufferIndex];
+  return -1;
+}
+
+void TwoWire::flush(void) {
+}
@@ -0,0 +1,53 @@
+// Host stand-in for the Arduino Wire library. Transfers go to the simulated
+// bus in sim/SimI2C.h.
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include <inttypes.h>
+
+#include "Stream.h"
+
+#define BUFFER_LENGTH 32
+
+class TwoWire : public Stream {
+ public:
+  TwoWire();
+
+  void begin();
+  void begin(uint8_t address);
+  void begin(int address);
+  void setClock(uint32_t frequency);
+
+  void beginTransmission(uint8_t address);
+  void beginTransmission(int address);
+  uint8_t endTransmission(void);
+  uint8_t endTransmission(uint8_t sendStop);
+
+  uint8_t requestFrom(uint8_t address, uint8_t quantity);
+  uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop);
+  uint8_t requestFrom(int address, int quantity);
+  uint8_t requestFrom(int address, int quantity, int sendStop);
+
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *data, size_t quantity);
+  int available(void);
+  int read(void);
+  int peek(void);
+  void flush(void);
+  using Print::write;
+
+ private:
+  uint8_t rxBuffer[BUFFER_LENGTH];
+  uint8_t rxBufferIndex;
+  uint8_t rxBufferLength;
+
+  uint8_t txAddress;
+  uint8_t txBuffer[BUFFER_LENGTH];
+  uint8_t txBufferLength;
+  bool transmitting;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,11 @@
+// Host stand-in for util/delay.h. Busy-waits advance the virtual clock.
+
+#ifndef _UTIL_DELAY_H_
+#define _UTIL_DELAY_H_
+
+#include "Arduino.h"
+
+#define _delay_ms(ms) delayMicroseconds((uint32_t)((ms) * 1000))
+#define _delay_us(us) delayMicroseconds((uint32_t)(us))
+
+#endif
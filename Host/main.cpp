@@ -0,0 +1,204 @@
+/****************************************************************************
+Host runner for LtuAeroTelemetry.
+
+Wires the sketch to the simulated bench (BMP085, MPU-9150 with its AK8975,
+NEO-6M GPS, analog mux, radio) and runs setup() and loop() against the
+virtual clock for a fixed stretch of simulated time. Everything is
+deterministic, so two runs of the same build produce the same capture and
+the same report.
+
+With -w the Teensy is reset that many seconds in, the sensors carrying on
+as they are: setup() runs again, once the I2C transfer in progress has
+finished, and the report gives how long the radio was silent for. The
+sketch's variables keep their values, where a real reset would clear them.
+
+Usage: ltu-telemetry-sim [-t seconds] [-w seconds] [-r radio.txt] [-s console.txt]
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SimAk8975.h"
+#include "SimAnalogMux.h"
+#include "SimBmp085.h"
+#include "SimCapture.h"
+#include "SimGps.h"
+#include "SimMpu9150.h"
+
+#include "Arduino.h"
+#include "I2Cqueue.h"
+
+// Cost of one pass through loop() that finds nothing to do, plus the
+// Teensyduino yield() between passes
+static const uint32_t LOOP_OVERHEAD_MICROS = 5;
+
+// Passes through loop() that take longer than this did real work (a
+// telemetry frame) and are reported separately
+static const uint64_t SLOW_PASS_MICROS = 1000;
+
+// Sketch wiring
+static const uint8_t MUX_SIGNAL_PIN = A0;
+static const uint8_t MUX_S0_PIN = 2;
+static const uint8_t MPU_INT_PIN = 6;
+static const uint8_t GPS_PPS_PIN = 7;
+
+struct CycleStats {
+  uint32_t count;
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+
+  void add(uint64_t micros) {
+    if (count == 0 || micros < min) min = micros;
+    if (micros > max) max = micros;
+    total += micros;
+    count++;
+  }
+};
+
+static FILE *openOutput(const char *path) {
+  if (!path) return 0;
+  if (strcmp(path, "-") == 0) return stdout;
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    perror(path);
+    exit(1);
+  }
+  return f;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s [-t seconds] [-w seconds] [-r radio.txt] [-s console.txt]\n",
+          name);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  double seconds = 60.0;
+  double restart_seconds = 0.0;
+  const char *radio_path = 0;
+  const char *console_path = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:w:r:s:h")) != -1) {
+    switch (opt) {
+      case 't': seconds = atof(optarg); break;
+      case 'w': restart_seconds = atof(optarg); break;
+      case 'r': radio_path = optarg; break;
+      case 's': console_path = optarg; break;
+      default: usage(argv[0]);
+    }
+  }
+
+  FILE *radio_file = openOutput(radio_path);
+  FILE *console_file = openOutput(console_path);
+
+  sim::Bmp085 bmp;
+  sim::Mpu9150 mpu;
+  sim::Ak8975 mag(mpu);
+  mpu.setInterruptPin(MPU_INT_PIN);
+  sim::NeoGps gps(*Serial2.uart());
+  gps.setPpsPin(GPS_PPS_PIN);
+  sim::AnalogMux mux(MUX_SIGNAL_PIN, MUX_S0_PIN);
+  sim::Capture radio(*Serial1.uart(), radio_file);
+  sim::Capture console(*Serial.uart(), console_file);
+  sim::setAnalogSource(&mux);
+
+  const uint64_t end = (uint64_t)(seconds * 1e6);
+
+  setup();
+  const uint64_t setup_micros = sim::now();
+
+  CycleStats passes, slow;
+  memset(&passes, 0, sizeof(passes));
+  memset(&slow, 0, sizeof(slow));
+  const sim::I2CBus::Stats bus_at_start = sim::i2c.stats();
+
+  const uint64_t restart = (uint64_t)(restart_seconds * 1e6);
+  uint64_t restart_at = 0, restart_micros = 0;
+
+  while (sim::now() < end) {
+    if (restart && !restart_at && sim::now() >= restart) {
+      while (!I2Cqueue::idle()) sim::advance(1);
+      restart_at = sim::now();
+      setup();
+      restart_micros = sim::now() - restart_at;
+    }
+
+    const uint64_t before = sim::now();
+    loop();
+    const uint64_t spent = sim::now() - before;
+    passes.add(spent);
+    if (spent >= SLOW_PASS_MICROS) slow.add(spent);
+    sim::advance(LOOP_OVERHEAD_MICROS);
+  }
+
+  if (radio_file && radio_file != stdout) fclose(radio_file);
+  if (console_file && console_file != stdout) fclose(console_file);
+
+  const sim::I2CBus::Stats &bus = sim::i2c.stats();
+  const double run_seconds = (sim::now() - setup_micros) / 1e6;
+  const sim::Uart &radio_port = *Serial1.uart();
+  const sim::Uart &gps_port = *Serial2.uart();
+
+  FILE *out = radio_file == stdout || console_file == stdout ? stderr : stdout;
+  fprintf(out, "Simulated time       %.3f s (setup %.3f s)\n",
+          sim::now() / 1e6, setup_micros / 1e6);
+  if (passes.count) {
+    fprintf(out, "Loop passes          %u, mean %.1f us, max %.3f ms\n",
+            passes.count, (double)passes.total / passes.count, passes.max / 1e3);
+  }
+  if (slow.count) {
+    fprintf(out, "Passes over %2.0f ms    %u, mean %.3f ms, min %.3f ms, max %.3f ms\n",
+            SLOW_PASS_MICROS / 1e3, slow.count, slow.total / 1e3 / slow.count,
+            slow.min / 1e3, slow.max / 1e3);
+  }
+  fprintf(out, "CPU blocked          %.1f %% of run time\n",
+          100.0 * slow.total / 1e6 / run_seconds);
+
+  fprintf(out, "I2C during setup     %u transactions, %u bytes, %.1f ms busy\n",
+          bus_at_start.transactions, bus_at_start.bytes, bus_at_start.busyMicros / 1e3);
+  const uint32_t transactions = bus.transactions - bus_at_start.transactions;
+  fprintf(out, "I2C after setup      %u transactions (%.1f/s), %u bytes, %.1f ms busy\n",
+          transactions, transactions / run_seconds,
+          bus.bytes - bus_at_start.bytes,
+          (bus.busyMicros - bus_at_start.busyMicros) / 1e3);
+  for (int address = 0; address < 128; address++) {
+    const uint32_t n = bus.transactionsTo[address] - bus_at_start.transactionsTo[address];
+    if (n) fprintf(out, "  0x%02X               %u starts\n", address, n);
+  }
+  fprintf(out, "I2C NACKs            %u\n", bus.nacks);
+
+  fprintf(out, "Radio                %llu bytes, %llu lines, %.1f bytes/s, "
+          "%.1f %% of %u baud, %.1f ms blocked\n",
+          (unsigned long long)radio.bytes, (unsigned long long)radio.lines,
+          radio.bytes / (sim::now() / 1e6),
+          100.0 * radio.bytes * 10.0 / (radio_port.baud() * (sim::now() / 1e6)),
+          radio_port.baud(), radio_port.blockedMicros / 1e3);
+  fprintf(out, "Radio silent         %.1f ms at most, until %.3f s\n",
+          radio.longestGap / 1e3, radio.gapEnd / 1e6);
+  if (restart_at) {
+    fprintf(out, "Warm restart         at %.3f s, setup %.1f ms\n",
+            restart_at / 1e6, restart_micros / 1e3);
+  }
+  fprintf(out, "GPS                  %u sentences, %u UBX messages sent at %u baud, "
+          "%u ms epochs, %u ACK, %u NAK\n",
+          gps.sentences, gps.ubxMessages, gps.baud(), gps.period() / 1000,
+          gps.acks, gps.naks);
+  fprintf(out, "GPS port             %llu bytes received, "
+          "%llu overruns, %llu framing errors\n",
+          (unsigned long long)gps_port.rxBytes,
+          (unsigned long long)gps_port.rxOverruns,
+          (unsigned long long)gps_port.rxFramingErrors);
+  fprintf(out, "BMP085               %u temperature, %u pressure conversions\n",
+          bmp.temperatureConversions, bmp.pressureConversions);
+  fprintf(out, "MPU-9150             %u DMP packets, %u FIFO overflows, %u aux transfers\n",
+          mpu.dmpPackets, mpu.fifoOverflows, mpu.auxTransactions);
+  fprintf(out, "AK8975               %u measurements\n", mag.measurements);
+  fprintf(out, "ADC                  %u conversions\n", mux.conversions);
+  fprintf(out, "Interrupts           %u\n", sim::interruptCount());
+
+  return 0;
+}
@@ -0,0 +1,166 @@
+#include <vector>
+
+#include "Sim.h"
+
+namespace sim {
+
+namespace {
+
+const uint8_t NUM_PINS = 64;
+
+// Must match the Arduino.h mode constants
+const int MODE_CHANGE = 4;
+const int MODE_FALLING = 2;
+const int MODE_RISING = 3;
+
+struct Pin {
+  uint8_t mode;
+  uint8_t level;
+  void (*isr)(void);
+  int isr_mode;
+  bool pending;
+};
+
+uint64_t clock_now = 0;
+bool advancing = false;
+bool interrupts_enabled = true;
+bool in_isr = false;
+uint32_t interrupts_taken = 0;
+Pin pins[NUM_PINS];
+void (*irq_isrs[NUM_IRQS])(void);
+bool irq_pending[NUM_IRQS];
+AnalogSource *analog_source = 0;
+
+// Devices register from static constructors in other translation units
+std::vector<Device *> &deviceList() {
+  static std::vector<Device *> devices;
+  return devices;
+}
+
+void dispatchInterrupts() {
+  if (!interrupts_enabled || in_isr) return;
+
+  in_isr = true;
+  for (uint8_t i = 0; i < NUM_PINS; i++) {
+    if (pins[i].pending && pins[i].isr) {
+      pins[i].pending = false;
+      interrupts_taken++;
+      pins[i].isr();
+    }
+  }
+  for (uint8_t i = 0; i < NUM_IRQS; i++) {
+    if (irq_pending[i] && irq_isrs[i]) {
+      irq_pending[i] = false;
+      interrupts_taken++;
+      irq_isrs[i]();
+    }
+  }
+  in_isr = false;
+}
+
+}
+
+uint64_t now() {
+  return clock_now;
+}
+
+void advance(uint64_t micros) {
+  const uint64_t target = clock_now + micros;
+
+  // An ISR or a device callback that blocks only moves time; the outer
+  // loop steps the devices once it regains control.
+  if (advancing) {
+    clock_now = target;
+    return;
+  }
+
+  std::vector<Device *> &devices = deviceList();
+  advancing = true;
+  for (;;) {
+    uint64_t next = target;
+    for (size_t i = 0; i < devices.size(); i++) {
+      uint64_t event = devices[i]->nextEvent();
+      if (event < next) next = event;
+    }
+    if (next > clock_now) clock_now = next;
+
+    for (size_t i = 0; i < devices.size(); i++) {
+      devices[i]->update(clock_now);
+    }
+    dispatchInterrupts();
+
+    if (clock_now >= target) break;
+  }
+  advancing = false;
+}
+
+void addDevice(Device *device) {
+  deviceList().push_back(device);
+}
+
+void setPinMode(uint8_t pin, uint8_t mode) {
+  if (pin < NUM_PINS) pins[pin].mode = mode;
+}
+
+void writePin(uint8_t pin, uint8_t level) {
+  if (pin >= NUM_PINS) return;
+
+  Pin &p = pins[pin];
+  level = level ? 1 : 0;
+  if (p.isr && level != p.level) {
+    if (p.isr_mode == MODE_CHANGE ||
+        (p.isr_mode == MODE_RISING && level) ||
+        (p.isr_mode == MODE_FALLING && !level)) {
+      p.pending = true;
+    }
+  }
+  p.level = level;
+
+  if (!advancing) dispatchInterrupts();
+}
+
+uint8_t readPin(uint8_t pin) {
+  return pin < NUM_PINS ? pins[pin].level : 0;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+  if (pin >= NUM_PINS) return;
+  pins[pin].isr = isr;
+  pins[pin].isr_mode = mode;
+  pins[pin].pending = false;
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < NUM_PINS) pins[pin].isr = 0;
+}
+
+void attachIrq(uint8_t irq, void (*isr)(void)) {
+  if (irq >= NUM_IRQS) return;
+  irq_isrs[irq] = isr;
+  irq_pending[irq] = false;
+}
+
+void raiseIrq(uint8_t irq) {
+  if (irq >= NUM_IRQS) return;
+  irq_pending[irq] = true;
+  if (!advancing) dispatchInterrupts();
+}
+
+void setInterruptsEnabled(bool enabled) {
+  interrupts_enabled = enabled;
+  if (enabled) dispatchInterrupts();
+}
+
+uint32_t interruptCount() {
+  return interrupts_taken;
+}
+
+void setAnalogSource(AnalogSource *source) {
+  analog_source = source;
+}
+
+double analogVoltage(uint8_t pin) {
+  return analog_source ? analog_source->voltage(pin, clock_now) : 0.0;
+}
+
+}
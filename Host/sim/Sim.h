@@ -0,0 +1,76 @@
+/****************************************************************************
+Simulation core for the host build.
+
+The simulator owns a virtual microsecond clock. Nothing in the host build
+reads wall-clock time; time only moves when the firmware blocks (delay(),
+an I2C transfer, a full UART buffer, an ADC conversion) or when the main
+loop charges its fixed per-iteration overhead. Device models register with
+the clock and are stepped event by event, so interrupts and FIFO contents
+appear at the same virtual instants they would on the bench.
+****************************************************************************/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace sim {
+
+const uint64_t NEVER = ~(uint64_t)0;
+
+/**
+ * A peripheral model stepped by the virtual clock.
+ */
+class Device {
+ public:
+  virtual ~Device() {}
+
+  /** Time of the next internal state change, or NEVER. */
+  virtual uint64_t nextEvent() const { return NEVER; }
+
+  /** Bring the model up to the given time. */
+  virtual void update(uint64_t now) = 0;
+};
+
+/** Current virtual time in microseconds. */
+uint64_t now();
+
+/** Advance the virtual clock, stepping every device on the way. */
+void advance(uint64_t micros);
+
+void addDevice(Device *device);
+
+// GPIO. Pins are shared between the firmware and the device models.
+void setPinMode(uint8_t pin, uint8_t mode);
+void writePin(uint8_t pin, uint8_t level);
+uint8_t readPin(uint8_t pin);
+
+// Interrupts attached by the firmware and raised by pin edges
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t pin);
+void setInterruptsEnabled(bool enabled);
+uint32_t interruptCount();
+
+// Peripheral interrupts, raised by device models rather than pin edges
+const uint8_t IRQ_I2C0 = 0;
+const uint8_t NUM_IRQS = 4;
+
+void attachIrq(uint8_t irq, void (*isr)(void));
+void raiseIrq(uint8_t irq);
+
+/**
+ * Supplies the voltage seen on an analog input pin.
+ */
+class AnalogSource {
+ public:
+  virtual ~AnalogSource() {}
+  virtual double voltage(uint8_t pin, uint64_t now) = 0;
+};
+
+void setAnalogSource(AnalogSource *source);
+double analogVoltage(uint8_t pin);
+
+}
+
+#endif
@@ -0,0 +1,106 @@
+#include <math.h>
+
+#include "SimAk8975.h"
+#include "SimFlight.h"
+
+namespace sim {
+
+namespace {
+
+const uint8_t REG_WIA = 0x00;
+const uint8_t REG_INFO = 0x01;
+const uint8_t REG_ST1 = 0x02;
+const uint8_t REG_HXL = 0x03;
+const uint8_t REG_ST2 = 0x09;
+const uint8_t REG_CNTL = 0x0A;
+const uint8_t REG_ASAX = 0x10;
+
+const uint8_t WIA = 0x48;
+const uint8_t ST1_DRDY = 0x01;
+
+const uint8_t MODE_POWER_DOWN = 0x00;
+const uint8_t MODE_SINGLE = 0x01;
+const uint8_t MODE_FUSE_ROM = 0x0F;
+
+// Maximum single measurement time
+const uint32_t MEASURE_MICROS = 9000;
+
+// 0.3 uT per LSB
+const double LSB_PER_UT = 1.0 / 0.3;
+
+// Factory sensitivity adjustment, a typical part
+const uint8_t ASA[3] = { 0xB1, 0xB3, 0xA6 };
+
+}
+
+Ak8975::Ak8975(Mpu9150 &host)
+  : measurements(0)
+  , host_(host)
+  , mode_(MODE_POWER_DOWN)
+  , status1_(0)
+  , done_(NEVER) {
+  for (int i = 0; i < 6; i++) data_[i] = 0;
+  addDevice(this);
+  i2c.attach(ADDRESS, this);
+  host.attachAux(ADDRESS, this);
+}
+
+uint8_t Ak8975::readRegister(uint8_t reg) {
+  if (reg >= REG_HXL && reg < REG_HXL + 6) {
+    // Reading the data clears DRDY
+    status1_ &= ~ST1_DRDY;
+    return data_[reg - REG_HXL];
+  }
+  if (reg >= REG_ASAX && reg < REG_ASAX + 3) {
+    return mode_ == MODE_FUSE_ROM ? ASA[reg - REG_ASAX] : 0;
+  }
+
+  switch (reg) {
+    case REG_WIA: return WIA;
+    case REG_INFO: return 0x00;
+    case REG_ST1: return status1_;
+    case REG_ST2:
+      status1_ &= ~ST1_DRDY;
+      return 0x00;
+    case REG_CNTL: return mode_;
+    default: return 0;
+  }
+}
+
+void Ak8975::writeRegister(uint8_t reg, uint8_t value) {
+  if (reg != REG_CNTL) return;
+
+  mode_ = value & 0x0F;
+  if (mode_ == MODE_SINGLE) {
+    done_ = now() + MEASURE_MICROS;
+  } else {
+    done_ = NEVER;
+  }
+}
+
+void Ak8975::update(uint64_t now) {
+  if (now < done_) return;
+  done_ = NEVER;
+  measure(now);
+  mode_ = MODE_POWER_DOWN;
+  status1_ |= ST1_DRDY;
+}
+
+void Ak8975::measure(uint64_t now) {
+  measurements++;
+  const FlightState s = flight(now);
+  double body[3];
+  toBody(s, MAGNETIC_FIELD, body);
+
+  // The AK8975 axes are the MPU-9150 Y, X and -Z axes
+  const double axes[3] = { body[1], body[0], -body[2] };
+  for (int i = 0; i < 3; i++) {
+    const double adjust = (ASA[i] - 128) / 256.0 + 1.0;
+    const int16_t value =
+      (int16_t)lround((axes[i] + 0.3 * noise(30 + i, measurements)) * LSB_PER_UT / adjust);
+    data_[2 * i] = value & 0xFF;
+    data_[2 * i + 1] = (uint8_t)(value >> 8);
+  }
+}
+
+}
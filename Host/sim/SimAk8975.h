@@ -0,0 +1,47 @@
+/****************************************************************************
+AsahiKASEI AK8975 magnetometer model, the compass die inside the MPU-9150.
+
+It sits on the MPU-9150 auxiliary bus and is only visible on the host bus
+while the MPU has I2C bypass enabled and its own I2C master disabled. Single
+measurement mode sets DRDY once the conversion time has passed and drops
+back to power-down, as on the part.
+****************************************************************************/
+
+#ifndef SIM_AK8975_H
+#define SIM_AK8975_H
+
+#include "SimMpu9150.h"
+
+namespace sim {
+
+class Ak8975 : public RegisterDevice, public Device {
+ public:
+  static const uint8_t ADDRESS = 0x0C;
+
+  explicit Ak8975(Mpu9150 &host);
+
+  bool present() const { return host_.bypassEnabled(); }
+
+  uint64_t nextEvent() const { return done_; }
+  void update(uint64_t now);
+
+  // Statistics
+  uint32_t measurements;
+
+ protected:
+  uint8_t readRegister(uint8_t reg);
+  void writeRegister(uint8_t reg, uint8_t value);
+
+ private:
+  void measure(uint64_t now);
+
+  Mpu9150 &host_;
+  uint8_t mode_;
+  uint8_t status1_;
+  uint8_t data_[6];
+  uint64_t done_;
+};
+
+}
+
+#endif
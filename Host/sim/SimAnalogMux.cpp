@@ -0,0 +1,65 @@
+#include <math.h>
+
+#include "SimAnalogMux.h"
+#include "SimFlight.h"
+
+namespace sim {
+
+namespace {
+
+const uint8_t AIRSPEED_CHANNEL = 0;
+const uint8_t CURRENT_CHANNEL = 1;
+const uint8_t VOLTAGE_CHANNEL = 2;
+
+// Scale factors of the AttoPilot 90A breakout at 3.3 V, in 12 bit ADC
+// counts against the 3.284 V reference
+const double ADC_VREF = 3.284;
+const double ADC_MAX = 4095.0;
+const double COUNTS_PER_AMP = 23.0193;
+const double COUNTS_PER_VOLT = 45.4082;
+
+// MPXV7002DP zero offset at 3.3 V supply as trimmed on the airframe
+const double AIRSPEED_ZERO = 1.3;
+
+const double SPEED_OF_SOUND = 340.29;
+const double STANDARD_TEMPERATURE = 15.0;
+
+}
+
+AnalogMux::AnalogMux(uint8_t signal, uint8_t s0)
+  : conversions(0)
+  , signal_(signal)
+  , s0_(s0) {
+}
+
+double AnalogMux::voltage(uint8_t pin, uint64_t now) {
+  if (pin != signal_) return 0.0;
+  conversions++;
+
+  uint8_t channel = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (readPin(s0_ + i)) channel |= 1 << i;
+  }
+
+  const FlightState s = flight(now);
+  switch (channel) {
+    case AIRSPEED_CHANNEL: {
+      // Inverse of the conversion in send_airspeed()
+      const double v = s.airspeed / SPEED_OF_SOUND;
+      const double x = v * v / (5.0 * (s.temperature / STANDARD_TEMPERATURE));
+      const double qc = pow(x + 1.0, 3.5) - 1.0;
+      return AIRSPEED_ZERO + qc + 0.0008 * noise(40, conversions);
+    }
+
+    case CURRENT_CHANNEL:
+      return (s.current * COUNTS_PER_AMP + noise(41, conversions)) * ADC_VREF / ADC_MAX;
+
+    case VOLTAGE_CHANNEL:
+      return (s.voltage * COUNTS_PER_VOLT + noise(42, conversions)) * ADC_VREF / ADC_MAX;
+
+    default:
+      return 0.0;
+  }
+}
+
+}
@@ -0,0 +1,37 @@
+/****************************************************************************
+HP4067 16 channel analog multiplexer model and the sensors behind it.
+
+The select lines are read from the simulated GPIO whenever the firmware
+samples the signal pin, so a wrong select sequence reads the wrong sensor.
+Channel 0 carries the MPXV7002DP airspeed sensor, 1 and 2 the AttoPilot
+current and voltage outputs.
+****************************************************************************/
+
+#ifndef SIM_ANALOG_MUX_H
+#define SIM_ANALOG_MUX_H
+
+#include "Sim.h"
+
+namespace sim {
+
+class AnalogMux : public AnalogSource {
+ public:
+  /**
+   * @param signal Analog pin wired to the mux SIG output
+   * @param s0 First of four consecutive select pins
+   */
+  AnalogMux(uint8_t signal, uint8_t s0);
+
+  double voltage(uint8_t pin, uint64_t now);
+
+  // Statistics
+  uint32_t conversions;
+
+ private:
+  uint8_t signal_;
+  uint8_t s0_;
+};
+
+}
+
+#endif
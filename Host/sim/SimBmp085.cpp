@@ -0,0 +1,176 @@
+#include <math.h>
+
+#include "SimBmp085.h"
+#include "SimFlight.h"
+
+namespace sim {
+
+namespace {
+
+// Example calibration from the BMP085 datasheet, section 3.5
+const int16_t AC1 = 408;
+const int16_t AC2 = -72;
+const int16_t AC3 = -14383;
+const uint16_t AC4 = 32741;
+const uint16_t AC5 = 32757;
+const uint16_t AC6 = 23153;
+const int16_t B1 = 6190;
+const int16_t B2 = 4;
+const int16_t MB = -32768;
+const int16_t MC = -8711;
+const int16_t MD = 2868;
+
+const uint8_t REG_CALIBRATION = 0xAA;
+const uint8_t REG_CHIP_ID = 0xD0;
+const uint8_t REG_SOFT_RESET = 0xE0;
+const uint8_t REG_CONTROL = 0xF4;
+const uint8_t REG_RESULT = 0xF6;
+
+const uint8_t CHIP_ID = 0x55;
+const uint8_t CMD_TEMPERATURE = 0x2E;
+const uint8_t CMD_PRESSURE = 0x34;
+const uint8_t SCO = 0x20;
+
+// Maximum conversion times in microseconds, datasheet table 3
+const uint32_t TEMPERATURE_MICROS = 4500;
+const uint32_t PRESSURE_MICROS[4] = { 4500, 7500, 13500, 25500 };
+
+int32_t computeB5(int32_t ut) {
+  int32_t x1 = ((ut - (int32_t)AC6) * (int32_t)AC5) >> 15;
+  int32_t x2 = ((int32_t)MC << 11) / (x1 + MD);
+  return x1 + x2;
+}
+
+// Pressure in Pa
+int32_t computePressure(int32_t ut, int32_t up, uint8_t oss) {
+  int32_t b6 = computeB5(ut) - 4000;
+  int32_t x1 = (B2 * ((b6 * b6) >> 12)) >> 11;
+  int32_t x2 = (AC2 * b6) >> 11;
+  int32_t x3 = x1 + x2;
+  int32_t b3 = ((((int32_t)AC1 * 4 + x3) << oss) + 2) >> 2;
+  x1 = (AC3 * b6) >> 13;
+  x2 = (B1 * ((b6 * b6) >> 12)) >> 16;
+  x3 = ((x1 + x2) + 2) >> 2;
+  uint32_t b4 = ((uint32_t)AC4 * (uint32_t)(x3 + 32768)) >> 15;
+  uint32_t b7 = ((uint32_t)up - b3) * (50000ul >> oss);
+  int32_t p = b7 < 0x80000000ul ? (b7 * 2) / b4 : (b7 / b4) * 2;
+  x1 = (p >> 8) * (p >> 8);
+  x1 = (x1 * 3038) >> 16;
+  x2 = (-7357 * p) >> 16;
+  return p + ((x1 + x2 + 3791) >> 4);
+}
+
+// Smallest raw value whose compensated reading reaches the target; the
+// compensation is monotonic over the searched range
+template <typename F>
+int32_t invert(F f, int32_t lo, int32_t hi, int32_t target) {
+  while (lo < hi) {
+    int32_t mid = lo + (hi - lo) / 2;
+    if (f(mid) < target) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+struct B5Of {
+  int32_t operator()(int32_t ut) const { return computeB5(ut); }
+};
+
+struct PressureOf {
+  int32_t ut;
+  uint8_t oss;
+  int32_t operator()(int32_t up) const { return computePressure(ut, up, oss); }
+};
+
+}
+
+Bmp085::Bmp085()
+  : temperatureConversions(0)
+  , pressureConversions(0)
+  , control_(0)
+  , done_(NEVER) {
+  result_[0] = result_[1] = result_[2] = 0;
+  addDevice(this);
+  i2c.attach(ADDRESS, this);
+}
+
+uint8_t Bmp085::readRegister(uint8_t reg) {
+  if (reg >= REG_CALIBRATION && reg < REG_CALIBRATION + 22) {
+    static const int16_t calibration[11] = {
+      AC1, AC2, AC3, (int16_t)AC4, (int16_t)AC5, (int16_t)AC6, B1, B2, MB, MC, MD
+    };
+    const uint16_t word = (uint16_t)calibration[(reg - REG_CALIBRATION) / 2];
+    return (reg - REG_CALIBRATION) % 2 ? word & 0xFF : word >> 8;
+  }
+
+  switch (reg) {
+    case REG_CHIP_ID: return CHIP_ID;
+    case REG_CONTROL: return control_;
+    case REG_RESULT: return result_[0];
+    case REG_RESULT + 1: return result_[1];
+    case REG_RESULT + 2: return result_[2];
+    default: return 0;
+  }
+}
+
+void Bmp085::writeRegister(uint8_t reg, uint8_t value) {
+  if (reg == REG_SOFT_RESET && value == 0xB6) {
+    control_ = 0;
+    done_ = NEVER;
+    return;
+  }
+  if (reg != REG_CONTROL) return;
+
+  control_ = value | SCO;
+  const uint8_t command = value & 0x3F;
+  if (command == CMD_TEMPERATURE) {
+    temperatureConversions++;
+    done_ = now() + TEMPERATURE_MICROS;
+  } else if (command == CMD_PRESSURE) {
+    pressureConversions++;
+    done_ = now() + PRESSURE_MICROS[value >> 6];
+  } else {
+    control_ = value;
+  }
+}
+
+void Bmp085::update(uint64_t now) {
+  if (now < done_) return;
+  done_ = NEVER;
+  convert();
+  control_ &= ~SCO;
+}
+
+void Bmp085::convert() {
+  const uint64_t t = now();
+  const FlightState s = flight(t);
+  const uint8_t oss = control_ >> 6;
+
+  // Readings carry the datasheet RMS noise of the selected mode
+  static const double PRESSURE_NOISE[4] = { 6.0, 5.0, 4.0, 3.0 };
+  // B5 counts 1/16 of the 0.1 degree C output resolution
+  const int32_t b5 = (int32_t)lround((s.temperature * 10.0 + 0.1 * noise(1, t)) * 16.0);
+  const int32_t ut = invert(B5Of(), 24000, 65535, b5);
+
+  if ((control_ & 0x3F) == CMD_TEMPERATURE) {
+    result_[0] = ut >> 8;
+    result_[1] = ut & 0xFF;
+    result_[2] = 0;
+    return;
+  }
+
+  PressureOf pressureOf;
+  pressureOf.ut = ut;
+  pressureOf.oss = oss;
+  const int32_t pressure =
+    (int32_t)(s.pressure + PRESSURE_NOISE[oss] * noise(2, t) + 0.5);
+  const int32_t up =
+    invert(pressureOf, 1000 << oss, (1 << (16 + oss)) - 1, pressure);
+
+  const uint32_t raw = (uint32_t)up << (8 - oss);
+  result_[0] = (raw >> 16) & 0xFF;
+  result_[1] = (raw >> 8) & 0xFF;
+  result_[2] = raw & 0xFF;
+}
+
+}
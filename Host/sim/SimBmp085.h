@@ -0,0 +1,45 @@
+/****************************************************************************
+Bosch BMP085 model.
+
+Register-level: chip id, the datasheet example calibration PROM, the control
+register and the conversion result registers. A conversion takes the
+datasheet maximum time for its mode; the raw UT/UP values are chosen so that
+the datasheet compensation algorithm returns the reference flight's
+temperature and pressure.
+****************************************************************************/
+
+#ifndef SIM_BMP085_H
+#define SIM_BMP085_H
+
+#include "SimI2C.h"
+
+namespace sim {
+
+class Bmp085 : public RegisterDevice, public Device {
+ public:
+  static const uint8_t ADDRESS = 0x77;
+
+  Bmp085();
+
+  uint64_t nextEvent() const { return done_; }
+  void update(uint64_t now);
+
+  // Statistics
+  uint32_t temperatureConversions;
+  uint32_t pressureConversions;
+
+ protected:
+  uint8_t readRegister(uint8_t reg);
+  void writeRegister(uint8_t reg, uint8_t value);
+
+ private:
+  void convert();
+
+  uint8_t control_;
+  uint8_t result_[3];
+  uint64_t done_;
+};
+
+}
+
+#endif
@@ -0,0 +1,29 @@
+#include "Sim.h"
+#include "SimCapture.h"
+
+namespace sim {
+
+Capture::Capture(Uart &port, FILE *out)
+  : bytes(0)
+  , lines(0)
+  , longestGap(0)
+  , gapEnd(0)
+  , out_(out)
+  , last_(0) {
+  port.connect(this);
+}
+
+void Capture::receive(uint8_t c, uint32_t baud) {
+  (void)baud;
+  const uint64_t t = now();
+  if (bytes && t - last_ > longestGap) {
+    longestGap = t - last_;
+    gapEnd = t;
+  }
+  last_ = t;
+  bytes++;
+  if (c == '\n') lines++;
+  if (out_) fputc(c, out_);
+}
+
+}
@@ -0,0 +1,37 @@
+/****************************************************************************
+Far end of a UART that records what the firmware sent: the ground station
+radio on Serial1, the debug console on Serial.
+****************************************************************************/
+
+#ifndef SIM_CAPTURE_H
+#define SIM_CAPTURE_H
+
+#include <stdio.h>
+
+#include "SimUart.h"
+
+namespace sim {
+
+class Capture : public UartPeer {
+ public:
+  /**
+   * @param out Where received bytes are written, or 0 to only count them
+   */
+  Capture(Uart &port, FILE *out);
+
+  void receive(uint8_t c, uint32_t baud);
+
+  // Statistics
+  uint64_t bytes;
+  uint64_t lines;
+  uint64_t longestGap;  // us between two bytes, the first not counting
+  uint64_t gapEnd;      // when the longest gap ended
+
+ private:
+  FILE *out_;
+  uint64_t last_;
+};
+
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include <math.h>
+
+#include "SimFlight.h"
+
+namespace sim {
+
+namespace {
+
+const double METERS_PER_DEGREE = 111320.0;
+
+// Lawrence Tech runway threshold, takeoff towards the west
+const double FIELD_LATITUDE = 42.474080;
+const double FIELD_LONGITUDE = -83.249560;
+const double RUNWAY_HEADING = 270.0;
+
+// Phase boundaries in seconds
+const double TAKEOFF_ROLL = 15.0;
+const double ROTATE = 25.0;
+const double LEVEL_OFF = 61.0;
+const double TURN = 65.0;
+const double UNDULATE = 80.0;
+
+const double CRUISE_SPEED = 15.0;  // m/s
+const double CLIMB_RATE = 3.0;     // m/s
+const double RAMP = 4.0;           // s to reach the climb rate
+const double TURN_RATE = 0.15;     // rad/s, clockwise seen from above
+const double UNDULATION = 4.0;     // m
+const double UNDULATION_PERIOD = 40.0;
+
+// Smoothstep, its derivative and its integral on [0, 1]
+double smooth(double x) {
+  if (x <= 0.0) return 0.0;
+  if (x >= 1.0) return 1.0;
+  return x * x * (3.0 - 2.0 * x);
+}
+
+double smoothSlope(double x) {
+  if (x <= 0.0 || x >= 1.0) return 0.0;
+  return 6.0 * x * (1.0 - x);
+}
+
+double smoothArea(double x) {
+  if (x <= 0.0) return 0.0;
+  if (x >= 1.0) return 0.5 + (x - 1.0);
+  return x * x * x - x * x * x * x / 2.0;
+}
+
+struct Quat {
+  double w, x, y, z;
+};
+
+Quat product(const Quat &a, const Quat &b) {
+  Quat r;
+  r.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+  r.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+  r.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+  r.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+  return r;
+}
+
+Quat axisAngle(double x, double y, double z, double angle) {
+  Quat q;
+  q.w = cos(angle / 2.0);
+  q.x = x * sin(angle / 2.0);
+  q.y = y * sin(angle / 2.0);
+  q.z = z * sin(angle / 2.0);
+  return q;
+}
+
+}
+
+FlightState flight(uint64_t now) {
+  const double t = now / 1e6;
+  FlightState s;
+
+  // Along-track speed: standing, takeoff roll, then cruise
+  double speed, along;
+  if (t < TAKEOFF_ROLL) {
+    speed = 0.0;
+    along = 0.0;
+  } else if (t < ROTATE) {
+    const double accel = CRUISE_SPEED / (ROTATE - TAKEOFF_ROLL);
+    speed = accel * (t - TAKEOFF_ROLL);
+    along = 0.5 * accel * (t - TAKEOFF_ROLL) * (t - TAKEOFF_ROLL);
+  } else {
+    speed = CRUISE_SPEED;
+    along = 0.5 * CRUISE_SPEED * (ROTATE - TAKEOFF_ROLL) + CRUISE_SPEED * (t - ROTATE);
+  }
+
+  // Vertical profile: smooth climb, level off, gentle undulation
+  const double u1 = (t - ROTATE) / RAMP;
+  const double u2 = (t - LEVEL_OFF) / RAMP;
+  s.altitude = CLIMB_RATE * RAMP * (smoothArea(u1) - smoothArea(u2));
+  s.climb = CLIMB_RATE * (smooth(u1) - smooth(u2));
+  s.verticalAccel = CLIMB_RATE / RAMP * (smoothSlope(u1) - smoothSlope(u2));
+  if (t > UNDULATE) {
+    const double w = 2.0 * M_PI / UNDULATION_PERIOD;
+    s.altitude += UNDULATION * (1.0 - cos(w * (t - UNDULATE)));
+    s.climb += UNDULATION * w * sin(w * (t - UNDULATE));
+    s.verticalAccel += UNDULATION * w * w * cos(w * (t - UNDULATE));
+  }
+
+  // Horizontal track: straight out, then circle clockwise
+  const double psi0 = RUNWAY_HEADING * M_PI / 180.0;
+  double psi, north, east, turn_rate;
+  if (t < TURN) {
+    psi = psi0;
+    turn_rate = 0.0;
+    north = along * cos(psi0);
+    east = along * sin(psi0);
+  } else {
+    const double straight = along - CRUISE_SPEED * (t - TURN);
+    const double r = CRUISE_SPEED / TURN_RATE;
+    psi = psi0 + TURN_RATE * (t - TURN);
+    turn_rate = TURN_RATE;
+    north = straight * cos(psi0) + r * (sin(psi) - sin(psi0));
+    east = straight * sin(psi0) - r * (cos(psi) - cos(psi0));
+  }
+
+  s.airspeed = speed;
+  s.groundSpeed = speed;
+  s.course = fmod(psi * 180.0 / M_PI, 360.0);
+  s.heading = s.course;
+  s.yawRate = turn_rate;
+  s.roll = atan(speed * turn_rate / GRAVITY);
+  s.pitch = speed > 1.0 ? asin(s.climb / speed) : 0.0;
+  s.latitude = FIELD_LATITUDE + north / METERS_PER_DEGREE;
+  s.longitude = FIELD_LONGITUDE +
+    east / (METERS_PER_DEGREE * cos(FIELD_LATITUDE * M_PI / 180.0));
+
+  // Attitude, world frame x north, y west, z up; body x forward, y left, z up
+  Quat q = product(axisAngle(0, 0, 1, -psi),
+                   product(axisAngle(0, 1, 0, -s.pitch), axisAngle(1, 0, 0, s.roll)));
+  s.qw = q.w;
+  s.qx = q.x;
+  s.qy = q.y;
+  s.qz = q.z;
+
+  // International standard atmosphere
+  const double h = FIELD_ELEVATION + s.altitude;
+  s.temperature = 18.0 - 0.0065 * s.altitude;
+  s.pressure = 101325.0 * pow(1.0 - h / 44330.0, 5.255);
+
+  // Battery and motor
+  double throttle = t < TAKEOFF_ROLL ? 0.0 : (t < LEVEL_OFF ? 1.0 : 0.6);
+  s.current = 0.8 + 14.0 * throttle;
+  s.voltage = 12.4 - 0.025 * s.current - 0.0004 * t;
+
+  return s;
+}
+
+void toBody(const FlightState &state, const double world[3], double body[3]) {
+  // v' = conj(q) v q
+  Quat q = { state.qw, state.qx, state.qy, state.qz };
+  Quat c = { state.qw, -state.qx, -state.qy, -state.qz };
+  Quat v = { 0.0, world[0], world[1], world[2] };
+  Quat r = product(product(c, v), q);
+  body[0] = r.x;
+  body[1] = r.y;
+  body[2] = r.z;
+}
+
+double noise(uint32_t channel, uint64_t sample) {
+  uint64_t x = sample * 0x9E3779B97F4A7C15ull + channel * 0xBF58476D1CE4E5B9ull;
+  x ^= x >> 31;
+  x *= 0x94D049BB133111EBull;
+  x ^= x >> 29;
+  return (double)(x & 0xFFFFFF) / (double)0x7FFFFF - 1.0;
+}
+
+}
@@ -0,0 +1,57 @@
+/****************************************************************************
+Reference flight used by the device models.
+
+A deterministic profile: the aircraft sits on the ground, takes off,
+climbs, flies circuits around the field and keeps circling. Every sensor
+model derives its readings from the same truth so that the telemetry can
+be checked against what actually happened.
+****************************************************************************/
+
+#ifndef SIM_FLIGHT_H
+#define SIM_FLIGHT_H
+
+#include <stdint.h>
+
+namespace sim {
+
+struct FlightState {
+  double altitude;       // m above the field
+  double climb;          // m/s
+  double verticalAccel;  // m/s^2, world frame, gravity removed
+  double airspeed;       // m/s
+  double groundSpeed;    // m/s
+  double course;         // degrees from north clockwise
+  double heading;        // degrees from north clockwise
+  double roll;           // radians
+  double pitch;          // radians
+  double yawRate;        // rad/s
+  double qw, qx, qy, qz; // body to world attitude
+  double latitude;       // degrees
+  double longitude;      // degrees
+  double temperature;    // degrees C
+  double pressure;       // Pa
+  double voltage;        // V
+  double current;        // A
+};
+
+/** Field elevation above sea level in m. */
+const double FIELD_ELEVATION = 190.0;
+
+/** Earth field at the field in uT, world frame x north, y west, z up. */
+const double MAGNETIC_FIELD[3] = { 18.66, 2.29, -53.5 };
+
+/** Standard gravity in m/s^2. */
+const double GRAVITY = 9.80665;
+
+/** Truth at the given virtual time in microseconds. */
+FlightState flight(uint64_t now);
+
+/** Rotate a world frame vector into the body frame of the given attitude. */
+void toBody(const FlightState &state, const double world[3], double body[3]);
+
+/** Small deterministic noise in [-1, 1]. */
+double noise(uint32_t channel, uint64_t sample);
+
+}
+
+#endif
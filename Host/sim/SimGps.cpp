@@ -0,0 +1,474 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "SimGps.h"
+#include "SimFlight.h"
+
+namespace sim {
+
+namespace {
+
+// Time to first fix after power-up (hot start)
+const uint64_t FIX_MICROS = 5000000;
+
+// Output starts this long after the epoch it describes
+const uint32_t OUTPUT_LATENCY_MICROS = 60000;
+
+// UTC at power-up: 2014-04-12 14:00:00.3724, microseconds into the day
+const uint64_t START_UTC_MICROS = 14 * 3600 * 1000000ull + 372400;
+const char *DATE = "120414";
+const uint16_t YEAR = 2014;
+const uint8_t MONTH = 4;
+const uint8_t DAY = 12;
+
+// The Teensy's crystal against GPS time
+const double CLOCK_DRIFT_PPM = 30.0;
+
+// GPS week, and time of week at midnight UTC that Saturday, GPS running
+// ahead of UTC by the leap seconds
+const uint16_t START_WEEK = 1788;
+const uint32_t LEAP_SECONDS = 16;
+const uint32_t DAY_TOW_SECONDS = 6 * 86400 + LEAP_SECONDS;
+
+// Timepulse length
+const uint32_t PULSE_MICROS = 100000;
+
+const uint8_t NO_PIN = 0xFF;
+
+const double KNOTS_PER_MPS = 1.943844;
+const double GEOID_SEPARATION = -34.0;
+
+// Fastest measurement rate of the NEO-6M
+const uint32_t MIN_PERIOD_MICROS = 200000;
+
+// UBX
+const uint8_t SYNC_1 = 0xB5;
+const uint8_t SYNC_2 = 0x62;
+const uint8_t NAV = 0x01;
+const uint8_t ACK = 0x05;
+const uint8_t CFG = 0x06;
+const uint8_t NMEA = 0xF0;
+const uint8_t NAV_POSLLH = 0x02;
+const uint8_t NAV_SOL = 0x06;
+const uint8_t NAV_VELNED = 0x12;
+const uint8_t NAV_TIMEUTC = 0x21;
+const uint8_t CFG_PRT = 0x00;
+const uint8_t CFG_MSG = 0x01;
+const uint8_t CFG_RATE = 0x08;
+const uint8_t NMEA_GGA = 0x00;
+const uint8_t NMEA_GLL = 0x01;
+const uint8_t NMEA_GSA = 0x02;
+const uint8_t NMEA_GSV = 0x03;
+const uint8_t NMEA_RMC = 0x04;
+const uint8_t NMEA_VTG = 0x05;
+const uint16_t PROTOCOL_UBX = 0x0001;
+const uint16_t PROTOCOL_NMEA = 0x0002;
+
+uint16_t key(uint8_t cls, uint8_t id) {
+  return (uint16_t)(cls << 8 | id);
+}
+
+void put(std::vector<uint8_t> &v, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) v.push_back((uint8_t)(value >> (8 * i)));
+}
+
+uint32_t get(const std::vector<uint8_t> &v, size_t at, int bytes) {
+  uint32_t value = 0;
+  for (int i = 0; i < bytes; i++) value |= (uint32_t)v[at + i] << (8 * i);
+  return value;
+}
+
+int32_t round32(double x) {
+  return (int32_t)floor(x + 0.5);
+}
+
+std::string format(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+std::string format(const char *fmt, ...) {
+  char buffer[128];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buffer, sizeof(buffer), fmt, args);
+  va_end(args);
+  return buffer;
+}
+
+// Virtual clock time at a UTC time, rounded up to the next microsecond
+uint64_t clockAt(uint64_t utc) {
+  return (uint64_t)ceil((utc - START_UTC_MICROS) * (1.0 + CLOCK_DRIFT_PPM * 1e-6));
+}
+
+std::string utcTime(uint64_t utc) {
+  const uint32_t centis = (uint32_t)(utc / 10000);
+  const uint32_t seconds = centis / 100;
+  return format("%02u%02u%02u.%02u", (seconds / 3600) % 24, (seconds / 60) % 60,
+                seconds % 60, centis % 100);
+}
+
+// ddmm.mmmmm,N or dddmm.mmmmm,E
+std::string coordinate(double degrees, int width, char positive, char negative) {
+  const char hemisphere = degrees < 0 ? negative : positive;
+  degrees = fabs(degrees);
+  const int whole = (int)degrees;
+  const double minutes = (degrees - whole) * 60.0;
+  return format("%0*d%08.5f,%c", width, whole, minutes, hemisphere);
+}
+
+}
+
+NeoGps::NeoGps(Uart &port)
+  : epochs(0)
+  , sentences(0)
+  , ubxMessages(0)
+  , acks(0)
+  , naks(0)
+  , port_(port)
+  , baud_(9600)
+  , next_baud_(9600)
+  , switch_countdown_(0)
+  , out_protocols_(PROTOCOL_UBX | PROTOCOL_NMEA)
+  , period_(1000000)
+  , next_epoch_utc_((START_UTC_MICROS / 1000000 + 1) * 1000000)
+  , next_epoch_(clockAt(next_epoch_utc_))
+  , pps_pin_(NO_PIN)
+  , next_edge_utc_(next_epoch_utc_)
+  , next_edge_(NEVER)
+  , next_byte_(NEVER) {
+  // Default output: the NMEA set, once per solution
+  const uint8_t defaults[] = { NMEA_GGA, NMEA_GLL, NMEA_GSA, NMEA_GSV, NMEA_RMC, NMEA_VTG };
+  for (size_t i = 0; i < sizeof(defaults); i++) rates_[key(NMEA, defaults[i])] = 1;
+  port.connect(this);
+  addDevice(this);
+}
+
+void NeoGps::receive(uint8_t c, uint32_t baud) {
+  if (baud != baud_) {
+    // Framing garbage at this end too
+    rx_.clear();
+    return;
+  }
+
+  rx_.push_back(c);
+  if (rx_[0] != SYNC_1 || (rx_.size() >= 2 && rx_[1] != SYNC_2)) {
+    // NMEA input, or noise: wait for the next sync
+    rx_.clear();
+    if (c == SYNC_1) rx_.push_back(c);
+    return;
+  }
+  if (rx_.size() < 6) return;
+
+  const size_t length = get(rx_, 4, 2);
+  if (rx_.size() < length + 8) return;
+
+  uint8_t a = 0, b = 0;
+  for (size_t i = 2; i < length + 6; i++) {
+    a += rx_[i];
+    b += a;
+  }
+  if (a == rx_[length + 6] && b == rx_[length + 7]) {
+    const std::vector<uint8_t> payload(rx_.begin() + 6, rx_.begin() + 6 + length);
+    configure(rx_[2], rx_[3], payload);
+  }
+  rx_.clear();
+}
+
+void NeoGps::setPpsPin(uint8_t pin) {
+  pps_pin_ = pin;
+  next_edge_ = clockAt(next_edge_utc_);
+}
+
+uint64_t NeoGps::utc(uint64_t now) {
+  return START_UTC_MICROS + (uint64_t)floor(now / (1.0 + CLOCK_DRIFT_PPM * 1e-6) + 0.5);
+}
+
+double NeoGps::clockDrift() {
+  return CLOCK_DRIFT_PPM;
+}
+
+uint64_t NeoGps::nextEvent() const {
+  uint64_t next = next_epoch_ < next_byte_ ? next_epoch_ : next_byte_;
+  return next_edge_ < next ? next_edge_ : next;
+}
+
+void NeoGps::update(uint64_t now) {
+  while (next_epoch_ <= now) {
+    epoch(next_epoch_, next_epoch_utc_);
+    next_epoch_utc_ += period_;
+    next_epoch_ = clockAt(next_epoch_utc_);
+  }
+
+  // Timepulse: rising at the top of each second, once there is a fix
+  while (next_edge_ <= now) {
+    if (next_edge_utc_ % 1000000 == 0) {
+      if (next_edge_ >= FIX_MICROS) writePin(pps_pin_, 1);
+      next_edge_utc_ += PULSE_MICROS;
+    } else {
+      writePin(pps_pin_, 0);
+      next_edge_utc_ += 1000000 - PULSE_MICROS;
+    }
+    next_edge_ = clockAt(next_edge_utc_);
+  }
+
+  while (next_byte_ <= now) {
+    port_.deliver(tx_.front(), baud_);
+    tx_.pop_front();
+    if (switch_countdown_ && --switch_countdown_ == 0) baud_ = next_baud_;
+    const uint32_t frame = (10000000ul + baud_ - 1) / baud_;
+    next_byte_ = tx_.empty() ? NEVER : next_byte_ + frame;
+  }
+}
+
+void NeoGps::configure(uint8_t cls, uint8_t id, const std::vector<uint8_t> &payload) {
+  if (cls != CFG) return;
+
+  switch (id) {
+    case CFG_PRT:
+      if (payload.size() <= 1) {
+        // Poll, of this port or by number; only UART 1 is modelled
+        if (payload.empty() || payload[0] == 1) {
+          std::vector<uint8_t> settings;
+          settings.push_back(1);
+          settings.push_back(0);
+          put(settings, 0, 2);
+          put(settings, 0x000008D0, 4);
+          put(settings, baud_, 4);
+          put(settings, PROTOCOL_UBX | PROTOCOL_NMEA, 2);
+          put(settings, out_protocols_, 2);
+          put(settings, 0, 4);
+          sendMessage(CFG, CFG_PRT, settings);
+        }
+        acknowledge(cls, id, true);
+      } else if (payload.size() != 20) {
+        acknowledge(cls, id, false);
+      } else if (payload[0] != 1) {
+        // Another port; nothing on it is modelled
+        acknowledge(cls, id, true);
+      } else {
+        const uint32_t baud = get(payload, 8, 4);
+        const uint16_t out = (uint16_t)get(payload, 14, 2);
+        const bool ok = baud >= 4800 && baud <= 115200;
+        acknowledge(cls, id, ok);
+        if (ok) {
+          out_protocols_ = out;
+          next_baud_ = baud;
+          switch_countdown_ = tx_.size();
+        }
+      }
+      break;
+
+    case CFG_MSG:
+      if (payload.size() != 3 && payload.size() != 8) {
+        acknowledge(cls, id, false);
+      } else if (payload[0] != NAV && payload[0] != NMEA) {
+        acknowledge(cls, id, false);
+      } else {
+        // The long form has a rate per port; UART 1 is the second
+        rates_[key(payload[0], payload[1])] = payload.size() == 3 ? payload[2] : payload[3];
+        acknowledge(cls, id, true);
+      }
+      break;
+
+    case CFG_RATE: {
+      const uint32_t period = payload.size() == 6 ? get(payload, 0, 2) * 1000u : 0;
+      const bool ok = period >= MIN_PERIOD_MICROS && get(payload, 2, 2) == 1;
+      acknowledge(cls, id, ok);
+      if (ok) {
+        period_ = period;
+        // Epochs stay aligned to whole multiples of the period
+        next_epoch_utc_ = (utc(now()) / period_ + 1) * period_;
+        next_epoch_ = clockAt(next_epoch_utc_);
+      }
+      break;
+    }
+
+    default:
+      acknowledge(cls, id, false);
+      break;
+  }
+}
+
+void NeoGps::acknowledge(uint8_t cls, uint8_t id, bool ok) {
+  std::vector<uint8_t> payload;
+  payload.push_back(cls);
+  payload.push_back(id);
+  sendMessage(ACK, ok ? 0x01 : 0x00, payload);
+  if (ok) acks++;
+  else naks++;
+}
+
+bool NeoGps::due(uint8_t cls, uint8_t id) const {
+  const std::map<uint16_t, uint8_t>::const_iterator i = rates_.find(key(cls, id));
+  const uint16_t protocol = cls == NMEA ? PROTOCOL_NMEA : PROTOCOL_UBX;
+  return (out_protocols_ & protocol) && i != rates_.end() && i->second &&
+         epochs % i->second == 0;
+}
+
+void NeoGps::epoch(uint64_t now, uint64_t utc) {
+  if (tx_.empty()) {
+    next_byte_ = now + OUTPUT_LATENCY_MICROS;
+  }
+  sendNmea(now, utc);
+  sendUbx(now, utc);
+  epochs++;
+}
+
+void NeoGps::sendNmea(uint64_t now, uint64_t utc) {
+  const FlightState s = flight(now);
+  const bool fix = now >= FIX_MICROS;
+  const std::string time = utcTime(utc);
+  const double knots = s.groundSpeed * KNOTS_PER_MPS;
+  const std::string lat = coordinate(s.latitude, 2, 'N', 'S');
+  const std::string lon = coordinate(s.longitude, 3, 'E', 'W');
+  const double msl = FIELD_ELEVATION + s.altitude;
+
+  if (due(NMEA, NMEA_RMC)) {
+    if (fix) {
+      sendSentence("GPRMC," + time + ",A," + lat + "," + lon +
+                   format(",%.3f,%.2f,", knots, s.course) + DATE + ",,,A");
+    } else {
+      sendSentence("GPRMC," + time + ",V,,,,,,," + DATE + ",,,N");
+    }
+  }
+  if (due(NMEA, NMEA_VTG)) {
+    if (fix) {
+      sendSentence(format("GPVTG,%.2f,T,,M,%.3f,N,%.3f,K,A",
+                          s.course, knots, s.groundSpeed * 3.6));
+    } else {
+      sendSentence("GPVTG,,,,,,,,,N");
+    }
+  }
+  if (due(NMEA, NMEA_GGA)) {
+    if (fix) {
+      sendSentence("GPGGA," + time + "," + lat + "," + lon +
+                   format(",1,08,1.01,%.1f,M,%.1f,M,,", msl, GEOID_SEPARATION));
+    } else {
+      sendSentence("GPGGA," + time + ",,,,,0,00,99.99,,,,,,");
+    }
+  }
+  if (due(NMEA, NMEA_GSA)) {
+    if (fix) {
+      sendSentence("GPGSA,A,3,04,05,09,12,24,25,29,31,,,,,1.85,1.01,1.55");
+    } else {
+      sendSentence("GPGSA,A,1,,,,,,,,,,,,,99.99,99.99,99.99");
+    }
+  }
+  if (due(NMEA, NMEA_GSV)) {
+    sendSentence("GPGSV,3,1,12,04,67,284,42,05,21,061,36,09,33,191,39,12,45,087,40");
+    sendSentence("GPGSV,3,2,12,17,09,320,,24,12,038,31,25,58,305,44,29,27,123,38");
+    sendSentence("GPGSV,3,3,12,31,19,247,35,33,32,213,,39,31,220,,40,12,107,");
+  }
+  if (due(NMEA, NMEA_GLL)) {
+    if (fix) {
+      sendSentence("GPGLL," + lat + "," + lon + "," + time + ",A,A");
+    } else {
+      sendSentence("GPGLL,,,,," + time + ",V,N");
+    }
+  }
+}
+
+void NeoGps::sendUbx(uint64_t now, uint64_t utc) {
+  const FlightState s = flight(now);
+  const bool fix = now >= FIX_MICROS;
+  const uint32_t tow = (uint32_t)(DAY_TOW_SECONDS * 1000ull + utc / 1000);
+  const double msl = FIELD_ELEVATION + s.altitude;
+  const double course = s.course * M_PI / 180.0;
+  std::vector<uint8_t> p;
+
+  if (due(NAV, NAV_POSLLH)) {
+    p.clear();
+    put(p, tow, 4);
+    put(p, fix ? round32(s.longitude * 1e7) : 0, 4);
+    put(p, fix ? round32(s.latitude * 1e7) : 0, 4);
+    put(p, fix ? round32((msl + GEOID_SEPARATION) * 1e3) : 0, 4);
+    put(p, fix ? round32(msl * 1e3) : 0, 4);
+    put(p, fix ? 2500 : 0xFFFFFFFF, 4);
+    put(p, fix ? 3800 : 0xFFFFFFFF, 4);
+    sendMessage(NAV, NAV_POSLLH, p);
+  }
+  if (due(NAV, NAV_VELNED)) {
+    p.clear();
+    const double climb = fix ? s.climb : 0.0;
+    const double ground = fix ? s.groundSpeed : 0.0;
+    put(p, tow, 4);
+    put(p, round32(ground * cos(course) * 100.0), 4);
+    put(p, round32(ground * sin(course) * 100.0), 4);
+    put(p, round32(-climb * 100.0), 4);
+    put(p, round32(sqrt(ground * ground + climb * climb) * 100.0), 4);
+    put(p, round32(ground * 100.0), 4);
+    put(p, fix ? round32(s.course * 1e5) : 0, 4);
+    put(p, fix ? 40 : 2000, 4);
+    put(p, fix ? 150000 : 18000000, 4);
+    sendMessage(NAV, NAV_VELNED, p);
+  }
+  if (due(NAV, NAV_SOL)) {
+    p.clear();
+    put(p, tow, 4);
+    put(p, 0, 4);                 // fTOW
+    put(p, START_WEEK, 2);
+    p.push_back(fix ? 3 : 0);     // gpsFix
+    p.push_back(fix ? 0x0D : 0x0C);  // gpsFixOK, WKNSET, TOWSET
+    for (int i = 0; i < 3; i++) put(p, 0, 4);   // ECEF position, not modelled
+    put(p, fix ? 450 : 650000, 4);
+    for (int i = 0; i < 3; i++) put(p, 0, 4);   // ECEF velocity
+    put(p, fix ? 40 : 2000, 4);
+    put(p, fix ? 185 : 9999, 2);
+    p.push_back(0);
+    p.push_back(fix ? 8 : 0);
+    put(p, 0, 4);
+    sendMessage(NAV, NAV_SOL, p);
+  }
+  if (due(NAV, NAV_TIMEUTC)) {
+    const uint32_t seconds = (uint32_t)(utc / 1000000);
+    p.clear();
+    put(p, tow, 4);
+    put(p, fix ? 50 : 0xFFFFFFFF, 4);  // tAcc, ns
+    put(p, (uint32_t)(utc % 1000000) * 1000, 4);  // nano
+    put(p, YEAR, 2);
+    p.push_back(MONTH);
+    p.push_back(DAY);
+    p.push_back(seconds / 3600);
+    p.push_back(seconds / 60 % 60);
+    p.push_back(seconds % 60);
+    p.push_back(fix ? 0x07 : 0x00);    // validTOW, validWKN, validUTC
+    sendMessage(NAV, NAV_TIMEUTC, p);
+  }
+}
+
+void NeoGps::sendSentence(const std::string &body) {
+  uint8_t checksum = 0;
+  for (size_t i = 0; i < body.size(); i++) checksum ^= (uint8_t)body[i];
+
+  const std::string sentence = "$" + body + format("*%02X\r\n", checksum);
+  queue((const uint8_t *)sentence.data(), sentence.size());
+  sentences++;
+}
+
+void NeoGps::sendMessage(uint8_t cls, uint8_t id, const std::vector<uint8_t> &payload) {
+  std::vector<uint8_t> m;
+  m.push_back(SYNC_1);
+  m.push_back(SYNC_2);
+  m.push_back(cls);
+  m.push_back(id);
+  put(m, (uint32_t)payload.size(), 2);
+  m.insert(m.end(), payload.begin(), payload.end());
+
+  uint8_t a = 0, b = 0;
+  for (size_t i = 2; i < m.size(); i++) {
+    a += m[i];
+    b += a;
+  }
+  m.push_back(a);
+  m.push_back(b);
+  queue(&m[0], m.size());
+  ubxMessages++;
+}
+
+void NeoGps::queue(const uint8_t *data, size_t length) {
+  if (tx_.empty() && next_byte_ == NEVER) {
+    next_byte_ = now() + (10000000ul + baud_ - 1) / baud_;
+  }
+  tx_.insert(tx_.end(), data, data + length);
+}
+
+}
@@ -0,0 +1,96 @@
+/****************************************************************************
+u-blox NEO-6M model.
+
+Out of the box the receiver talks NMEA at 9600 baud and sends the default
+message set (RMC, VTG, GGA, GSA, GSV, GLL) once per second, a little after
+each navigation epoch. Bytes leave at the port's frame rate, so a 64 byte
+receive buffer that is only drained every 200 ms overruns just as it does on
+the bench. The position follows the reference flight once the receiver has
+a fix.
+
+The port also takes UBX configuration: CFG-PRT reports or changes the
+baud rate and the output protocols, CFG-MSG sets how often each NMEA sentence or
+NAV-POSLLH, NAV-VELNED, NAV-SOL and NAV-TIMEUTC goes out, and CFG-RATE sets the
+measurement period down to 200 ms, the NEO-6M's 5 Hz limit. Each is
+answered with ACK-ACK, or ACK-NAK if it is malformed or out of range. A new
+baud rate takes effect once the acknowledgement has been sent. Bytes sent
+at any other baud rate are lost, as on the real port.
+
+Epochs fall on whole multiples of the period in UTC, which is not the
+virtual clock: that is the Teensy's, whose crystal runs CLOCK_DRIFT_PPM
+fast, and power-up is partway into a UTC second. With a fix the timepulse
+output, if connected, goes high for 100 ms at the top of every UTC second.
+****************************************************************************/
+
+#ifndef SIM_GPS_H
+#define SIM_GPS_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "SimUart.h"
+
+namespace sim {
+
+class NeoGps : public Device, public UartPeer {
+ public:
+  explicit NeoGps(Uart &port);
+
+  /** Bytes from the host. */
+  void receive(uint8_t c, uint32_t baud);
+
+  uint64_t nextEvent() const;
+  void update(uint64_t now);
+
+  /** Connect the timepulse output to an MCU pin. */
+  void setPpsPin(uint8_t pin);
+
+  /** UTC at a time on the virtual clock, in microseconds into the day. */
+  static uint64_t utc(uint64_t now);
+
+  /** How fast the virtual clock runs against UTC, in ppm. */
+  static double clockDrift();
+
+  uint32_t baud() const { return baud_; }
+  uint32_t period() const { return period_; }
+
+  // Statistics
+  uint32_t epochs;
+  uint32_t sentences;     // NMEA
+  uint32_t ubxMessages;   // sent
+  uint32_t acks;
+  uint32_t naks;
+
+ private:
+  void epoch(uint64_t now, uint64_t utc);
+  bool due(uint8_t cls, uint8_t id) const;
+  void sendNmea(uint64_t now, uint64_t utc);
+  void sendUbx(uint64_t now, uint64_t utc);
+  void sendSentence(const std::string &body);
+  void sendMessage(uint8_t cls, uint8_t id, const std::vector<uint8_t> &payload);
+  void configure(uint8_t cls, uint8_t id, const std::vector<uint8_t> &payload);
+  void acknowledge(uint8_t cls, uint8_t id, bool ok);
+  void queue(const uint8_t *data, size_t length);
+
+  Uart &port_;
+  uint32_t baud_;
+  uint32_t next_baud_;
+  size_t switch_countdown_;    // bytes to send before next_baud_ applies
+  uint16_t out_protocols_;
+  uint32_t period_;
+  uint64_t next_epoch_utc_;
+  uint64_t next_epoch_;
+  uint8_t pps_pin_;
+  uint64_t next_edge_utc_;
+  uint64_t next_edge_;
+  uint64_t next_byte_;
+  std::map<uint16_t, uint8_t> rates_;
+  std::deque<uint8_t> tx_;
+  std::vector<uint8_t> rx_;
+};
+
+}
+
+#endif
@@ -0,0 +1,113 @@
+#include "SimGpsScript.h"
+
+namespace sim {
+
+namespace {
+
+// Time from the end of a message to the start of the answer
+const uint32_t ANSWER_LATENCY_MICROS = 2000;
+
+const uint8_t SYNC_1 = 0xB5;
+const uint8_t SYNC_2 = 0x62;
+const uint8_t ACK = 0x05;
+const uint8_t ACK_NAK = 0x00;
+const uint8_t ACK_ACK = 0x01;
+
+}
+
+GpsScript::GpsScript(Uart &port, uint32_t baud, const ScriptStep *steps, size_t count)
+  : messages(0)
+  , unexpected(0)
+  , port_(port)
+  , baud_(baud)
+  , next_baud_(baud)
+  , switch_countdown_(0)
+  , steps_(steps)
+  , count_(count)
+  , step_(0)
+  , next_byte_(NEVER) {
+  port.connect(this);
+  addDevice(this);
+}
+
+void GpsScript::receive(uint8_t c, uint32_t baud) {
+  if (baud != baud_) {
+    rx_.clear();
+    return;
+  }
+
+  rx_.push_back(c);
+  if (rx_[0] != SYNC_1 || (rx_.size() >= 2 && rx_[1] != SYNC_2)) {
+    rx_.clear();
+    if (c == SYNC_1) rx_.push_back(c);
+    return;
+  }
+  if (rx_.size() < 6) return;
+
+  const size_t length = rx_[4] | rx_[5] << 8;
+  if (rx_.size() < length + 8) return;
+
+  uint8_t a = 0, b = 0;
+  for (size_t i = 2; i < length + 6; i++) {
+    a += rx_[i];
+    b += a;
+  }
+  if (a == rx_[length + 6] && b == rx_[length + 7]) {
+    messages++;
+    answer(rx_[2], rx_[3]);
+  }
+  rx_.clear();
+}
+
+void GpsScript::answer(uint8_t cls, uint8_t id) {
+  if (step_ == count_) {
+    send(ACK_ACK, cls, id);
+    return;
+  }
+
+  const ScriptStep &step = steps_[step_];
+  if (cls != step.cls || id != step.id) {
+    unexpected++;
+    send(ACK_NAK, cls, id);
+    return;
+  }
+
+  step_++;
+  if (step.reply != REPLY_NONE) {
+    send(step.reply == REPLY_ACK ? ACK_ACK : ACK_NAK, cls, id);
+  }
+  if (step.baud) {
+    next_baud_ = step.baud;
+    switch_countdown_ = tx_.size();
+    if (!switch_countdown_) baud_ = next_baud_;
+  }
+}
+
+void GpsScript::send(uint8_t id, uint8_t cls, uint8_t ackedId) {
+  const uint8_t message[] = { SYNC_1, SYNC_2, ACK, id, 2, 0, cls, ackedId };
+  uint8_t a = 0, b = 0;
+  for (size_t i = 2; i < sizeof(message); i++) {
+    a += message[i];
+    b += a;
+  }
+
+  if (tx_.empty()) next_byte_ = now() + ANSWER_LATENCY_MICROS;
+  tx_.insert(tx_.end(), message, message + sizeof(message));
+  tx_.push_back(a);
+  tx_.push_back(b);
+}
+
+uint64_t GpsScript::nextEvent() const {
+  return next_byte_;
+}
+
+void GpsScript::update(uint64_t now) {
+  while (next_byte_ <= now) {
+    port_.deliver(tx_.front(), baud_);
+    tx_.pop_front();
+    if (switch_countdown_ && --switch_countdown_ == 0) baud_ = next_baud_;
+    next_byte_ = tx_.empty() ? NEVER : next_byte_ + (10000000ul + baud_ - 1) / baud_;
+  }
+}
+
+}
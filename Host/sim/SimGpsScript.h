@@ -0,0 +1,74 @@
+/****************************************************************************
+Scripted stand-in for the GPS receiver.
+
+Plays a fixed conversation rather than modelling the receiver: each step
+names the UBX message the host should send next, whether to answer it
+with ACK-ACK, ACK-NAK or not at all, and optionally a baud rate to move to
+afterwards. Bytes sent at any baud rate but the stand-in's own are lost,
+as on the wire, and do not move the script on. A message out of turn is
+counted and answered with ACK-NAK. Once the script is done every message
+is answered with ACK-ACK.
+
+Used to check the GPS startup against receivers in states the NEO-6M model
+does not reach by itself.
+****************************************************************************/
+
+#ifndef SIM_GPS_SCRIPT_H
+#define SIM_GPS_SCRIPT_H
+
+#include <deque>
+#include <vector>
+
+#include "SimUart.h"
+
+namespace sim {
+
+enum ScriptReply {
+  REPLY_ACK,
+  REPLY_NAK,
+  REPLY_NONE
+};
+
+struct ScriptStep {
+  uint8_t cls;          // UBX class and id expected from the host
+  uint8_t id;
+  ScriptReply reply;
+  uint32_t baud;        // move to this baud rate after answering, 0 to stay
+};
+
+class GpsScript : public Device, public UartPeer {
+ public:
+  GpsScript(Uart &port, uint32_t baud, const ScriptStep *steps, size_t count);
+
+  /** Bytes from the host. */
+  void receive(uint8_t c, uint32_t baud);
+
+  uint64_t nextEvent() const;
+  void update(uint64_t now);
+
+  uint32_t baud() const { return baud_; }
+  bool finished() const { return step_ == count_; }
+
+  // Statistics
+  uint32_t messages;    // received at the right baud rate, good checksum
+  uint32_t unexpected;  // out of turn
+
+ private:
+  void answer(uint8_t cls, uint8_t id);
+  void send(uint8_t id, uint8_t cls, uint8_t ackedId);
+
+  Uart &port_;
+  uint32_t baud_;
+  uint32_t next_baud_;
+  size_t switch_countdown_;
+  const ScriptStep *steps_;
+  size_t count_;
+  size_t step_;
+  uint64_t next_byte_;
+  std::deque<uint8_t> tx_;
+  std::vector<uint8_t> rx_;
+};
+
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include <string.h>
+
+#include <vector>
+
+#include "SimI2C.h"
+
+namespace sim {
+
+I2CBus i2c;
+
+void RegisterDevice::i2cWrite(const uint8_t *data, size_t length) {
+  if (length == 0) return;
+  pointer_ = data[0];
+  for (size_t i = 1; i < length; i++) {
+    writeRegister(pointer_, data[i]);
+    if (autoIncrement(pointer_)) pointer_++;
+  }
+}
+
+void RegisterDevice::i2cRead(uint8_t *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    data[i] = readRegister(pointer_);
+    if (autoIncrement(pointer_)) pointer_++;
+  }
+}
+
+I2CBus::I2CBus()
+  : clock_hz_(100000)
+  , held_(false) {
+  memset(devices_, 0, sizeof(devices_));
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+void I2CBus::attach(uint8_t address, I2CDevice *device) {
+  devices_[address & 0x7F] = device;
+}
+
+I2CDevice *I2CBus::find(uint8_t address) const {
+  I2CDevice *device = devices_[address & 0x7F];
+  return device && device->present() ? device : 0;
+}
+
+void I2CBus::start(uint8_t address) {
+  if (!held_) stats_.transactions++;
+  stats_.starts++;
+  stats_.transactionsTo[address & 0x7F]++;
+}
+
+void I2CBus::finish(uint64_t micros, bool stop) {
+  held_ = !stop;
+  stats_.busyMicros += micros;
+}
+
+uint64_t I2CBus::transferMicros(uint8_t address, size_t length, bool stop) const {
+  // The address byte is always clocked out; a NACK ends the transfer there.
+  // START (or repeated START) and STOP each take about one bit time.
+  uint64_t bits = 9 + 1;
+  if (find(address)) {
+    bits += 9 * length;
+    if (stop) bits += 1;
+  } else {
+    bits += 1;
+  }
+  return (bits * 1000000ull + clock_hz_ - 1) / clock_hz_;
+}
+
+uint8_t I2CBus::write(uint8_t address, const uint8_t *data, size_t length, bool stop) {
+  advance(transferMicros(address, length, stop));
+  return writeNow(address, data, length, stop) ? 0 : 2;
+}
+
+size_t I2CBus::read(uint8_t address, uint8_t *data, size_t length, bool stop) {
+  advance(transferMicros(address, length, stop));
+  return readNow(address, data, length, stop) ? length : 0;
+}
+
+bool I2CBus::writeNow(uint8_t address, const uint8_t *data, size_t length, bool stop) {
+  const uint64_t micros = transferMicros(address, length, stop);
+  start(address);
+
+  I2CDevice *device = find(address);
+  if (!device) {
+    stats_.nacks++;
+    finish(micros, true);
+    return false;
+  }
+
+  stats_.bytes += length;
+  finish(micros, stop);
+  device->i2cWrite(data, length);
+  return true;
+}
+
+bool I2CBus::readNow(uint8_t address, uint8_t *data, size_t length, bool stop) {
+  const uint64_t micros = transferMicros(address, length, stop);
+  start(address);
+
+  I2CDevice *device = find(address);
+  if (!device) {
+    stats_.nacks++;
+    finish(micros, true);
+    return false;
+  }
+
+  stats_.bytes += length;
+  finish(micros, stop);
+  device->i2cRead(data, length);
+  return true;
+}
+
+I2CController::I2CController(I2CBus &bus, uint8_t irq)
+  : bus_(bus)
+  , irq_(irq)
+  , address_(0)
+  , read_(false)
+  , stop_(true)
+  , head_(0)
+  , head_length_(0)
+  , tx_(0)
+  , tx_length_(0)
+  , rx_(0)
+  , rx_length_(0)
+  , done_(NEVER)
+  , acked_(false) {
+  addDevice(this);
+}
+
+void I2CController::startWrite(uint8_t address, const uint8_t *head, size_t headLength,
+                               const uint8_t *data, size_t length, bool stop) {
+  address_ = address;
+  read_ = false;
+  stop_ = stop;
+  head_ = head;
+  head_length_ = headLength;
+  tx_ = data;
+  tx_length_ = length;
+  done_ = now() + bus_.transferMicros(address, headLength + length, stop);
+}
+
+void I2CController::startRead(uint8_t address, uint8_t *data, size_t length, bool stop) {
+  address_ = address;
+  read_ = true;
+  stop_ = stop;
+  rx_ = data;
+  rx_length_ = length;
+  done_ = now() + bus_.transferMicros(address, length, stop);
+}
+
+void I2CController::update(uint64_t now) {
+  if (now < done_) return;
+
+  done_ = NEVER;
+  if (read_) {
+    acked_ = bus_.readNow(address_, rx_, rx_length_, stop_);
+  } else {
+    std::vector<uint8_t> bytes(head_, head_ + head_length_);
+    bytes.insert(bytes.end(), tx_, tx_ + tx_length_);
+    acked_ = bus_.writeNow(address_, bytes.data(), bytes.size(), stop_);
+  }
+  raiseIrq(irq_);
+}
+
+}
@@ -0,0 +1,159 @@
+/****************************************************************************
+I2C bus model behind the host Wire object.
+
+Every transfer charges its bit time at the configured bus clock and is
+counted, so bus traffic per telemetry frame can be measured. A transaction
+is everything between a START and a STOP; a repeated START continues the
+current transaction.
+****************************************************************************/
+
+#ifndef SIM_I2C_H
+#define SIM_I2C_H
+
+#include "Sim.h"
+
+namespace sim {
+
+/**
+ * A slave on the bus.
+ */
+class I2CDevice {
+ public:
+  virtual ~I2CDevice() {}
+
+  /** False while the device does not answer its address (e.g. gated). */
+  virtual bool present() const { return true; }
+
+  /** Master wrote length bytes in one addressed transfer. */
+  virtual void i2cWrite(const uint8_t *data, size_t length) = 0;
+
+  /** Master reads length bytes in one addressed transfer. */
+  virtual void i2cRead(uint8_t *data, size_t length) = 0;
+};
+
+/**
+ * A slave with the usual register pointer: the first byte written selects a
+ * register and every further byte written or read moves it forward.
+ */
+class RegisterDevice : public I2CDevice {
+ public:
+  RegisterDevice() : pointer_(0) {}
+
+  void i2cWrite(const uint8_t *data, size_t length);
+  void i2cRead(uint8_t *data, size_t length);
+
+ protected:
+  virtual uint8_t readRegister(uint8_t reg) = 0;
+  virtual void writeRegister(uint8_t reg, uint8_t value) = 0;
+
+  /** Whether the pointer advances past this register (not for FIFOs). */
+  virtual bool autoIncrement(uint8_t reg) const { return true; }
+
+  uint8_t pointer_;
+};
+
+class I2CBus {
+ public:
+  struct Stats {
+    uint32_t transactions;
+    uint32_t starts;
+    uint32_t bytes;
+    uint32_t nacks;
+    uint64_t busyMicros;
+    uint32_t transactionsTo[128];
+  };
+
+  I2CBus();
+
+  void attach(uint8_t address, I2CDevice *device);
+  void setClock(uint32_t hz) { clock_hz_ = hz; }
+  uint32_t clock() const { return clock_hz_; }
+
+  /**
+   * Addressed write.
+   * @return 0 on success, 2 if the address was not acknowledged
+   */
+  uint8_t write(uint8_t address, const uint8_t *data, size_t length, bool stop);
+
+  /**
+   * Addressed read.
+   * @return Number of bytes read, 0 if the address was not acknowledged
+   */
+  size_t read(uint8_t address, uint8_t *data, size_t length, bool stop);
+
+  /** Bus time of an addressed transfer of length bytes, as charged. */
+  uint64_t transferMicros(uint8_t address, size_t length, bool stop) const;
+
+  /**
+   * write() and read() without the wait, for a controller model that keeps
+   * the time itself. Counted the same.
+   * @return False if the address was not acknowledged
+   */
+  bool writeNow(uint8_t address, const uint8_t *data, size_t length, bool stop);
+  bool readNow(uint8_t address, uint8_t *data, size_t length, bool stop);
+
+  const Stats &stats() const { return stats_; }
+
+ private:
+  I2CDevice *find(uint8_t address) const;
+  void start(uint8_t address);
+  void finish(uint64_t micros, bool stop);
+
+  I2CDevice *devices_[128];
+  uint32_t clock_hz_;
+  bool held_;
+  Stats stats_;
+};
+
+extern I2CBus i2c;
+
+/**
+ * Interrupt driven bus master, the Teensy's I2C0 as the transfer queue runs
+ * it: a transfer is clocked out while the firmware goes on, and the
+ * controller raises its interrupt once the bus time write() or read() would
+ * have blocked for has passed. The slave sees the data at that point, as it
+ * does with write() and read().
+ */
+class I2CController : public Device {
+ public:
+  I2CController(I2CBus &bus, uint8_t irq);
+
+  /**
+   * head then data, so a register address needs no copy in front. Both
+   * are read when the transfer finishes, like the bytes of a real one as
+   * they go out.
+   */
+  void startWrite(uint8_t address, const uint8_t *head, size_t headLength,
+                  const uint8_t *data, size_t length, bool stop);
+  void startRead(uint8_t address, uint8_t *data, size_t length, bool stop);
+
+  /** Drop the transfer on the bus without an interrupt. */
+  void abort() { done_ = NEVER; }
+
+  bool busy() const { return done_ != NEVER; }
+
+  /** Whether the last transfer to finish was acknowledged. */
+  bool acked() const { return acked_; }
+
+  uint64_t nextEvent() const { return done_; }
+  void update(uint64_t now);
+
+ private:
+  I2CBus &bus_;
+  uint8_t irq_;
+  uint8_t address_;
+  bool read_;
+  bool stop_;
+  const uint8_t *head_;
+  size_t head_length_;
+  const uint8_t *tx_;
+  size_t tx_length_;
+  uint8_t *rx_;
+  size_t rx_length_;
+  uint64_t done_;
+  bool acked_;
+};
+
+}
+
+#endif
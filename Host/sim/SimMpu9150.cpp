@@ -0,0 +1,374 @@
+#include <math.h>
+#include <string.h>
+
+#include "SimMpu9150.h"
+#include "SimFlight.h"
+
+namespace sim {
+
+namespace {
+
+const uint8_t NO_PIN = 0xFF;
+
+const uint8_t REG_SMPLRT_DIV = 0x19;
+const uint8_t REG_CONFIG = 0x1A;
+const uint8_t REG_GYRO_CONFIG = 0x1B;
+const uint8_t REG_ACCEL_CONFIG = 0x1C;
+const uint8_t REG_I2C_SLV0_ADDR = 0x25;
+const uint8_t REG_I2C_SLV4_CTRL = 0x34;
+const uint8_t REG_INT_PIN_CFG = 0x37;
+const uint8_t REG_INT_ENABLE = 0x38;
+const uint8_t REG_INT_STATUS = 0x3A;
+const uint8_t REG_ACCEL_XOUT_H = 0x3B;
+const uint8_t REG_TEMP_OUT_H = 0x41;
+const uint8_t REG_GYRO_XOUT_H = 0x43;
+const uint8_t REG_EXT_SENS_DATA_00 = 0x49;
+const uint8_t REG_I2C_SLV0_DO = 0x63;
+const uint8_t REG_I2C_MST_DELAY_CTRL = 0x67;
+const uint8_t REG_USER_CTRL = 0x6A;
+const uint8_t REG_PWR_MGMT_1 = 0x6B;
+const uint8_t REG_BANK_SEL = 0x6D;
+const uint8_t REG_MEM_START_ADDR = 0x6E;
+const uint8_t REG_MEM_R_W = 0x6F;
+const uint8_t REG_FIFO_COUNTH = 0x72;
+const uint8_t REG_FIFO_COUNTL = 0x73;
+const uint8_t REG_FIFO_R_W = 0x74;
+const uint8_t REG_WHO_AM_I = 0x75;
+
+const uint8_t USER_CTRL_DMP_EN = 0x80;
+const uint8_t USER_CTRL_FIFO_EN = 0x40;
+const uint8_t USER_CTRL_I2C_MST_EN = 0x20;
+const uint8_t USER_CTRL_RESETS = 0x0F;
+const uint8_t USER_CTRL_FIFO_RESET = 0x04;
+
+const uint8_t PWR1_DEVICE_RESET = 0x80;
+const uint8_t PWR1_SLEEP = 0x40;
+
+const uint8_t INT_CFG_LEVEL = 0x80;
+const uint8_t INT_CFG_LATCH = 0x20;
+const uint8_t INT_CFG_RD_CLEAR = 0x10;
+const uint8_t INT_CFG_BYPASS = 0x02;
+
+const uint8_t INT_FIFO_OFLOW = 0x10;
+const uint8_t INT_DMP = 0x02;
+const uint8_t INT_DATA_RDY = 0x01;
+
+const uint32_t INT_PULSE_MICROS = 50;
+
+// Address of the DMP FIFO rate divider (D_0_22) in DMP memory
+const uint16_t DMP_FIFO_RATE = 0x216;
+
+const double DEG_PER_RAD = 180.0 / M_PI;
+
+void put16(uint8_t *p, int32_t value) {
+  if (value > 32767) value = 32767;
+  if (value < -32768) value = -32768;
+  p[0] = (uint8_t)(value >> 8);
+  p[1] = (uint8_t)value;
+}
+
+void put32(uint8_t *p, int32_t value) {
+  p[0] = (uint8_t)(value >> 24);
+  p[1] = (uint8_t)(value >> 16);
+  p[2] = (uint8_t)(value >> 8);
+  p[3] = (uint8_t)value;
+}
+
+// Specific force (what an accelerometer feels) in g, body frame
+void specificForce(const FlightState &s, double body[3]) {
+  const double psi = s.course / DEG_PER_RAD;
+  const double turn = s.groundSpeed * s.yawRate;
+  double world[3];
+  world[0] = -turn * sin(psi);
+  world[1] = -turn * cos(psi);
+  world[2] = s.verticalAccel + GRAVITY;
+  toBody(s, world, body);
+  for (int i = 0; i < 3; i++) body[i] /= GRAVITY;
+}
+
+// I2C_SLVx_BYTE_SW: swaps the bytes of each word read from a slave. Words
+// start at even register addresses, or odd ones with I2C_SLVx_GRP set.
+void swapPairs(uint8_t *data, uint8_t length, uint8_t reg, bool odd_first) {
+  for (uint8_t i = (reg & 1) == (odd_first ? 1 : 0) ? 0 : 1; i + 1 < length; i += 2) {
+    const uint8_t first = data[i];
+    data[i] = data[i + 1];
+    data[i + 1] = first;
+  }
+}
+
+// Angular rate in degrees per second, body frame
+void angularRate(const FlightState &s, double body[3]) {
+  const double world[3] = { 0.0, 0.0, -s.yawRate * DEG_PER_RAD };
+  toBody(s, world, body);
+}
+
+}
+
+Mpu9150::Mpu9150()
+  : samples(0)
+  , dmpPackets(0)
+  , fifoOverflows(0)
+  , auxTransactions(0)
+  , int_pin_(NO_PIN)
+  , int_release_(NEVER) {
+  memset(aux_, 0, sizeof(aux_));
+  reset();
+  addDevice(this);
+  i2c.attach(ADDRESS, this);
+}
+
+void Mpu9150::reset() {
+  memset(regs_, 0, sizeof(regs_));
+  memset(memory_, 0, sizeof(memory_));
+  regs_[REG_PWR_MGMT_1] = PWR1_SLEEP;
+  regs_[REG_WHO_AM_I] = ADDRESS;
+  fifo_.clear();
+  next_sample_ = NEVER;
+  dmp_divider_ = 0;
+  aux_divider_ = 0;
+  int_release_ = NEVER;
+  setIntPin(false);
+}
+
+void Mpu9150::attachAux(uint8_t address, I2CDevice *device) {
+  aux_[address & 0x7F] = device;
+}
+
+bool Mpu9150::bypassEnabled() const {
+  return (regs_[REG_INT_PIN_CFG] & INT_CFG_BYPASS) &&
+    !(regs_[REG_USER_CTRL] & USER_CTRL_I2C_MST_EN);
+}
+
+bool Mpu9150::autoIncrement(uint8_t reg) const {
+  return reg != REG_FIFO_R_W && reg != REG_MEM_R_W;
+}
+
+uint8_t Mpu9150::readRegister(uint8_t reg) {
+  reg &= 0x7F;
+  const uint8_t cfg = regs_[REG_INT_PIN_CFG];
+  if ((cfg & INT_CFG_RD_CLEAR) && (cfg & INT_CFG_LATCH)) setIntPin(false);
+
+  switch (reg) {
+    case REG_INT_STATUS: {
+      uint8_t status = regs_[REG_INT_STATUS];
+      regs_[REG_INT_STATUS] = 0;
+      if (cfg & INT_CFG_LATCH) setIntPin(false);
+      return status;
+    }
+
+    case REG_FIFO_COUNTH:
+      return (uint8_t)(fifo_.size() >> 8);
+
+    case REG_FIFO_COUNTL:
+      return (uint8_t)fifo_.size();
+
+    case REG_FIFO_R_W: {
+      if (fifo_.empty()) return 0;
+      uint8_t c = fifo_.front();
+      fifo_.pop_front();
+      return c;
+    }
+
+    case REG_MEM_R_W: {
+      const uint8_t bank = regs_[REG_BANK_SEL] & 0x1F;
+      const uint8_t address = regs_[REG_MEM_START_ADDR]++;
+      return bank < 8 ? memory_[bank * 256 + address] : 0;
+    }
+
+    default:
+      return regs_[reg];
+  }
+}
+
+void Mpu9150::writeRegister(uint8_t reg, uint8_t value) {
+  reg &= 0x7F;
+
+  switch (reg) {
+    case REG_PWR_MGMT_1:
+      if (value & PWR1_DEVICE_RESET) {
+        reset();
+        return;
+      }
+      regs_[reg] = value;
+      if (value & PWR1_SLEEP) {
+        next_sample_ = NEVER;
+      } else if (next_sample_ == NEVER) {
+        next_sample_ = now() + samplePeriod();
+      }
+      return;
+
+    case REG_USER_CTRL:
+      if (value & USER_CTRL_FIFO_RESET) fifo_.clear();
+      regs_[reg] = value & ~USER_CTRL_RESETS;
+      return;
+
+    case REG_FIFO_R_W:
+      if (fifo_.size() < FIFO_SIZE) fifo_.push_back(value);
+      return;
+
+    case REG_MEM_R_W: {
+      const uint8_t bank = regs_[REG_BANK_SEL] & 0x1F;
+      const uint8_t address = regs_[REG_MEM_START_ADDR]++;
+      if (bank < 8) memory_[bank * 256 + address] = value;
+      return;
+    }
+
+    case REG_INT_STATUS:
+    case REG_FIFO_COUNTH:
+    case REG_FIFO_COUNTL:
+    case REG_WHO_AM_I:
+      return;
+
+    default:
+      regs_[reg] = value;
+      return;
+  }
+}
+
+uint32_t Mpu9150::samplePeriod() const {
+  // Gyro output rate is 8 kHz with the DLPF off, 1 kHz with it on
+  const uint8_t dlpf = regs_[REG_CONFIG] & 0x07;
+  const uint32_t base = (dlpf == 0 || dlpf == 7) ? 125 : 1000;
+  return base * (1 + regs_[REG_SMPLRT_DIV]);
+}
+
+uint64_t Mpu9150::nextEvent() const {
+  return next_sample_ < int_release_ ? next_sample_ : int_release_;
+}
+
+void Mpu9150::update(uint64_t now) {
+  if (int_release_ <= now) {
+    int_release_ = NEVER;
+    setIntPin(false);
+  }
+  while (next_sample_ <= now) {
+    const uint64_t at = next_sample_;
+    next_sample_ += samplePeriod();
+    sample(at);
+  }
+}
+
+void Mpu9150::sample(uint64_t now) {
+  samples++;
+  const FlightState s = flight(now);
+
+  double force[3], rate[3];
+  specificForce(s, force);
+  angularRate(s, rate);
+
+  const double accel_lsb = 16384.0 / (1 << ((regs_[REG_ACCEL_CONFIG] >> 3) & 3));
+  const double gyro_lsb = 131.0 / (1 << ((regs_[REG_GYRO_CONFIG] >> 3) & 3));
+  for (int i = 0; i < 3; i++) {
+    put16(&regs_[REG_ACCEL_XOUT_H + 2 * i],
+          (int32_t)lround((force[i] + 0.004 * noise(10 + i, samples)) * accel_lsb));
+    put16(&regs_[REG_GYRO_XOUT_H + 2 * i],
+          (int32_t)lround((rate[i] + 0.05 * noise(13 + i, samples)) * gyro_lsb));
+  }
+  // Die temperature runs a few degrees above ambient
+  put16(&regs_[REG_TEMP_OUT_H], (int32_t)lround((s.temperature + 6.0 - 36.53) * 340.0));
+
+  if (regs_[REG_USER_CTRL] & USER_CTRL_I2C_MST_EN) pollAux();
+
+  uint8_t status = INT_DATA_RDY;
+  const uint8_t dmp_on = USER_CTRL_DMP_EN | USER_CTRL_FIFO_EN;
+  if ((regs_[REG_USER_CTRL] & dmp_on) == dmp_on) {
+    const uint32_t divider =
+      (memory_[DMP_FIFO_RATE] << 8 | memory_[DMP_FIFO_RATE + 1]) + 1;
+    if (++dmp_divider_ >= divider) {
+      dmp_divider_ = 0;
+      pushDmpPacket(now);
+      status |= INT_DMP;
+      if (fifo_.size() == FIFO_SIZE) status |= INT_FIFO_OFLOW;
+    }
+  }
+  raiseInterrupt(status, now);
+}
+
+void Mpu9150::pollAux() {
+  // Slaves flagged in I2C_MST_DELAY_CTRL are only serviced every
+  // 1 + I2C_MST_DLY samples
+  const bool delayed_turn = aux_divider_ == 0;
+  if (++aux_divider_ > (uint32_t)(regs_[REG_I2C_SLV4_CTRL] & 0x1F)) aux_divider_ = 0;
+
+  uint8_t ext = REG_EXT_SENS_DATA_00;
+  for (uint8_t n = 0; n < 4; n++) {
+    const uint8_t addr = regs_[REG_I2C_SLV0_ADDR + 3 * n];
+    const uint8_t reg = regs_[REG_I2C_SLV0_ADDR + 3 * n + 1];
+    const uint8_t ctrl = regs_[REG_I2C_SLV0_ADDR + 3 * n + 2];
+    const uint8_t length = ctrl & 0x0F;
+    if (!(ctrl & 0x80)) continue;
+
+    const bool read = addr & 0x80;
+    if ((regs_[REG_I2C_MST_DELAY_CTRL] & (1 << n)) && !delayed_turn) {
+      // Keeps its EXT_SENS_DATA slots
+      if (read) ext += length;
+      continue;
+    }
+
+    I2CDevice *device = aux_[addr & 0x7F];
+    auxTransactions++;
+    if (read) {
+      uint8_t data[16];
+      if (device) {
+        device->i2cWrite(&reg, 1);
+        device->i2cRead(data, length);
+        if (ctrl & 0x40) swapPairs(data, length, reg, ctrl & 0x10);
+        for (uint8_t i = 0; i < length && ext + i <= 0x60; i++) {
+          regs_[ext + i] = data[i];
+        }
+      }
+      ext += length;
+    } else if (device) {
+      const uint8_t data[2] = { reg, regs_[REG_I2C_SLV0_DO + n] };
+      device->i2cWrite(data, 2);
+    }
+  }
+}
+
+void Mpu9150::pushDmpPacket(uint64_t now) {
+  const FlightState s = flight(now);
+  uint8_t packet[DMP_PACKET_SIZE];
+  memset(packet, 0, sizeof(packet));
+
+  double force[3], rate[3];
+  specificForce(s, force);
+  angularRate(s, rate);
+
+  const double q[4] = { s.qw, s.qx, s.qy, s.qz };
+  for (int i = 0; i < 4; i++) {
+    put32(&packet[4 * i], (int32_t)lround((q[i] + 0.0005 * noise(20 + i, dmpPackets)) * 1073741824.0));
+  }
+  for (int i = 0; i < 3; i++) {
+    int16_t gyro = (int16_t)lround(rate[i] * 16.4);
+    int16_t accel = (int16_t)lround(force[i] * 4096.0);
+    put32(&packet[16 + 4 * i], (int32_t)gyro << 16);
+    put32(&packet[34 + 4 * i], (int32_t)accel << 16);
+  }
+  // Magnetometer as last polled by the auxiliary master: two AK8975 status
+  // bytes, then X, Y, Z, big endian once the master has swapped them
+  memcpy(&packet[28], &regs_[REG_EXT_SENS_DATA_00 + 2], 6);
+
+  dmpPackets++;
+  if (fifo_.size() + DMP_PACKET_SIZE > FIFO_SIZE) fifoOverflows++;
+  for (size_t i = 0; i < DMP_PACKET_SIZE; i++) {
+    // Oldest data is lost
+    if (fifo_.size() == FIFO_SIZE) fifo_.pop_front();
+    fifo_.push_back(packet[i]);
+  }
+}
+
+void Mpu9150::raiseInterrupt(uint8_t status, uint64_t now) {
+  regs_[REG_INT_STATUS] |= status;
+  if (!(status & regs_[REG_INT_ENABLE])) return;
+
+  setIntPin(true);
+  if (!(regs_[REG_INT_PIN_CFG] & INT_CFG_LATCH)) int_release_ = now + INT_PULSE_MICROS;
+}
+
+void Mpu9150::setIntPin(bool active) {
+  if (int_pin_ == NO_PIN) return;
+  const bool active_low = regs_[REG_INT_PIN_CFG] & INT_CFG_LEVEL;
+  writePin(int_pin_, active != active_low);
+}
+
+}
@@ -0,0 +1,75 @@
+/****************************************************************************
+InvenSense MPU-9150 model.
+
+Covers what the MPU6050 library and the MotionApps 4.1 DMP path touch: the
+register file, device reset and sleep, DMP memory access through BANK_SEL /
+MEM_START_ADDR / MEM_R_W, the 1024 byte FIFO with overflow, interrupt
+status and the INT pin, the raw accel/gyro/temperature registers and the
+auxiliary I2C master that polls slaves into EXT_SENS_DATA. The DMP itself is
+not emulated; while it is enabled the model pushes 48 byte MotionApps 4.1
+packets at the configured DMP rate, built from the reference flight.
+****************************************************************************/
+
+#ifndef SIM_MPU9150_H
+#define SIM_MPU9150_H
+
+#include <deque>
+
+#include "SimI2C.h"
+
+namespace sim {
+
+class Mpu9150 : public RegisterDevice, public Device {
+ public:
+  static const uint8_t ADDRESS = 0x68;
+  static const size_t FIFO_SIZE = 1024;
+  static const size_t DMP_PACKET_SIZE = 48;
+
+  Mpu9150();
+
+  /** Connect the INT output to an MCU pin. */
+  void setInterruptPin(uint8_t pin) { int_pin_ = pin; }
+
+  /** Attach a slave to the auxiliary bus (the on-die AK8975). */
+  void attachAux(uint8_t address, I2CDevice *device);
+
+  /** True while the auxiliary bus is bridged onto the host bus. */
+  bool bypassEnabled() const;
+
+  uint64_t nextEvent() const;
+  void update(uint64_t now);
+
+  // Statistics
+  uint32_t samples;
+  uint32_t dmpPackets;
+  uint32_t fifoOverflows;
+  uint32_t auxTransactions;
+
+ protected:
+  uint8_t readRegister(uint8_t reg);
+  void writeRegister(uint8_t reg, uint8_t value);
+  bool autoIncrement(uint8_t reg) const;
+
+ private:
+  void reset();
+  uint32_t samplePeriod() const;
+  void sample(uint64_t now);
+  void pollAux();
+  void pushDmpPacket(uint64_t now);
+  void raiseInterrupt(uint8_t status, uint64_t now);
+  void setIntPin(bool active);
+
+  uint8_t regs_[128];
+  uint8_t memory_[8 * 256];
+  std::deque<uint8_t> fifo_;
+  I2CDevice *aux_[128];
+  uint8_t int_pin_;
+  uint64_t int_release_;
+  uint64_t next_sample_;
+  uint32_t dmp_divider_;
+  uint32_t aux_divider_;
+};
+
+}
+
+#endif
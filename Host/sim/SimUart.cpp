@@ -0,0 +1,113 @@
+#include "SimUart.h"
+
+namespace sim {
+
+Uart::Uart(const char *name, size_t txCapacity, size_t rxCapacity)
+  : txBytes(0)
+  , rxBytes(0)
+  , rxOverruns(0)
+  , rxFramingErrors(0)
+  , blockedMicros(0)
+  , name_(name)
+  , peer_(0)
+  , baud_(0)
+  , tx_capacity_(txCapacity)
+  , rx_capacity_(rxCapacity)
+  , tx_done_(NEVER) {
+  addDevice(this);
+}
+
+void Uart::begin(uint32_t baud) {
+  baud_ = baud;
+  tx_.clear();
+  rx_.clear();
+  tx_done_ = NEVER;
+}
+
+void Uart::end() {
+  flush();
+  baud_ = 0;
+}
+
+uint32_t Uart::frameMicros() const {
+  // 8N1: start bit, eight data bits, stop bit
+  return baud_ ? (10000000ul + baud_ - 1) / baud_ : 0;
+}
+
+void Uart::transmit(uint8_t c) {
+  txBytes++;
+
+  if (tx_capacity_ == 0) {
+    if (peer_) peer_->receive(c, baud_);
+    return;
+  }
+
+  // Block until the interrupt handler has made room
+  const uint64_t start = now();
+  while (tx_.size() >= tx_capacity_) {
+    advance(tx_done_ - now());
+  }
+  blockedMicros += now() - start;
+
+  tx_.push_back(c);
+  if (tx_done_ == NEVER) tx_done_ = now() + frameMicros();
+}
+
+void Uart::flush() {
+  const uint64_t start = now();
+  while (!tx_.empty()) {
+    advance(tx_done_ - now());
+  }
+  blockedMicros += now() - start;
+}
+
+size_t Uart::txFree() const {
+  return tx_capacity_ > tx_.size() ? tx_capacity_ - tx_.size() : 0;
+}
+
+int Uart::available() {
+  return rx_.size();
+}
+
+int Uart::peek() {
+  return rx_.empty() ? -1 : rx_.front();
+}
+
+int Uart::read() {
+  if (rx_.empty()) return -1;
+  uint8_t c = rx_.front();
+  rx_.pop_front();
+  return c;
+}
+
+void Uart::deliver(uint8_t c, uint32_t baud) {
+  if (baud_ == 0) return;
+
+  if (baud != baud_) {
+    // Sampled at the wrong bit rate; what comes out is noise
+    rxFramingErrors++;
+    c = (uint8_t)((c * 0x9D) ^ (baud / baud_) ^ (baud_ / baud));
+  }
+
+  if (rx_.size() >= rx_capacity_) {
+    rxOverruns++;
+    return;
+  }
+  rxBytes++;
+  rx_.push_back(c);
+}
+
+uint64_t Uart::nextEvent() const {
+  return tx_done_;
+}
+
+void Uart::update(uint64_t now) {
+  while (tx_done_ <= now && !tx_.empty()) {
+    uint8_t c = tx_.front();
+    tx_.pop_front();
+    if (peer_) peer_->receive(c, baud_);
+    tx_done_ = tx_.empty() ? NEVER : tx_done_ + frameMicros();
+  }
+}
+
+}
@@ -0,0 +1,83 @@
+/****************************************************************************
+UART model behind the host HardwareSerial objects.
+
+Transmit bytes go through a fixed-size buffer that drains at the configured
+baud rate, so a write to a full buffer blocks exactly as long as it would on
+the Teensy. Received bytes land in a fixed-size buffer and are dropped, and
+counted, when the firmware does not read them fast enough. A port opened at
+a different baud rate than its peer receives framing garbage.
+****************************************************************************/
+
+#ifndef SIM_UART_H
+#define SIM_UART_H
+
+#include <deque>
+
+#include "Sim.h"
+
+namespace sim {
+
+/**
+ * The far end of a UART: a radio, a GPS receiver, a capture file.
+ */
+class UartPeer {
+ public:
+  virtual ~UartPeer() {}
+
+  /** A byte has finished arriving at the peer, sent at the given baud. */
+  virtual void receive(uint8_t c, uint32_t baud) = 0;
+};
+
+class Uart : public Device {
+ public:
+  /**
+   * @param txCapacity Transmit buffer size in bytes, 0 for a port that
+   *   never blocks (USB)
+   * @param rxCapacity Receive buffer size in bytes
+   */
+  Uart(const char *name, size_t txCapacity, size_t rxCapacity);
+
+  const char *name() const { return name_; }
+  void connect(UartPeer *peer) { peer_ = peer; }
+
+  // Firmware side
+  void begin(uint32_t baud);
+  void end();
+  uint32_t baud() const { return baud_; }
+  void transmit(uint8_t c);
+  void flush();
+  int available();
+  int peek();
+  int read();
+  size_t txFree() const;
+
+  // Peer side: a byte sent at the given baud has just arrived
+  void deliver(uint8_t c, uint32_t baud);
+
+  uint64_t nextEvent() const;
+  void update(uint64_t now);
+
+  /** Microseconds to shift one 8N1 frame at the current baud rate. */
+  uint32_t frameMicros() const;
+
+  // Statistics
+  uint64_t txBytes;
+  uint64_t rxBytes;
+  uint64_t rxOverruns;
+  uint64_t rxFramingErrors;
+  uint64_t blockedMicros;
+
+ private:
+  const char *name_;
+  UartPeer *peer_;
+  uint32_t baud_;
+  size_t tx_capacity_;
+  size_t rx_capacity_;
+  std::deque<uint8_t> tx_;
+  std::deque<uint8_t> rx_;
+  uint64_t tx_done_;
+};
+
+}
+
+#endif